@@ -0,0 +1,284 @@
+/*
+ * camera_sim_ref.c
+ *
+ * Host side of tb_camera.v.
+ *   gen [-n frames] [-w width] [-h height]
+ *                               writes camera<n>.hex, the RGB565 frames the
+ *                               testbench sends on camData, one pixel per line
+ *                               (the first byte of the pixel in bits [15:8]): a
+ *                               bright square moving over a colored background
+ *   check [-n frames] [-w width] [-h height] [-f format] [-s] [-t threshold]
+ *         [-x roi x] [-y roi y] [-X roi width] [-Y roi height]
+ *         [-d horizontal decimation] [-D vertical decimation]
+ *                               compares the frame buffers the testbench dumps
+ *                               after every completed frame with the region of
+ *                               interest and decimation applied to camera<n>.hex:
+ *                               gray<n>.hex (format 0 and 2) word by word with
+ *                               the grayscale packing of the original camera.v,
+ *                               color<n>.hex (format 1 and 2) with the RGB565
+ *                               packing of the original camera_colors.v, and
+ *                               with -s (streaming sobel) result<n>.hex and
+ *                               state<n>.hex with edgeDetection and
+ *                               movementDetection of programms/sobel
+ * A line keeps the complete groups of 4 pixels of the region, the lines follow
+ * each other without a gap. The streaming filter writes the movement values
+ * and the edge bits (32 pixels per word, pixel x in bit x%32) of all lines but
+ * the last one; only the lines 1..height-2 and the columns 1..width-2 are
+ * valid. It marks an edge when |Gx|+|Gy| >= threshold, edgeDetection when it
+ * is > threshold, so the reference runs with threshold - 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sobel.h>
+#include <movement.h>
+
+#define MAX_WIDTH 640
+#define MAX_HEIGHT 480
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s gen [-n frames] [-w width] [-h height]\n"
+                  "       %s check [-n frames] [-w width] [-h height] [-f format] [-s] [-t threshold]\n"
+                  "             [-x roi x] [-y roi y] [-X roi width] [-Y roi height]\n"
+                  "             [-d horizontal decimation] [-D vertical decimation]\n", name, name);
+  exit(1);
+}
+
+static uint16_t cameraPixel(int32_t frameNr, int32_t pixel, int32_t line) {
+  uint32_t red = (pixel >> 4) & 0x1F;
+  uint32_t green = ((pixel + line) >> 2) & 0x3F;
+  uint32_t blue = (((line >> 3) ^ (pixel >> 3)) & 1) ? 0x18 : 0x06;
+  int32_t x = pixel - 40 - frameNr * 13;
+  int32_t y = line - 30 - frameNr * 9;
+  if (x >= 0 && x < 120 && y >= 0 && y < 90) {
+    red = 0x1F;
+    green = 0x3F - ((x ^ y) & 7);
+    blue = 0x1C + (x & 3);
+  }
+  return (red << 11) | (green << 5) | blue;
+}
+
+static int generate(int argc, char **argv) {
+  int32_t nrOfFrames = 3, width = MAX_WIDTH, height = MAX_HEIGHT;
+  char path[32];
+  int opt;
+  while ((opt = getopt(argc, argv, "n:w:h:")) != -1) {
+    switch (opt) {
+      case 'n': nrOfFrames = atoi(optarg); break;
+      case 'w': width = atoi(optarg); break;
+      case 'h': height = atoi(optarg); break;
+      default : usage("camera_sim_ref");
+    }
+  }
+  for (int32_t frameNr = 0; frameNr < nrOfFrames; frameNr++) {
+    snprintf(path, sizeof(path), "camera%d.hex", frameNr);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+      perror(path);
+      return 1;
+    }
+    for (int32_t line = 0; line < height; line++) {
+      for (int32_t pixel = 0; pixel < width; pixel++) fprintf(file, "%04x\n", cameraPixel(frameNr, pixel, line));
+    }
+    fclose(file);
+  }
+  printf("%d frames of %dx%d written\n", nrOfFrames, width, height);
+  return 0;
+}
+
+/* $writememh output; address (@) and comment lines are skipped, x and z count as errors */
+static int32_t readWords(const char *path, uint32_t *words, int32_t nrOfWords) {
+  FILE *file = fopen(path, "r");
+  char line[128];
+  int32_t word = 0, nrOfUnknown = 0;
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  while (word < nrOfWords && fgets(line, sizeof(line), file) != NULL) {
+    char *text = line + strspn(line, " \t");
+    if (*text == '@' || *text == '/' || *text == '\n' || *text == '\0') continue;
+    char *end;
+    words[word] = strtoul(text, &end, 16);
+    if (end - text != 8) {
+      nrOfUnknown++;
+      words[word] = 0xFFFFFFFF;
+    }
+    word++;
+  }
+  fclose(file);
+  if (word != nrOfWords) {
+    fprintf(stderr, "%s: %d of %d words\n", path, word, nrOfWords);
+    exit(1);
+  }
+  return nrOfUnknown;
+}
+
+static void readCamera(int32_t frameNr, uint16_t *image, int32_t nrOfPixels) {
+  char path[32], line[32];
+  int32_t pixel = 0;
+  snprintf(path, sizeof(path), "camera%d.hex", frameNr);
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  while (pixel < nrOfPixels && fgets(line, sizeof(line), file) != NULL) image[pixel++] = strtoul(line, NULL, 16);
+  fclose(file);
+  if (pixel != nrOfPixels) {
+    fprintf(stderr, "%s: %d of %d pixels\n", path, pixel, nrOfPixels);
+    exit(1);
+  }
+}
+
+/*
+ * The grayscale conversion of the original camera.v, wire by wire: every value is the bit field the wire holds, so
+ * the truncations and the misaligned concatenations of the hardware are kept.
+ */
+static uint8_t cameraGray(uint16_t pixel) {
+  uint32_t red = (pixel >> 11) & 0x1F, green = (pixel >> 5) & 0x3F, blue = pixel & 0x1F;
+  uint32_t redSum = (red + (red << 1)) & 0x7F;                           // [10:4]
+  uint32_t redResult = (redSum + (redSum << 3)) & 0xFFF;                 // [15:4]
+  uint32_t blueSum = (blue + (blue << 1)) & 0x7F;                        // [9:3]
+  uint32_t blueResult = (blueSum + (blue << 4)) & 0x1FFF;                // [15:3]
+  uint32_t greenSum = (green + (green << 1)) & 0xFF;                     // [9:2]
+  uint32_t greenSum1 = (greenSum + (greenSum << 3)) & 0x1FFF;            // [15:3]
+  uint32_t greenx129 = (green << 6) | (green >> 1);                      // [15:3]
+  uint32_t greenResult = (greenSum1 + greenx129) & 0x1FFF;               // [15:3]
+  uint32_t rbSum = ((redResult << 1) + blueResult) & 0x1FFF;             // [15:3]
+  uint32_t rgbSum = (rbSum + greenResult) & 0x1FFF;                      // [15:3]
+  return (rgbSum >> 5) & 0xFF;                                           // [15:8]
+}
+
+/* the pixels of the region of interest on the decimation grid, complete groups of 4 per line */
+static int32_t keptCount(int32_t size, int32_t origin, int32_t roiSize, int32_t decimation) {
+  int32_t step = 1 << decimation;
+  int32_t remaining = (origin >= size) ? 0 : size - origin;
+  if (roiSize != 0 && roiSize < remaining) remaining = roiSize;
+  return (remaining + step - 1) / step;
+}
+
+static void compareWords(const char *what, int32_t frameNr, const uint32_t *hardware, const uint32_t *software,
+                         int32_t nrOfWords, int32_t lineWords, int32_t nrOfUnknown, bool *ok) {
+  int32_t nrOfMismatches = 0;
+  for (int32_t word = 0; word < nrOfWords; word++) {
+    if (hardware[word] == software[word]) continue;
+    if (nrOfMismatches++ < 10) {
+      printf("frame %d %s line %d word %d: hardware %08x, software %08x\n", frameNr, what,
+             word / lineWords, word % lineWords, hardware[word], software[word]);
+    }
+  }
+  printf("frame %d: %d %s words, %d mismatches, %d unknown words\n", frameNr, nrOfWords, what, nrOfMismatches, nrOfUnknown);
+  *ok &= nrOfMismatches == 0 && nrOfUnknown == 0;
+}
+
+static int check(int argc, char **argv) {
+  int32_t nrOfFrames = 3, width = MAX_WIDTH, height = MAX_HEIGHT, format = 0, threshold = 127;
+  int32_t roiX = 0, roiY = 0, roiWidth = 0, roiHeight = 0, hDecimation = 0, vDecimation = 0;
+  bool ok = true, streaming = false;
+  char path[32];
+  int opt;
+  while ((opt = getopt(argc, argv, "n:w:h:f:st:x:y:X:Y:d:D:")) != -1) {
+    switch (opt) {
+      case 'n': nrOfFrames = atoi(optarg); break;
+      case 'w': width = atoi(optarg); break;
+      case 'h': height = atoi(optarg); break;
+      case 'f': format = atoi(optarg); break;
+      case 's': streaming = true; break;
+      case 't': threshold = atoi(optarg); break;
+      case 'x': roiX = atoi(optarg); break;
+      case 'y': roiY = atoi(optarg); break;
+      case 'X': roiWidth = atoi(optarg); break;
+      case 'Y': roiHeight = atoi(optarg); break;
+      case 'd': hDecimation = atoi(optarg); break;
+      case 'D': vDecimation = atoi(optarg); break;
+      default : usage("camera_sim_ref");
+    }
+  }
+  if (width <= 0 || width > MAX_WIDTH || height <= 0 || height > MAX_HEIGHT || format < 0 || format > 2 ||
+      hDecimation < 0 || hDecimation > 2 || vDecimation < 0 || vDecimation > 2) usage("camera_sim_ref");
+  int32_t keptWidth = keptCount(width, roiX, roiWidth, hDecimation) & ~3;
+  int32_t keptHeight = keptCount(height, roiY, roiHeight, vDecimation);
+  int32_t lineWords = keptWidth / 4, stateWords = (lineWords + 7) / 8, nrOfPixels = keptWidth * keptHeight;
+  if (keptWidth < 4 || keptHeight < 3) usage("camera_sim_ref");
+  printf("%dx%d of %dx%d kept\n", keptWidth, keptHeight, width, height);
+  uint16_t *camera = malloc(width * height * sizeof(uint16_t));
+  uint16_t *color = malloc(nrOfPixels * sizeof(uint16_t));
+  uint8_t *gray = malloc(nrOfPixels);
+  uint8_t *sobel = calloc(nrOfPixels, 1);
+  uint8_t *movement = malloc(nrOfPixels);
+  uint32_t *hardware = malloc(nrOfPixels * sizeof(uint16_t));
+  uint32_t *software = malloc(nrOfPixels * sizeof(uint16_t));
+  uint32_t *state = malloc(keptHeight * stateWords * sizeof(uint32_t));
+  if (camera == NULL || color == NULL || gray == NULL || sobel == NULL || movement == NULL ||
+      hardware == NULL || software == NULL || state == NULL) return 1;
+  memset(movement, 127, nrOfPixels);
+  for (int32_t frameNr = 0; frameNr < nrOfFrames; frameNr++) {
+    readCamera(frameNr, camera, width * height);
+    for (int32_t line = 0; line < keptHeight; line++) {
+      for (int32_t pixel = 0; pixel < keptWidth; pixel++) {
+        uint16_t value = camera[(roiY + (line << vDecimation)) * width + roiX + (pixel << hDecimation)];
+        color[line * keptWidth + pixel] = value;
+        gray[line * keptWidth + pixel] = cameraGray(value);
+      }
+    }
+    if (format != 1 && !streaming) {
+      // camera.v: {gray 4, gray 3, gray 2, gray 1} of the pixels in the order they arrive
+      for (int32_t word = 0; word < nrOfPixels / 4; word++) {
+        const uint8_t *pixels = gray + word * 4;
+        software[word] = (pixels[3] << 24) | (pixels[2] << 16) | (pixels[1] << 8) | pixels[0];
+      }
+      snprintf(path, sizeof(path), "gray%d.hex", frameNr);
+      int32_t nrOfUnknown = readWords(path, hardware, nrOfPixels / 4);
+      compareWords("gray", frameNr, hardware, software, nrOfPixels / 4, lineWords, nrOfUnknown, &ok);
+    }
+    if (format != 0) {
+      // camera_colors.v: {byte 3, byte 4, byte 1, byte 2} of two pixels, the first byte of a pixel is its high byte
+      for (int32_t word = 0; word < nrOfPixels / 2; word++) {
+        software[word] = (color[word * 2 + 1] << 16) | color[word * 2];
+      }
+      snprintf(path, sizeof(path), "color%d.hex", frameNr);
+      int32_t nrOfUnknown = readWords(path, hardware, nrOfPixels / 2);
+      compareWords("RGB565", frameNr, hardware, software, nrOfPixels / 2, lineWords * 2, nrOfUnknown, &ok);
+    }
+    if (streaming) {
+      edgeDetection(gray, sobel, keptWidth, keptHeight, threshold - 1);
+      movementDetection(frameNr == 0, sobel, movement, keptWidth, keptHeight);
+      snprintf(path, sizeof(path), "result%d.hex", frameNr);
+      int32_t nrOfUnknown = readWords(path, hardware, (keptHeight - 1) * lineWords);
+      snprintf(path, sizeof(path), "state%d.hex", frameNr);
+      nrOfUnknown += readWords(path, state, (keptHeight - 1) * stateWords);
+      int32_t nrOfMismatches = 0, nrOfEdges = 0, nrOfMoved = 0;
+      for (int32_t line = 1; line < keptHeight - 1; line++) {
+        for (int32_t pixel = 1; pixel < keptWidth - 1; pixel++) {
+          int32_t index = line * keptWidth + pixel;
+          uint8_t value = hardware[index / 4] >> ((index & 3) * 8);
+          bool edge = (state[line * stateWords + pixel / 32] >> (pixel & 31)) & 1;
+          nrOfEdges += movement[index] != 127;
+          nrOfMoved += movement[index] == 255;
+          if (value == movement[index] && edge == (movement[index] != 127)) continue;
+          if (nrOfMismatches++ < 10) {
+            printf("frame %d line %d pixel %d: hardware %d (edge bit %d), software %d\n",
+                   frameNr, line, pixel, value, edge, movement[index]);
+          }
+        }
+      }
+      printf("frame %d: %d edges, %d moved, %d mismatches, %d unknown words\n",
+             frameNr, nrOfEdges, nrOfMoved, nrOfMismatches, nrOfUnknown);
+      ok &= nrOfMismatches == 0 && nrOfUnknown == 0;
+    }
+  }
+  printf("%s\n", ok ? "identical" : "MISMATCH");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) usage(argv[0]);
+  if (strcmp(argv[1], "gen") == 0) return generate(argc - 1, argv + 1);
+  if (strcmp(argv[1], "check") == 0) return check(argc - 1, argv + 1);
+  usage(argv[0]);
+  return 1;
+}
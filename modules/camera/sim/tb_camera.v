@@ -0,0 +1,411 @@
+/*
+ * Testbench of the camera grabber (camera.v). An OV7670 model drives pclk,
+ * hsync, vsync and camData with the RGB565 frames of camera<n>.hex (one pixel
+ * per line, the byte in bits [15:8] first), the grabber writes to a behavioral
+ * sdram (sdramBusModel.v) through the real bus arbiter, and the cpu side issues
+ * the custom instructions of programms/_support/src/ov7670.c: the region of
+ * interest and decimation (setRegionOfInterest, setDecimation), the output
+ * format (setCameraFormat), the streaming sobel filter (enableStreamingSobel),
+ * the line and frame interrupts (enableCameraInterrupts) and continuous
+ * grabbing into the frame buffer or a ring of 2 or 3 buffers (enableContinues,
+ * enableContinuesRing). Every interrupt is handled like cameraInterrupt does:
+ * on a line interrupt register 17 has to hold the next multiple of the line
+ * interval, on a frame interrupt the number of line interrupts of the frame,
+ * the completed frames (register 16), the buffer of the frame (register 15),
+ * the ring index (register 14) and the geometry of the lines written to memory
+ * (registers 0 and 1) are checked. The buffers of the frame are then written to
+ * gray<n>.hex, color<n>.hex, result<n>.hex and state<n>.hex and filled with a
+ * marker, so the next frame has to write every word again; a ring runs
+ * CAMERA_FORMAT_BOTH as grayscale, so there the color buffer has to keep the
+ * marker. camera_sim_ref.c creates the frames and checks these files. The
+ * state buffer starts cleared, as enableStreamingSobel requires. Failed checks are reported with ERROR.
+ */
+module tb_camera;
+
+  parameter nrOfFrames = 3;
+  parameter sensorWidth = 640;        // pixels and lines the camera sends
+  parameter sensorHeight = 480;
+  parameter lineBlank = 288;          // pclk cycles hsync is low between two lines
+  parameter pclkHalfPeriod = 16;      // the clock has a half period of 5
+  parameter outputFormat = 0;         // CAMERA_FORMAT_GRAY, CAMERA_FORMAT_RGB565 or CAMERA_FORMAT_BOTH
+  parameter streaming = 0;            // enableStreamingSobel
+  parameter sobelThreshold = 127;
+  parameter ringSize = 0;             // 2 or 3: enableContinuesRing, else enableContinues
+  parameter roiX = 0;                 // setRegionOfInterest
+  parameter roiY = 0;
+  parameter roiWidth = 0;
+  parameter roiHeight = 0;
+  parameter hDecimation = 0;          // setDecimation (CAMERA_DECIMATE_x)
+  parameter vDecimation = 0;
+  parameter lineInterval = 16;        // enableCameraInterrupts(CAMERA_IRQ_LINES | CAMERA_IRQ_FRAME, lineInterval)
+  parameter readLatency = 8;
+  parameter writeBusyPeriod = 0;
+
+  /*
+   *
+   * Here we define the memory map of the sdram model, the custom instructions and the geometry of the written lines
+   *
+   */
+  localparam [31:0] frameBufferBase = 32'h00040000;
+  localparam [31:0] ringBase0 = 32'h00040000;
+  localparam [31:0] ringBase1 = 32'h00100000;
+  localparam [31:0] ringBase2 = 32'h001C0000;
+  localparam [31:0] colorBufferBase = 32'h00280000;
+  localparam [31:0] stateBufferBase = 32'h00320000;
+  localparam [31:0] resultBufferBase = 32'h00340000;
+  localparam [31:0] marker = 32'hA5A5A5A5;
+  localparam [7:0]  ciCamera = 8'd7;
+  localparam [31:0] irqLines = 32'd1;
+  localparam [31:0] irqFrame = 32'd2;
+  localparam        roiRemainingWidth = (roiX >= sensorWidth) ? 0 : sensorWidth - roiX;
+  localparam        roiRemainingHeight = (roiY >= sensorHeight) ? 0 : sensorHeight - roiY;
+  localparam        roiEffectiveWidth = (roiWidth != 0 && roiWidth < roiRemainingWidth) ? roiWidth : roiRemainingWidth;
+  localparam        roiEffectiveHeight = (roiHeight != 0 && roiHeight < roiRemainingHeight) ? roiHeight : roiRemainingHeight;
+  localparam        keptWidth = ((roiEffectiveWidth + (1 << hDecimation) - 1) >> hDecimation) / 4 * 4;
+  localparam        keptHeight = (roiEffectiveHeight + (1 << vDecimation) - 1) >> vDecimation;
+  localparam        lineWords = keptWidth / 4;
+  localparam        stateWords = (lineWords + 7) / 8;
+  localparam        ring = (ringSize == 2 || ringSize == 3) ? 1 : 0;
+  // the ring rotates the one output image, so it runs CAMERA_FORMAT_BOTH and streaming with RGB565 as grayscale
+  localparam        runFormat = (ring != 0 && (outputFormat == 2 || streaming != 0)) ? 0 : outputFormat;
+  // the streaming filter writes all lines but the last one, an RGB565 image ends every line
+  localparam        linesPerFrame = (streaming != 0 && runFormat == 0) ? keptHeight - 1 : keptHeight;
+  localparam        linePeriod = 2*sensorWidth + lineBlank;
+
+  /*
+   *
+   * Here we define the clocks, the camera, the cpu side of the custom instruction interface and the bus
+   *
+   */
+  reg        clock = 1'b0;
+  reg        pclk = 1'b0;
+  reg        reset = 1'b1;
+  reg        hsync = 1'b0;
+  reg        vsync = 1'b0;
+  reg [7:0]  camData = 8'd0;
+  reg        start = 1'b0;
+  reg [7:0]  ciN = 8'd0;
+  reg [31:0] valueA = 32'd0;
+  reg [31:0] valueB = 32'd0;
+  wire       done;
+  wire [31:0] result;
+  wire       irq;
+
+  always #5 clock = ~clock;
+  always #pclkHalfPeriod pclk = ~pclk;
+
+  wire        s_camRequest, s_camBeginTransaction, s_camReadNotWrite, s_camEndTransaction, s_camDataValid;
+  wire [3:0]  s_camByteEnables;
+  wire [7:0]  s_camBurstSize;
+  wire [31:0] s_camAddressData;
+  wire [31:0] s_busGrants;
+  wire        s_arbBusError, s_arbEndTransaction, s_busIdle, s_snoopableBurst;
+  wire        s_sdramEndTransaction, s_sdramDataValid, s_sdramBusy, s_sdramBusError;
+  wire [31:0] s_sdramAddressData;
+
+  wire        s_beginTransaction = s_camBeginTransaction;
+  wire        s_endTransaction   = s_camEndTransaction | s_arbEndTransaction | s_sdramEndTransaction;
+  wire        s_dataValid        = s_camDataValid | s_sdramDataValid;
+  wire [31:0] s_addressData      = s_camAddressData | s_sdramAddressData;
+  wire        s_busError         = s_arbBusError | s_sdramBusError;
+
+  camera #(.customInstructionId(ciCamera),
+           .clockFrequencyInHz(100000)) dut
+          (.clock(clock),
+           .pclk(pclk),
+           .reset(reset),
+           .hsync(hsync),
+           .vsync(vsync),
+           .ciStart(start),
+           .ciCke(1'b1),
+           .ciN(ciN),
+           .camData(camData),
+           .ciValueA(valueA),
+           .ciValueB(valueB),
+           .ciResult(result),
+           .ciDone(done),
+           .requestBus(s_camRequest),
+           .busGrant(s_busGrants[0]),
+           .beginTransactionOut(s_camBeginTransaction),
+           .addressDataOut(s_camAddressData),
+           .endTransactionOut(s_camEndTransaction),
+           .byteEnablesOut(s_camByteEnables),
+           .dataValidOut(s_camDataValid),
+           .burstSizeOut(s_camBurstSize),
+           .busyIn(s_sdramBusy),
+           .busErrorIn(s_busError),
+           .endTransactionIn(s_endTransaction),
+           .dataValidIn(s_dataValid),
+           .addressDataIn(s_addressData),
+           .readNotWriteOut(s_camReadNotWrite),
+           .irq(irq));
+
+  busArbiter arbiter ( .clock(clock),
+                       .reset(reset),
+                       .busRequests({31'd0,s_camRequest}),
+                       .busGrants(s_busGrants),
+                       .busErrorOut(s_arbBusError),
+                       .endTransactionOut(s_arbEndTransaction),
+                       .busIdle(s_busIdle),
+                       .snoopableBurst(s_snoopableBurst),
+                       .beginTransactionIn(s_beginTransaction),
+                       .endTransactionIn(s_endTransaction),
+                       .dataValidIn(s_dataValid),
+                       .addressDataIn(s_addressData[31:30]),
+                       .burstSizeIn(s_camBurstSize));
+
+  sdramBusModel #(.readLatency(readLatency),
+                  .writeBusyPeriod(writeBusyPeriod)) sdram
+                 ( .clock(clock),
+                   .reset(reset),
+                   .beginTransactionIn(s_beginTransaction),
+                   .endTransactionIn(s_endTransaction),
+                   .readNotWriteIn(s_camReadNotWrite),
+                   .dataValidIn(s_dataValid),
+                   .addressDataIn(s_addressData),
+                   .burstSizeIn(s_camBurstSize),
+                   .endTransactionOut(s_sdramEndTransaction),
+                   .dataValidOut(s_sdramDataValid),
+                   .busyOut(s_sdramBusy),
+                   .busErrorOut(s_sdramBusError),
+                   .addressDataOut(s_sdramAddressData));
+
+  integer s_errors = 0;
+
+  task check;
+    input [8*40-1:0] what;
+    input [31:0]     value;
+    input [31:0]     expected;
+    if (value !== expected)
+      begin
+        $display("ERROR: %0s is %0d, expected %0d", what, value, expected);
+        s_errors = s_errors + 1;
+      end
+  endtask
+
+  /*
+   *
+   * Here we define the camera: after a vsync pulse of one line and 2 blank lines the lines of the frame follow, each
+   * with hsync high for the 2 bytes of every pixel and low for lineBlank pclk cycles, then 2 blank lines. The outputs
+   * change on the falling edge of pclk. The vsync pulse after the last frame completes it.
+   *
+   */
+  reg        s_cameraOnReg = 1'b0;
+  reg [15:0] cameraImage [0:sensorWidth*sensorHeight-1];
+
+  task blankLines;
+    input integer nrOfLines;
+    repeat (nrOfLines*linePeriod) @(negedge pclk);
+  endtask
+
+  task sendLine;
+    input integer line;
+    integer pixel;
+    begin
+      for (pixel = 0 ; pixel < sensorWidth ; pixel = pixel + 1)
+        begin
+          @(negedge pclk);
+          hsync   = 1'b1;
+          camData = cameraImage[line*sensorWidth+pixel][15:8];
+          @(negedge pclk);
+          camData = cameraImage[line*sensorWidth+pixel][7:0];
+        end
+      @(negedge pclk);
+      hsync   = 1'b0;
+      camData = 8'd0;
+      repeat (lineBlank - 1) @(negedge pclk);
+    end
+  endtask
+
+  initial
+    begin : cameraSource
+      integer     frameNr, line;
+      reg [8*32-1:0] fileName;
+      wait (s_cameraOnReg == 1'b1);
+      for (frameNr = 0 ; frameNr <= nrOfFrames ; frameNr = frameNr + 1)
+        begin
+          @(negedge pclk);
+          vsync = 1'b1;
+          blankLines(1);
+          vsync = 1'b0;
+          blankLines(2);
+          if (frameNr < nrOfFrames)
+            begin
+              $sformat(fileName, "camera%0d.hex", frameNr);
+              $readmemh(fileName, cameraImage);
+              for (line = 0 ; line < sensorHeight ; line = line + 1) sendLine(line);
+              blankLines(2);
+            end
+        end
+    end
+
+  /*
+   *
+   * Here we define the cpu: a custom instruction raises start for one cycle and waits for done.
+   * The inputs change on the falling edge, so they are stable on the rising edge the ci samples them.
+   *
+   */
+  task ci;
+    input  [31:0] a;
+    input  [31:0] b;
+    output [31:0] r;
+    begin
+      @(negedge clock);
+      ciN    = ciCamera;
+      valueA = a;
+      valueB = b;
+      start  = 1'b1;
+      #1 r   = result;
+      if (done !== 1'b1)
+        begin
+          $display("ERROR: no done in the cycle of the custom instruction %0d", a);
+          s_errors = s_errors + 1;
+        end
+      @(negedge clock);
+      start = 1'b0;
+      repeat (3) @(negedge clock);
+    end
+  endtask
+
+  reg [31:0] s_unused;
+
+  task ciWrite;
+    input [31:0] a;
+    input [31:0] b;
+    ci(a, b, s_unused);
+  endtask
+
+  // the buffer the frame (the RGB565 image with CAMERA_FORMAT_RGB565, the movement image when streaming) goes to
+  function [31:0] outputBase;
+    input integer frameNr;
+    outputBase = (ring == 0) ? ((streaming != 0) ? resultBufferBase : frameBufferBase) :
+                 (frameNr % ringSize == 0) ? ringBase0 : (frameNr % ringSize == 1) ? ringBase1 : ringBase2;
+  endfunction
+
+  task dumpBuffer;
+    input [8*8-1:0] name;
+    input integer   frameNr;
+    input [31:0]    base;
+    input integer   nrOfWords;
+    reg [8*32-1:0]  fileName;
+    integer         word;
+    begin
+      $sformat(fileName, "%0s%0d.hex", name, frameNr);
+      $writememh(fileName, sdram.memory, base >> 2, (base >> 2) + nrOfWords - 1);
+      for (word = 0 ; word < nrOfWords ; word = word + 1) sdram.memory[(base >> 2) + word] = marker;
+    end
+  endtask
+
+  integer        word, frameNr, lineIrqs, waitCycles, written;
+  reg [31:0]     pending, enabled, value;
+  reg [8*32-1:0] fileName;
+
+  // waitForCompletedFrame has completed frame frameNr
+  task frameCompleted;
+    begin
+      check("line interrupts of the frame", lineIrqs, linesPerFrame / lineInterval);
+      lineIrqs = 0;
+      ci(16, 0, value);
+      check("completed frames", value, frameNr + 1);
+      ci(15, 0, value);
+      check("last completed frame", value, outputBase(frameNr));
+      ci(14, 0, value);
+      if (ring != 0) check("ring size and index", value, (((frameNr + 1) % ringSize) << 4) | ringSize);
+      ci(0, 0, value);
+      check("bytes per line", value, keptWidth*2);
+      ci(1, 0, value);
+      check("lines per image", value, keptHeight);
+      if (streaming == 0 && runFormat != 1) dumpBuffer("gray", frameNr, outputBase(frameNr), keptHeight*lineWords);
+      if (runFormat != 0)
+        dumpBuffer("color", frameNr, (runFormat == 2) ? colorBufferBase : (ring != 0) ? outputBase(frameNr) : frameBufferBase,
+                   keptHeight*lineWords*2);
+      if (outputFormat == 2 && runFormat == 0)
+        begin
+          written = 0;
+          for (word = 0 ; word < keptHeight*lineWords*2 ; word = word + 1)
+            if (sdram.memory[(colorBufferBase >> 2) + word] !== marker) written = written + 1;
+          check("words of the color buffer written with the ring", written, 0);
+        end
+      if (streaming != 0)
+        begin
+          dumpBuffer("result", frameNr, outputBase(frameNr), (keptHeight - 1)*lineWords);
+          $sformat(fileName, "state%0d.hex", frameNr);
+          $writememh(fileName, sdram.memory, stateBufferBase >> 2, (stateBufferBase >> 2) + (keptHeight - 1)*stateWords - 1);
+        end
+      $display("frame %0d: %0dx%0d, %0d lines written", frameNr, keptWidth, keptHeight, linesPerFrame);
+      frameNr = frameNr + 1;
+    end
+  endtask
+
+  initial
+    begin
+      // the edges of the previous frame are cleared once, the buffers hold the marker
+      for (word = 0 ; word < 1048576 ; word = word + 1)
+        sdram.memory[word] = (word >= (stateBufferBase >> 2) && word < (resultBufferBase >> 2)) ? 32'd0 : marker;
+      repeat (4) @(negedge clock);
+      reset = 1'b0;
+      repeat (4) @(negedge clock);
+      // setRegionOfInterest, setDecimation and setCameraFormat
+      ciWrite(50, (roiY << 16) | roiX);
+      ciWrite(51, (roiHeight << 16) | roiWidth);
+      ciWrite(52, (vDecimation << 4) | hDecimation);
+      ciWrite(54, colorBufferBase);
+      ciWrite(53, outputFormat);
+      if (streaming != 0)
+        begin
+          ciWrite(41, resultBufferBase);
+          ciWrite(42, stateBufferBase);
+          ciWrite(40, (sobelThreshold << 8) | 1);
+        end
+      // enableCameraInterrupts(CAMERA_IRQ_LINES | CAMERA_IRQ_FRAME, lineInterval)
+      ci(19, 0, enabled);
+      ciWrite(49, irqLines | irqFrame);
+      ciWrite(48, lineInterval);
+      ciWrite(47, enabled | irqLines | irqFrame);
+      if (ring != 0)
+        begin
+          ciWrite(43, ringBase0);
+          ciWrite(44, ringBase1);
+          ciWrite(45, ringBase2);
+          ciWrite(46, ringSize);
+        end
+      else ciWrite(5, frameBufferBase);
+      ciWrite(6, 1);
+      s_cameraOnReg = 1'b1;
+      frameNr = 0;
+      lineIrqs = 0;
+      while (frameNr < nrOfFrames)
+        begin
+          // cameraInterrupt
+          waitCycles = 0;
+          while (irq !== 1'b1 && waitCycles < 4*(sensorHeight + 8)*linePeriod*pclkHalfPeriod/5)
+            begin
+              @(negedge clock);
+              waitCycles = waitCycles + 1;
+            end
+          if (irq !== 1'b1)
+            begin
+              $display("ERROR: no interrupt for frame %0d", frameNr);
+              s_errors = s_errors + 1;
+              frameNr = nrOfFrames;
+            end
+          else
+            begin
+              ci(18, 0, pending);
+              ci(19, 0, enabled);
+              check("enabled pending interrupts", (pending & enabled) != 32'd0, 1);
+              ciWrite(49, pending & enabled);
+              if ((pending & enabled & irqLines) != 32'd0)
+                begin
+                  lineIrqs = lineIrqs + 1;
+                  ci(17, 0, value);
+                  check("lines written at the line interrupt", value, lineIrqs*lineInterval);
+                end
+              if ((pending & enabled & irqFrame) != 32'd0) frameCompleted;
+            end
+        end
+      if (s_errors != 0) $display("ERROR: %0d checks failed", s_errors);
+      $finish;
+    end
+
+endmodule
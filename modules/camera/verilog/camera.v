@@ -23,7 +23,12 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
                 output wire        dataValidOut,
                 output reg  [7:0]  burstSizeOut,
                 input wire         busyIn,
-                                   busErrorIn);
+                                   busErrorIn,
+                                   endTransactionIn,
+                                   dataValidIn,
+                input wire [31:0]  addressDataIn,
+                output reg         readNotWriteOut,
+                output reg         irq);
 
   /*
    *
@@ -31,8 +36,8 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
    *
    * different ci commands:
    * ciValueA:    Description:
-   *     0        Read Nr. of Bytes per line
-   *     1        Read Nr. of Lines per image
+   *     0        Read Nr. of Bytes per line (2 per pixel, of the lines written to memory)
+   *     1        Read Nr. of Lines per image (of the lines written to memory)
    *     2        Read PCLK frequency in kHz
    *     3        Read Frames per second (wait at least 2 s after initializing the camera for a valid value)
    *     4        Read frame buffer address
@@ -40,6 +45,46 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
    *     6        Start/stop image aquisition (ciValueb[1..0] = "01")
    *     6        Take single image (ciValueb[1..0] = "10")
    *     7        Read (self clearing): Single image grabbing done.
+   *     8        Read streaming sobel control
+   *     9        Read result buffer address
+   *    10        Read edge state buffer address
+   *    11-13     Read frame buffer ring address 0-2
+   *    14        Read frame buffer ring size (bits 1..0) and buffer of the current frame (bits 5..4)
+   *    15        Read address of the last completed frame (0 before the first one)
+   *    16        Read number of completed frames
+   *    17        Read number of lines of the current frame that are written to memory
+   *    18        Read pending interrupts (bit 0 line interval, bit 1 frame complete)
+   *    19        Read interrupt enables
+   *    20        Read line interval
+   *    21        Read region of interest origin
+   *    22        Read region of interest size
+   *    23        Read decimation
+   *    24        Read output format
+   *    25        Read color buffer address
+   *    40        Write streaming sobel control: ciValueB[0] = 1 makes the grabber write the sobel/movement result
+   *              instead of the grayscale image, ciValueB[15:8] is the sobel threshold
+   *    41        Write result buffer address (ciValueB)
+   *    42        Write edge state buffer address (ciValueB), one bit per pixel (edge in the previous frame)
+   *    43-45     Write frame buffer ring address 0-2 (ciValueB)
+   *    46        Write frame buffer ring size (ciValueB[1..0]): with 2 or 3 the frames go to the ring addresses in turn,
+   *              switching on vsync, instead of to the frame buffer address (the result buffer address when streaming)
+   *              A frame is only free of tearing when it is processed within (ring size - 1) frame periods. Only
+   *              the one output image rotates, so with the ring format 2, and format 1 while streaming, are taken
+   *              over as format 0.
+   *    47        Write interrupt enables (ciValueB[1..0])
+   *    48        Write line interval (ciValueB[10..0]): the line interrupt is raised every time this many lines are written
+   *              to memory, counted from the start of the frame
+   *    49        Write acknowledge interrupts: clears the pending ones selected by ciValueB[1..0]
+   *    50        Write region of interest origin: ciValueB[10..0] first pixel, ciValueB[26..16] first line
+   *    51        Write region of interest size: ciValueB[10..0] pixels, ciValueB[26..16] lines, 0 up to the end
+   *    52        Write decimation of the region of interest: ciValueB[1..0] horizontal, ciValueB[5..4] vertical,
+   *              0 every pixel, 1 every second, 2 every fourth. Only complete groups of 4 remaining pixels of a line
+   *              are written. The geometry is taken over on vsync.
+   *    53        Write output format (ciValueB[1..0]), taken over on vsync: 0 grayscale (4 pixels per word), 1 RGB565
+   *              (2 pixels per word) to the frame buffer address instead, 2 both, RGB565 to the color buffer address
+   *    54        Write color buffer address (ciValueB)
+   *
+   * The registers from 8 on are written with ciValueA[5] set.
    *
    */
 
@@ -60,6 +105,7 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
   localparam [2:0] DO_BURST1    = 3'd3;
   localparam [2:0] END_TRANS1   = 3'd4;
   localparam [2:0] END_TRANS2   = 3'd5;
+  localparam [2:0] DO_READ1     = 3'd6;
   
   reg [2:0] s_stateMachineReg, s_stateMachineNext;
   reg s_singleShotDoneReg;
@@ -90,12 +136,44 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
    */
   reg[31:0] s_frameBufferBaseReg;
   reg s_grabberActiveReg,s_grabberSingleShotReg;
+  // streaming sobel: the result image (one byte per pixel) and the edges of the previous frame (one bit per pixel)
+  reg[15:0] s_streamControlReg;
+  reg[31:0] s_resultBufferBaseReg, s_stateBufferBaseReg;
+  // ring of frame buffers: the grabber writes a frame to the next buffer of the ring while the last one is processed
+  reg[31:0] s_ringBase0Reg, s_ringBase1Reg, s_ringBase2Reg;
+  reg[1:0]  s_ringSizeReg, s_ringIndexReg;
+  reg[31:0] s_outputBufferReg, s_lastCompletedReg, s_completedFramesReg;
+  // progress of the current frame, so the software can process the lines that are already in memory
+  reg[10:0] s_linesWrittenReg, s_irqLinesReg, s_irqLineCountReg;
+  reg[1:0]  s_irqEnableReg, s_irqPendingReg;
+  // region of interest in camera pixels and lines (a size of 0 extends it to the end) and decimation of it
+  reg[10:0] s_roiXReg, s_roiYReg, s_roiWidthReg, s_roiHeightReg;
+  reg[3:0]  s_decimationReg;
+  // output format and the buffer of the RGB565 image when both formats are written
+  reg[1:0]  s_formatReg;
+  reg[31:0] s_colorBufferBaseReg;
   
   always @(posedge clock)
     begin
-      s_frameBufferBaseReg   <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[2:0] == 3'd5) ? {ciValueB[31:2],2'd0} : s_frameBufferBaseReg;
-      s_grabberActiveReg     <= (reset == 1'b1) ? 1'b0 : (s_isMyCi == 1'b1 && ciValueA[2:0] == 3'd6) ? ciValueB[0]& ~ciValueB[1] : s_grabberActiveReg;
-      s_grabberSingleShotReg <= (reset == 1'b1 || s_singleShotActionReg[0] == 1'b1) ? 1'b0 : (s_isMyCi == 1'b1 && ciValueA[2:0] == 3'd6) ? ciValueB[1]& ~ciValueB[0] : s_grabberSingleShotReg;
+      s_frameBufferBaseReg   <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd5) ? {ciValueB[31:2],2'd0} : s_frameBufferBaseReg;
+      s_grabberActiveReg     <= (reset == 1'b1) ? 1'b0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd6) ? ciValueB[0]& ~ciValueB[1] : s_grabberActiveReg;
+      s_grabberSingleShotReg <= (reset == 1'b1 || s_singleShotActionReg[0] == 1'b1) ? 1'b0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd6) ? ciValueB[1]& ~ciValueB[0] : s_grabberSingleShotReg;
+      s_streamControlReg     <= (reset == 1'b1) ? 16'h7F00 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd40) ? {ciValueB[15:8],7'd0,ciValueB[0]} : s_streamControlReg;
+      s_resultBufferBaseReg  <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd41) ? {ciValueB[31:2],2'd0} : s_resultBufferBaseReg;
+      s_stateBufferBaseReg   <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd42) ? {ciValueB[31:2],2'd0} : s_stateBufferBaseReg;
+      s_ringBase0Reg         <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd43) ? {ciValueB[31:2],2'd0} : s_ringBase0Reg;
+      s_ringBase1Reg         <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd44) ? {ciValueB[31:2],2'd0} : s_ringBase1Reg;
+      s_ringBase2Reg         <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd45) ? {ciValueB[31:2],2'd0} : s_ringBase2Reg;
+      s_ringSizeReg          <= (reset == 1'b1) ? 2'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd46) ? ciValueB[1:0] : s_ringSizeReg;
+      s_irqEnableReg         <= (reset == 1'b1) ? 2'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd47) ? ciValueB[1:0] : s_irqEnableReg;
+      s_irqLinesReg          <= (reset == 1'b1) ? 11'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd48) ? ciValueB[10:0] : s_irqLinesReg;
+      s_roiXReg              <= (reset == 1'b1) ? 11'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd50) ? ciValueB[10:0] : s_roiXReg;
+      s_roiYReg              <= (reset == 1'b1) ? 11'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd50) ? ciValueB[26:16] : s_roiYReg;
+      s_roiWidthReg          <= (reset == 1'b1) ? 11'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd51) ? ciValueB[10:0] : s_roiWidthReg;
+      s_roiHeightReg         <= (reset == 1'b1) ? 11'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd51) ? ciValueB[26:16] : s_roiHeightReg;
+      s_decimationReg        <= (reset == 1'b1) ? 4'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd52) ? {ciValueB[5:4],ciValueB[1:0]} : s_decimationReg;
+      s_formatReg            <= (reset == 1'b1) ? 2'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd53) ? ciValueB[1:0] : s_formatReg;
+      s_colorBufferBaseReg   <= (reset == 1'b1) ? 32'd0 : (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd54) ? {ciValueB[31:2],2'd0} : s_colorBufferBaseReg;
     end
   
   /*
@@ -118,9 +196,7 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
     begin
       s_vsyncDetectReg     <= {s_vsyncDetectReg[0],vsync};
       s_hsyncDetectReg     <= {s_hsyncDetectReg[0],hsync};
-      s_pixelCountValueReg <= (s_hsyncNegEdge == 1'b1) ? s_pixelCountReg : s_pixelCountValueReg;
       s_pixelCountReg      <= (s_hsyncNegEdge == 1'b1) ? 11'd0 : (hsync == 1'b1) ? s_pixelCountReg + 11'd1 : s_pixelCountReg;
-      s_lineCountValueReg  <= (s_vsyncNegEdge == 1'b1) ? s_lineCountReg : s_lineCountValueReg;
       s_lineCountReg       <= (s_vsyncNegEdge == 1'b1) ? 11'd0 : (s_hsyncNegEdge == 1'b1) ? s_lineCountReg + 11'd1 : s_lineCountReg;
       s_pclkCountReg       <= (reset == 1'b1 || s_clockPclkValue == 1'b1) ? 17'd0 : s_pclkCountReg + 17'd1;
       s_pclkCountValueReg  <= (reset == 1'b1) ? 17'd0 : (s_clockPclkValue == 1'b1) ? s_pclkCountReg : s_pclkCountValueReg;
@@ -149,13 +225,31 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
   assign ciResult = (s_isMyCi == 1'b0) ? 32'd0 : s_selectedResult;
 
   always @*
-    case (ciValueA[3:0])
-      4'd0    : s_selectedResult <= {20'd0,s_pixelCountValueReg};
-      4'd1    : s_selectedResult <= {21'd0,s_lineCountValueReg};
-      4'd2    : s_selectedResult <= {15'd0,s_pclkCountValueReg};
-      4'd3    : s_selectedResult <= {24'd0,s_fpsCountValueReg};
-      4'd4    : s_selectedResult <= s_frameBufferBaseReg;
-      4'd7    : s_selectedResult <= {31'd0,s_singleShotDoneReg};
+    case (ciValueA[4:0])
+      5'd0    : s_selectedResult <= {20'd0,s_pixelCountValueReg};
+      5'd1    : s_selectedResult <= {21'd0,s_lineCountValueReg};
+      5'd2    : s_selectedResult <= {15'd0,s_pclkCountValueReg};
+      5'd3    : s_selectedResult <= {24'd0,s_fpsCountValueReg};
+      5'd4    : s_selectedResult <= s_frameBufferBaseReg;
+      5'd7    : s_selectedResult <= {31'd0,s_singleShotDoneReg};
+      5'd8    : s_selectedResult <= {16'd0,s_streamControlReg};
+      5'd9    : s_selectedResult <= s_resultBufferBaseReg;
+      5'd10   : s_selectedResult <= s_stateBufferBaseReg;
+      5'd11   : s_selectedResult <= s_ringBase0Reg;
+      5'd12   : s_selectedResult <= s_ringBase1Reg;
+      5'd13   : s_selectedResult <= s_ringBase2Reg;
+      5'd14   : s_selectedResult <= {26'd0,s_ringIndexReg,2'd0,s_ringSizeReg};
+      5'd15   : s_selectedResult <= s_lastCompletedReg;
+      5'd16   : s_selectedResult <= s_completedFramesReg;
+      5'd17   : s_selectedResult <= {21'd0,s_linesWrittenReg};
+      5'd18   : s_selectedResult <= {30'd0,s_irqPendingReg};
+      5'd19   : s_selectedResult <= {30'd0,s_irqEnableReg};
+      5'd20   : s_selectedResult <= {21'd0,s_irqLinesReg};
+      5'd21   : s_selectedResult <= {5'd0,s_roiYReg,5'd0,s_roiXReg};
+      5'd22   : s_selectedResult <= {5'd0,s_roiHeightReg,5'd0,s_roiWidthReg};
+      5'd23   : s_selectedResult <= {26'd0,s_decimationReg[3:2],2'd0,s_decimationReg[1:0]};
+      5'd24   : s_selectedResult <= {30'd0,s_formatReg};
+      5'd25   : s_selectedResult <= s_colorBufferBaseReg;
       default : s_selectedResult <= 32'd0;
     endcase
 
@@ -164,160 +258,292 @@ module camera #(parameter [7:0] customInstructionId = 8'd0,
    * Here the grabber is defined
    *
    */
-  reg [7:0] s_byte3Reg,s_byte2Reg,s_byte1Reg,s_byte4Reg,s_byte5Reg,s_byte6Reg,s_byte7Reg;
-  reg [8:0] s_busSelectReg;
-  wire [31:0] s_busPixelWord;
-  wire [31:0] s_pixelWord_2 = {s_byte1Reg,camData,s_byte3Reg,s_byte2Reg};
-  wire [31:0] s_pixelWord_1 = {s_byte5Reg,s_byte4Reg,s_byte7Reg,s_byte6Reg};
-  wire [31:0] s_grayscalePixelWord;
-  wire s_weLineBuffer = (s_pixelCountReg[2:0] == 3'b111) ? hsync : 1'b0;
+  reg [10:0] s_frameRoiXReg, s_frameRoiYReg, s_frameRoiWidthReg, s_frameRoiHeightReg, s_roiLineCountReg;
+  reg [3:0]  s_frameDecimationReg;
+  reg [7:0]  s_firstByteReg;
+  reg [31:0] s_grayscalePixelWord;
+  reg [1:0]  s_packCountReg;
+  reg [8:0]  s_lineWordReg;
+  reg        s_weLineBuffer;
+  reg [31:0] s_colorPixelWord;
+  reg [8:0]  s_colorWordReg;
+  reg        s_weColorLineBuffer;
+  reg [8:0]  s_busSelectReg;
+  // the bus side of the line buffers reads one word ahead, so every accepted bus word is followed by the next one
+  wire [8:0]  s_busSelectNext;
+  wire [31:0] s_busPixelWord, s_busColorWord;
+  wire [15:0] s_pixelWord = {s_firstByteReg,camData};
+  // a pixel is kept when it is inside the region of interest and on the decimation grid of it, the kept pixels of a
+  // kept line are packed 4 per word into the line buffers, so the lines only hold the effective geometry; the
+  // RGB565 line buffer gets the same pixels 2 per word, the bus interface decides which of the lines it writes
+  wire [10:0] s_pixelX = s_pixelCountReg[11:1];
+  wire [10:0] s_roiPixelX = s_pixelX - s_frameRoiXReg;
+  wire [10:0] s_roiLineY = s_lineCountReg - s_frameRoiYReg;
+  wire [1:0]  s_hDecimationMask = {s_frameDecimationReg[1], |s_frameDecimationReg[1:0]};
+  wire [1:0]  s_vDecimationMask = {s_frameDecimationReg[3], |s_frameDecimationReg[3:2]};
+  wire s_lineKept = (s_lineCountReg >= s_frameRoiYReg &&
+                     (s_frameRoiHeightReg == 11'd0 || s_roiLineY < s_frameRoiHeightReg) &&
+                     (s_roiLineY[1:0] & s_vDecimationMask) == 2'd0) ? 1'b1 : 1'b0;
+  wire s_pixelKept = (hsync == 1'b1 && s_pixelCountReg[0] == 1'b1 && s_lineKept == 1'b1 && s_pixelX >= s_frameRoiXReg &&
+                      (s_frameRoiWidthReg == 11'd0 || s_roiPixelX < s_frameRoiWidthReg) &&
+                      (s_roiPixelX[1:0] & s_hDecimationMask) == 2'd0) ? 1'b1 : 1'b0;
+  wire s_lineEnd = s_hsyncNegEdge & s_lineKept;
   
- // perform the grayscale conversion of pixel 1
-  wire [7:3] s_red_1 = s_pixelWord_1[15:11];
-  wire [7:2] s_green_1 = s_pixelWord_1[10:5];
-  wire [7:3] s_blue_1 = s_pixelWord_1[4:0];
-  wire [10:4] s_redx2_1 = {2'd0,s_red_1};
-  wire [10:4] s_redx4_1 = {1'b0,s_red_1,1'b0};
-  wire [10:4] s_redSum_1 = s_redx2_1 + s_redx4_1;
-  wire [15:4] s_redSumLo_1 = {5'd0,s_redSum_1};
-  wire [15:4] s_redSumHi_1 = {2'd0,s_redSum_1,3'd0};
-  wire [15:4] s_redResult_1 = s_redSumLo_1 + s_redSumHi_1;
-  wire [9:3] s_bluex1_1 = {2'd0,s_blue_1};
-  wire [9:3] s_bluex2_1 = {1'b0,s_blue_1,1'b0};
-  wire [9:3] s_blueSum_1 = s_bluex1_1 + s_bluex2_1;
-  wire [15:3] s_blueLo_1 = {7'd0,s_blueSum_1};
-  wire [15:3] s_blueHi_1 = {3'd0,s_blue_1,4'd0};
-  wire [15:3] s_blueResult_1 = s_blueLo_1 + s_blueHi_1;
-  wire [9:2] s_greenx1_1 = {2'd0,s_green_1};
-  wire [9:2] s_greenx2_1 = {1'b0,s_green_1,1'b0};
-  wire [9:2] s_greenSum_1 = s_greenx1_1 + s_greenx2_1;
-  wire [15:3] s_greenLo_1 = {5'd0,s_greenSum_1};
-  wire [15:3] s_greenHi_1 = {2'd0,s_greenSum_1,3'd0};
-  wire [15:3] s_greenSum1_1 = s_greenLo_1 + s_greenHi_1;
-  wire [15:3] s_greenx129_1 = {1'b0,s_green_1,1'b0,s_green_1[7:3]}; /* s_green x 10000001b  LSB does not matter anyways */
-  wire [15:3] s_greenResult_1 = s_greenSum1_1 + s_greenx129_1;
-  wire [15:3] s_rbSum_1 = {s_redResult_1,1'b0} + s_blueResult_1;
-  wire [15:3] s_rgbSum_1 = s_rbSum_1 + s_greenResult_1;
-  wire[7:0] s_grayscale_1 = s_rgbSum_1[15:8];
-  // perform the grayscale conversion of pixel 2
-  wire [7:3] s_red_2 = s_pixelWord_1[31:27];
-  wire [7:2] s_green_2 = s_pixelWord_1[26:21];
-  wire [7:3] s_blue_2 = s_pixelWord_1[20:16];
-  wire [10:4] s_redx2_2 = {2'd0,s_red_2};
-  wire [10:4] s_redx4_2 = {1'b0,s_red_2,1'b0};
-  wire [10:4] s_redSum_2 = s_redx2_2 + s_redx4_2;
-  wire [15:4] s_redSumLo_2 = {5'd0,s_redSum_2};
-  wire [15:4] s_redSumHi_2 = {2'd0,s_redSum_2,3'd0};
-  wire [15:4] s_redResult_2 = s_redSumLo_2 + s_redSumHi_2;
-  wire [9:3] s_bluex1_2 = {2'd0,s_blue_2};
-  wire [9:3] s_bluex2_2 = {1'b0,s_blue_2,1'b0};
-  wire [9:3] s_blueSum_2 = s_bluex1_2 + s_bluex2_2;
-  wire [15:3] s_blueLo_2 = {7'd0,s_blueSum_2};
-  wire [15:3] s_blueHi_2 = {3'd0,s_blue_2,4'd0};
-  wire [15:3] s_blueResult_2 = s_blueLo_2 + s_blueHi_2;
-  wire [9:2] s_greenx1_2 = {2'd0,s_green_2};
-  wire [9:2] s_greenx2_2 = {1'b0,s_green_2,1'b0};
-  wire [9:2] s_greenSum_2 = s_greenx1_2 + s_greenx2_2;
-  wire [15:3] s_greenLo_2 = {5'd0,s_greenSum_2};
-  wire [15:3] s_greenHi_2 = {2'd0,s_greenSum_2,3'd0};
-  wire [15:3] s_greenSum1_2 = s_greenLo_2 + s_greenHi_2;
-  wire [15:3] s_greenx129_2 = {1'b0,s_green_2,1'b0,s_green_2[7:3]}; /* s_green x 10000001b  LSB does not matter anyways */
-  wire [15:3] s_greenResult_2 = s_greenSum1_2 + s_greenx129_2;
-  wire [15:3] s_rbSum_2 = {s_redResult_2,1'b0} + s_blueResult_2;
-  wire [15:3] s_rgbSum_2 = s_rbSum_2 + s_greenResult_2;
-  wire[7:0] s_grayscale_2 = s_rgbSum_2[15:8];
-// perform the grayscale conversion of pixel 3
-wire [7:3] s_red_3 = s_pixelWord_2[15:11];
-wire [7:2] s_green_3 = s_pixelWord_2[10:5];
-wire [7:3] s_blue_3 = s_pixelWord_2[4:0];
-wire [10:4] s_redx2_3 = {2'd0,s_red_3};
-wire [10:4] s_redx4_3 = {1'b0,s_red_3,1'b0};
-wire [10:4] s_redSum_3 = s_redx2_3 + s_redx4_3;
-wire [15:4] s_redSumLo_3 = {5'd0,s_redSum_3};
-wire [15:4] s_redSumHi_3 = {2'd0,s_redSum_3,3'd0};
-wire [15:4] s_redResult_3 = s_redSumLo_3 + s_redSumHi_3;
-wire [9:3] s_bluex1_3 = {2'd0,s_blue_3};
-wire [9:3] s_bluex2_3 = {1'b0,s_blue_3,1'b0};
-wire [9:3] s_blueSum_3 = s_bluex1_3 + s_bluex2_3;
-wire [15:3] s_blueLo_3 = {7'd0,s_blueSum_3};
-wire [15:3] s_blueHi_3 = {3'd0,s_blue_3,4'd0};
-wire [15:3] s_blueResult_3 = s_blueLo_3 + s_blueHi_3;
-wire [9:2] s_greenx1_3 = {2'd0,s_green_3};
-wire [9:2] s_greenx2_3 = {1'b0,s_green_3,1'b0};
-wire [9:2] s_greenSum_3 = s_greenx1_3 + s_greenx2_3;
-wire [15:3] s_greenLo_3 = {5'd0,s_greenSum_3};
-wire [15:3] s_greenHi_3 = {2'd0,s_greenSum_3,3'd0};
-wire [15:3] s_greenSum1_3 = s_greenLo_3 + s_greenHi_3;
-wire [15:3] s_greenx129_3 = {1'b0,s_green_3,1'b0,s_green_3[7:3]}; /* s_green x 10000001b  LSB does not matter anyways */
-wire [15:3] s_greenResult_3 = s_greenSum1_3 + s_greenx129_3;
-wire [15:3] s_rbSum_3 = {s_redResult_3,1'b0} + s_blueResult_3;
-wire [15:3] s_rgbSum_3 = s_rbSum_3 + s_greenResult_3;
-wire[7:0] s_grayscale_3 = s_rgbSum_3[15:8];
-// perform the grayscale conversion of pixel 4
-wire [7:3] s_red_4 = s_pixelWord_2[31:27];
-wire [7:2] s_green_4 = s_pixelWord_2[26:21];
-wire [7:3] s_blue_4 = s_pixelWord_2[20:16];
-wire [10:4] s_redx2_4 = {2'd0,s_red_4};
-wire [10:4] s_redx4_4 = {1'b0,s_red_4,1'b0};
-wire [10:4] s_redSum_4 = s_redx2_4 + s_redx4_4;
-wire [15:4] s_redSumLo_4 = {5'd0,s_redSum_4};
-wire [15:4] s_redSumHi_4 = {2'd0,s_redSum_4,3'd0};
-wire [15:4] s_redResult_4 = s_redSumLo_4 + s_redSumHi_4;
-wire [9:3] s_bluex1_4 = {2'd0,s_blue_4};
-wire [9:3] s_bluex2_4 = {1'b0,s_blue_4,1'b0};
-wire [9:3] s_blueSum_4 = s_bluex1_4 + s_bluex2_4;
-wire [15:3] s_blueLo_4 = {7'd0,s_blueSum_4};
-wire [15:3] s_blueHi_4 = {3'd0,s_blue_4,4'd0};
-wire [15:3] s_blueResult_4 = s_blueLo_4 + s_blueHi_4;
-wire [9:2] s_greenx1_4 = {2'd0,s_green_4};
-wire [9:2] s_greenx2_4 = {1'b0,s_green_4,1'b0};
-wire [9:2] s_greenSum_4 = s_greenx1_4 + s_greenx2_4;
-wire [15:3] s_greenLo_4 = {5'd0,s_greenSum_4};
-wire [15:3] s_greenHi_4 = {2'd0,s_greenSum_4,3'd0};
-wire [15:3] s_greenSum1_4 = s_greenLo_4 + s_greenHi_4;
-wire [15:3] s_greenx129_4 = {1'b0,s_green_4,1'b0,s_green_4[7:3]}; /* s_green x 10000001b  LSB does not matter anyways */
-wire [15:3] s_greenResult_4 = s_greenSum1_4 + s_greenx129_4;
-wire [15:3] s_rbSum_4 = {s_redResult_4,1'b0} + s_blueResult_4;
-wire [15:3] s_rgbSum_4 = s_rbSum_4 + s_greenResult_4;
-wire[7:0] s_grayscale_4 = s_rgbSum_4[15:8];
-
-assign s_grayscalePixelWord = {s_grayscale_4,s_grayscale_3,s_grayscale_2,s_grayscale_1};
+  // grayscale conversion of the pixel
+  wire [7:3] s_red = s_pixelWord[15:11];
+  wire [7:2] s_green = s_pixelWord[10:5];
+  wire [7:3] s_blue = s_pixelWord[4:0];
+  wire [10:4] s_redx2 = {2'd0,s_red};
+  wire [10:4] s_redx4 = {1'b0,s_red,1'b0};
+  wire [10:4] s_redSum = s_redx2 + s_redx4;
+  wire [15:4] s_redSumLo = {5'd0,s_redSum};
+  wire [15:4] s_redSumHi = {2'd0,s_redSum,3'd0};
+  wire [15:4] s_redResult = s_redSumLo + s_redSumHi;
+  wire [9:3] s_bluex1 = {2'd0,s_blue};
+  wire [9:3] s_bluex2 = {1'b0,s_blue,1'b0};
+  wire [9:3] s_blueSum = s_bluex1 + s_bluex2;
+  wire [15:3] s_blueLo = {7'd0,s_blueSum};
+  wire [15:3] s_blueHi = {3'd0,s_blue,4'd0};
+  wire [15:3] s_blueResult = s_blueLo + s_blueHi;
+  wire [9:2] s_greenx1 = {2'd0,s_green};
+  wire [9:2] s_greenx2 = {1'b0,s_green,1'b0};
+  wire [9:2] s_greenSum = s_greenx1 + s_greenx2;
+  wire [15:3] s_greenLo = {5'd0,s_greenSum};
+  wire [15:3] s_greenHi = {2'd0,s_greenSum,3'd0};
+  wire [15:3] s_greenSum1 = s_greenLo + s_greenHi;
+  wire [15:3] s_greenx129 = {1'b0,s_green,1'b0,s_green[7:3]}; /* s_green x 10000001b  LSB does not matter anyways */
+  wire [15:3] s_greenResult = s_greenSum1 + s_greenx129;
+  wire [15:3] s_rbSum = {s_redResult,1'b0} + s_blueResult;
+  wire [15:3] s_rgbSum = s_rbSum + s_greenResult;
+  wire[7:0] s_grayscale = s_rgbSum[15:8];
 
   always @(posedge pclk)
     begin
-      s_byte7Reg <= (s_pixelCountReg[2:0] == 3'b000 && hsync == 1'b1) ? camData : s_byte7Reg;
-      s_byte6Reg <= (s_pixelCountReg[2:0] == 3'b001 && hsync == 1'b1) ? camData : s_byte6Reg;
-      s_byte5Reg <= (s_pixelCountReg[2:0] == 3'b010 && hsync == 1'b1) ? camData : s_byte5Reg;
-      s_byte4Reg <= (s_pixelCountReg[2:0] == 3'b011 && hsync == 1'b1) ? camData : s_byte4Reg;
-      s_byte3Reg <= (s_pixelCountReg[2:0] == 3'b100 && hsync == 1'b1) ? camData : s_byte3Reg;
-      s_byte2Reg <= (s_pixelCountReg[2:0] == 3'b101 && hsync == 1'b1) ? camData : s_byte2Reg;
-      s_byte1Reg <= (s_pixelCountReg[2:0] == 3'b110 && hsync == 1'b1) ? camData : s_byte1Reg;
+      s_firstByteReg       <= (s_pixelCountReg[0] == 1'b0 && hsync == 1'b1) ? camData : s_firstByteReg;
+      s_grayscalePixelWord <= (s_pixelKept == 1'b1) ? {s_grayscale,s_grayscalePixelWord[31:8]} : s_grayscalePixelWord;
+      s_packCountReg       <= (s_hsyncNegEdge == 1'b1) ? 2'd0 : (s_pixelKept == 1'b1) ? s_packCountReg + 2'd1 : s_packCountReg;
+      s_weLineBuffer       <= (s_pixelKept == 1'b1 && s_packCountReg == 2'd3) ? 1'b1 : 1'b0;
+      s_lineWordReg        <= (s_hsyncNegEdge == 1'b1) ? 9'd0 : (s_weLineBuffer == 1'b1) ? s_lineWordReg + 9'd1 : s_lineWordReg;
+      s_colorPixelWord     <= (s_pixelKept == 1'b1) ? {s_pixelWord,s_colorPixelWord[31:16]} : s_colorPixelWord;
+      s_weColorLineBuffer  <= (s_pixelKept == 1'b1 && s_packCountReg[0] == 1'b1) ? 1'b1 : 1'b0;
+      s_colorWordReg       <= (s_hsyncNegEdge == 1'b1) ? 9'd0 : (s_weColorLineBuffer == 1'b1) ? s_colorWordReg + 9'd1 : s_colorWordReg;
+      // the geometry is taken over at the start of a frame, the measurements report the effective one
+      s_frameRoiXReg       <= (reset == 1'b1) ? 11'd0 : (s_vsyncNegEdge == 1'b1) ? s_roiXReg : s_frameRoiXReg;
+      s_frameRoiYReg       <= (reset == 1'b1) ? 11'd0 : (s_vsyncNegEdge == 1'b1) ? s_roiYReg : s_frameRoiYReg;
+      s_frameRoiWidthReg   <= (reset == 1'b1) ? 11'd0 : (s_vsyncNegEdge == 1'b1) ? s_roiWidthReg : s_frameRoiWidthReg;
+      s_frameRoiHeightReg  <= (reset == 1'b1) ? 11'd0 : (s_vsyncNegEdge == 1'b1) ? s_roiHeightReg : s_frameRoiHeightReg;
+      s_frameDecimationReg <= (reset == 1'b1) ? 4'd0 : (s_vsyncNegEdge == 1'b1) ? s_decimationReg : s_frameDecimationReg;
+      s_roiLineCountReg    <= (s_vsyncNegEdge == 1'b1) ? 11'd0 : (s_lineEnd == 1'b1) ? s_roiLineCountReg + 11'd1 : s_roiLineCountReg;
+      s_pixelCountValueReg <= (s_lineEnd == 1'b1) ? {s_lineWordReg,3'd0} : s_pixelCountValueReg;
+      s_lineCountValueReg  <= (s_vsyncNegEdge == 1'b1) ? s_roiLineCountReg : s_lineCountValueReg;
     end
   
-  dualPortRam2k lineBuffer ( .address1(s_pixelCountReg[11:3]),
-                             .address2(s_busSelectReg),
+  dualPortRam2k lineBuffer ( .address1(s_lineWordReg),
+                             .address2(s_busSelectNext),
                              .clock1(pclk),
                              .clock2(clock),
                              .writeEnable(s_weLineBuffer),
                              .dataIn1(s_grayscalePixelWord),
                              .dataOut2(s_busPixelWord));
 
+  dualPortRam2k colorLineBuffer ( .address1(s_colorWordReg),
+                                  .address2(s_busSelectNext),
+                                  .clock1(pclk),
+                                  .clock2(clock),
+                                  .writeEnable(s_weColorLineBuffer),
+                                  .dataIn1(s_colorPixelWord),
+                                  .dataOut2(s_busColorWord));
+
   /*
    *
-   * Here the bus interface is defined
+   * Here the streaming sobel filter is defined: the two lines above the current one are kept in line buffers, and
+   * every gray word of the current line completes the window of the group of 4 pixels before it in the line above.
+   * The filter thus runs one line behind the camera: while line L arrives it writes the movement values of line L-1
+   * (127 no edge, 0 edge also in the previous frame, 255 new edge) in the result buffer and their edge bits in the
+   * state buffer, using the edge bits of the previous frame that the bus interface read for line L-1. The last group
+   * of a line is filtered when hsync falls, with zeros right of it. The first and last line and column are not valid.
    *
    */
+  reg [31:0] s_streamTopReg, s_streamMiddleReg, s_streamBottomReg; // words of the group that is filtered next
+  reg [7:0]  s_streamTopLastReg, s_streamMiddleLastReg, s_streamBottomLastReg; // last pixel of the group before it
+  reg [7:0]  s_streamWindow [17:0];
+  reg [8:0]  s_streamWordReg, s_streamGroupReg;
+  reg        s_streamWordValidReg, s_streamFilterReg;
+  reg [3:0]  s_streamPreviousReg;     // edges of the previous frame of the filtered group
+  reg [31:0] s_streamEdgesReg;        // edges of the groups before it in the same state word
+  wire [31:0] s_lineAbove, s_lineTwoAbove, s_previousEdges;
+  // bus side of the buffers
+  wire [31:0] s_busResultWord, s_busStateWord;
+  reg  [31:0] s_addressDataInReg;
+  reg         s_stateParityReg, s_endTransactionInReg, s_dataValidInReg;
+  wire        s_stateReadValid = (s_stateMachineReg == DO_READ1) ? s_dataValidInReg : 1'b0;
+  wire        s_streamStep = s_weLineBuffer | s_lineEnd;
+  wire [31:0] s_streamNewWord = (s_lineEnd == 1'b1) ? 32'd0 : s_grayscalePixelWord;
+  wire [31:0] s_streamNewAbove = (s_lineEnd == 1'b1) ? 32'd0 : s_lineAbove;
+  wire [31:0] s_streamNewTwoAbove = (s_lineEnd == 1'b1) ? 32'd0 : s_lineTwoAbove;
+  wire [3:0]  s_streamEdges;
+  wire [31:0] s_streamResult;
+  wire [31:0] s_streamState = ((s_streamGroupReg[2:0] == 3'd0) ? 32'd0 : s_streamEdgesReg) | ({28'd0,s_streamEdges} << {s_streamGroupReg[2:0],2'd0});
+  integer n;
+  
+  always @(posedge pclk)
+    begin
+      s_streamWordValidReg <= (s_lineEnd == 1'b1) ? 1'b0 : (s_weLineBuffer == 1'b1) ? 1'b1 : s_streamWordValidReg;
+      s_streamWordReg      <= (s_weLineBuffer == 1'b1) ? s_lineWordReg : s_streamWordReg;
+      s_streamFilterReg    <= s_streamStep & s_streamWordValidReg;
+      if (s_streamStep == 1'b1)
+        begin
+          s_streamGroupReg      <= s_streamWordReg;
+          s_streamPreviousReg   <= s_previousEdges[{s_streamWordReg[2:0],2'd0} +: 4];
+          s_streamTopLastReg    <= s_streamTopReg[31:24];
+          s_streamMiddleLastReg <= s_streamMiddleReg[31:24];
+          s_streamBottomLastReg <= s_streamBottomReg[31:24];
+          s_streamTopReg        <= s_streamNewTwoAbove;
+          s_streamMiddleReg     <= s_streamNewAbove;
+          s_streamBottomReg     <= s_streamNewWord;
+          s_streamWindow[0]     <= s_streamTopLastReg;
+          s_streamWindow[6]     <= s_streamMiddleLastReg;
+          s_streamWindow[12]    <= s_streamBottomLastReg;
+          for (n = 0; n < 4; n = n + 1)
+            begin
+              s_streamWindow[n+1]  <= s_streamTopReg[n*8 +: 8];
+              s_streamWindow[n+7]  <= s_streamMiddleReg[n*8 +: 8];
+              s_streamWindow[n+13] <= s_streamBottomReg[n*8 +: 8];
+            end
+          s_streamWindow[5]     <= s_streamNewTwoAbove[7:0];
+          s_streamWindow[11]    <= s_streamNewAbove[7:0];
+          s_streamWindow[17]    <= s_streamNewWord[7:0];
+        end
+      s_streamEdgesReg     <= (s_streamFilterReg == 1'b1) ? s_streamState : s_streamEdgesReg;
+    end
+
+  genvar pixel;
+  generate
+    for (pixel = 0; pixel < 4; pixel = pixel + 1)
+      begin : streamSobel
+        wire signed [10:0] s_gx = s_streamWindow[pixel] - s_streamWindow[pixel+2] + (s_streamWindow[pixel+6]<<1) -
+                                  (s_streamWindow[pixel+8]<<1) + s_streamWindow[pixel+12] - s_streamWindow[pixel+14];
+        wire signed [10:0] s_gy = s_streamWindow[pixel+12] + (s_streamWindow[pixel+13]<<1) + s_streamWindow[pixel+14] -
+                                  (s_streamWindow[pixel] + (s_streamWindow[pixel+1]<<1) + s_streamWindow[pixel+2]);
+        wire [10:0] s_absGx = (s_gx < 0) ? -s_gx : s_gx;
+        wire [10:0] s_absGy = (s_gy < 0) ? -s_gy : s_gy;
+        assign s_streamEdges[pixel] = (s_absGx + s_absGy < {3'd0,s_streamControlReg[15:8]}) ? 1'b0 : 1'b1;
+        assign s_streamResult[pixel*8 +: 8] = (s_streamEdges[pixel] == 1'b0) ? 8'd127 :
+                                              (s_streamPreviousReg[pixel] == 1'b1) ? 8'd0 : 8'd255;
+      end
+  endgenerate
+
+  // line L-1 (above) and L-2 (two above) of the current line L
+  dualPortRam2k lineAbove ( .address1(s_lineWordReg),
+                            .address2(s_lineWordReg),
+                            .clock1(pclk),
+                            .clock2(pclk),
+                            .writeEnable(s_weLineBuffer),
+                            .dataIn1(s_grayscalePixelWord),
+                            .dataOut2(s_lineAbove));
+
+  dualPortRam2k lineTwoAbove ( .address1(s_lineWordReg),
+                               .address2(s_lineWordReg),
+                               .clock1(pclk),
+                               .clock2(pclk),
+                               .writeEnable(s_weLineBuffer),
+                               .dataIn1(s_lineAbove),
+                               .dataOut2(s_lineTwoAbove));
+
+  dualPortRam2k resultBuffer ( .address1(s_streamGroupReg),
+                               .address2(s_busSelectNext),
+                               .clock1(pclk),
+                               .clock2(clock),
+                               .writeEnable(s_streamFilterReg),
+                               .dataIn1(s_streamResult),
+                               .dataOut2(s_busResultWord));
+
+  dualPortRam2k stateBuffer ( .address1({3'd0,s_streamGroupReg[8:3]}),
+                              .address2(s_busSelectNext),
+                              .clock1(pclk),
+                              .clock2(clock),
+                              .writeEnable(s_streamFilterReg),
+                              .dataIn1(s_streamState),
+                              .dataOut2(s_busStateWord));
+
+  // two lines of edges of the previous frame, line M at M[0]: read by the bus interface one line before they are used
+  dualPortRam2k previousStateBuffer ( .address1({3'd0,s_stateParityReg,s_busSelectReg[4:0]}),
+                                      .address2({3'd0,~s_roiLineCountReg[0],s_streamWordReg[7:3]}),
+                                      .clock1(clock),
+                                      .clock2(pclk),
+                                      .writeEnable(s_stateReadValid),
+                                      .dataIn1(s_addressDataInReg),
+                                      .dataOut2(s_previousEdges));
+
+  /*
+   *
+   * Here the bus interface is defined: after every line it writes the grayscale line, or with the streaming sobel
+   * filter the result and the edge bits of the line before it and reads the previous edge bits of the next line (the
+   * ones of the first line at the start of the frame), and with an RGB565 output format the RGB565 line, one transfer
+   * after the other.
+   *
+   */
+  localparam [2:0] TRANSFER_PIXELS     = 3'd0;
+  localparam [2:0] TRANSFER_RESULT     = 3'd1;
+  localparam [2:0] TRANSFER_STATE      = 3'd2;
+  localparam [2:0] TRANSFER_READ_STATE = 3'd3;
+  localparam [2:0] TRANSFER_COLOR      = 3'd4;
+
   reg [31:0] s_busAddressReg, s_addressDataOutReg;
-  reg [8:0] s_nrOfPixelsPerLineReg;
+  reg [31:0] s_resultAddressReg, s_stateWriteAddressReg, s_stateReadAddressReg;
+  reg [8:0] s_wordsLeftReg;
   reg [1:0] s_singleShotActionReg;
   reg s_dataValidReg;
   reg [8:0] s_burstCountReg;
-  reg  s_grabberRunningReg;
+  reg  s_grabberRunningReg, s_streamRunningReg, s_streamFrameStartReg;
+  reg [4:0] s_transfersPendingReg;
+  reg [2:0] s_transferReg;
+  reg [1:0] s_formatRunningReg;
+  reg [31:0] s_colorAddressReg;
+  reg [10:0] s_busLineCountReg;
   wire s_newScreen, s_newLine;
   wire s_doWrite = ((s_stateMachineReg == DO_BURST1) && s_burstCountReg[8] == 1'b0) ? ~busyIn : 1'b0;
-  wire [31:0] s_busAddressNext = (reset == 1'b1 || s_newScreen == 1'b1) ? s_frameBufferBaseReg : 
-                                 (s_doWrite == 1'b1) ? s_busAddressReg + 32'd4 : s_busAddressReg;
-  wire [7:0] s_burstSizeNext = ((s_stateMachineReg == INIT_BURST1) && s_nrOfPixelsPerLineReg > 9'd16) ? 8'd16 : (s_nrOfPixelsPerLineReg[7:0]);
+  assign s_busSelectNext = (s_stateMachineReg == IDLE) ? 9'd0 : (s_doWrite == 1'b1 || s_stateReadValid == 1'b1) ? s_busSelectReg + 9'd1 : s_busSelectReg;
+  wire s_grabbing = s_grabberRunningReg | s_singleShotActionReg[0];
+  wire s_streaming = s_grabbing & s_streamRunningReg;
+  wire [8:0] s_lineWords = s_pixelCountValueReg[11:3];
+  wire [8:0] s_stateWords = {3'd0,s_lineWords[8:3]} + ((s_lineWords[2:0] == 3'd0) ? 9'd0 : 9'd1);
+  wire s_lineHasWords = (s_lineWords != 9'd0) ? 1'b1 : 1'b0; // a region of interest outside the line leaves nothing to transfer
+  wire [8:0] s_colorWords = {s_lineWords[7:0],1'b0};
+  // the RGB565 line goes after the grayscale or result line, so it ends the line
+  wire [2:0] s_nextTransfer = (s_transfersPendingReg[0] == 1'b1) ? TRANSFER_PIXELS :
+                              (s_transfersPendingReg[1] == 1'b1) ? TRANSFER_RESULT :
+                              (s_transfersPendingReg[4] == 1'b1) ? TRANSFER_COLOR :
+                              (s_transfersPendingReg[2] == 1'b1) ? TRANSFER_STATE : TRANSFER_READ_STATE;
+  wire [4:0] s_transfersLeft = (s_stateMachineReg == IDLE) ? s_transfersPendingReg & ~(5'd1 << s_nextTransfer) : s_transfersPendingReg;
+  wire s_colorRunning = (s_formatRunningReg != 2'd0) ? 1'b1 : 1'b0;
+  wire s_grayRunning = (s_formatRunningReg != 2'd1) ? 1'b1 : 1'b0;
+  // a grabbed frame is complete on the next vsync, the frame after it goes to the next buffer of the ring
+  wire s_ringActive = s_ringSizeReg[1];
+  wire [1:0] s_ringIndexNext = (s_newScreen == 1'b1 && s_grabbing == 1'b1 && s_ringActive == 1'b1) ?
+                               ((s_ringIndexReg >= s_ringSizeReg - 2'd1) ? 2'd0 : s_ringIndexReg + 2'd1) : s_ringIndexReg;
+  wire [31:0] s_ringBase = (s_ringIndexNext == 2'd0) ? s_ringBase0Reg : (s_ringIndexNext == 2'd1) ? s_ringBase1Reg : s_ringBase2Reg;
+  wire [31:0] s_frameBase = (s_ringActive == 1'b1) ? s_ringBase : s_frameBufferBaseReg;
+  wire [31:0] s_resultBase = (s_ringActive == 1'b1) ? s_ringBase : s_resultBufferBaseReg;
+  wire [31:0] s_colorBase = (s_formatReg == 2'd1) ? s_frameBase : s_colorBufferBaseReg;
+  // the ring holds the one output image, a second one would stay at a single address or collide with the first
+  wire [1:0]  s_formatNext = (s_ringActive == 1'b1 && (s_formatReg[1] == 1'b1 || s_streamControlReg[0] == 1'b1)) ? 2'd0 : s_formatReg;
+  wire [31:0] s_busAddressNext = (reset == 1'b1 || s_newScreen == 1'b1) ? s_frameBase : 
+                                 (s_doWrite == 1'b1 && s_transferReg == TRANSFER_PIXELS) ? s_busAddressReg + 32'd4 : s_busAddressReg;
+  wire [31:0] s_transferAddress = (s_transferReg == TRANSFER_PIXELS) ? s_busAddressReg :
+                                  (s_transferReg == TRANSFER_RESULT) ? s_resultAddressReg :
+                                  (s_transferReg == TRANSFER_COLOR) ? s_colorAddressReg :
+                                  (s_transferReg == TRANSFER_STATE) ? s_stateWriteAddressReg : s_stateReadAddressReg;
+  wire [31:0] s_transferWord = (s_transferReg == TRANSFER_PIXELS) ? s_busPixelWord :
+                               (s_transferReg == TRANSFER_RESULT) ? s_busResultWord :
+                               (s_transferReg == TRANSFER_COLOR) ? s_busColorWord : s_busStateWord;
+  wire [7:0] s_burstSizeNext = ((s_stateMachineReg == INIT_BURST1) && s_wordsLeftReg > 9'd16) ? 8'd16 : (s_wordsLeftReg[7:0]);
+  // a line is in memory when the last burst of its RGB565 transfer, or without it of its grayscale or result transfer ends
+  wire s_lineWritten = (s_stateMachineReg == END_TRANS1 && s_wordsLeftReg == 9'd0 &&
+                        (s_transferReg == TRANSFER_COLOR || (s_transferReg[2:1] == 2'd0 && s_colorRunning == 1'b0))) ? 1'b1 : 1'b0;
+  wire s_irqAcknowledge = (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd49) ? 1'b1 : 1'b0;
+  wire [1:0] s_irqEvents = {s_newScreen & s_grabbing, (s_newScreen == 1'b0 && s_lineWritten == 1'b1 && s_irqLineCountReg == 11'd1) ? 1'b1 : 1'b0};
+  wire [1:0] s_irqPendingNext = (s_irqPendingReg & ~((s_irqAcknowledge == 1'b1) ? ciValueB[1:0] : 2'd0)) | s_irqEvents;
   
   assign requestBus        = (s_stateMachineReg == REQUEST_BUS1) ? 1'b1 : 1'b0;
   assign addressDataOut    = s_addressDataOutReg;
@@ -325,39 +551,80 @@ assign s_grayscalePixelWord = {s_grayscale_4,s_grayscale_3,s_grayscale_2,s_grays
   
   always @*
     case (s_stateMachineReg)
-      IDLE            : s_stateMachineNext <= ((s_grabberRunningReg == 1'b1 || s_singleShotActionReg[0] == 1'b1) && s_newLine == 1'b1) ? REQUEST_BUS1 : IDLE;
+      IDLE            : s_stateMachineNext <= (s_transfersPendingReg != 5'd0) ? REQUEST_BUS1 : IDLE;
       REQUEST_BUS1    : s_stateMachineNext <= (busGrant == 1'b1) ? INIT_BURST1 : REQUEST_BUS1;
-      INIT_BURST1     : s_stateMachineNext <= DO_BURST1;
+      INIT_BURST1     : s_stateMachineNext <= (s_transferReg == TRANSFER_READ_STATE) ? DO_READ1 : DO_BURST1;
       DO_BURST1       : s_stateMachineNext <= (busErrorIn == 1'b1) ? END_TRANS2 :
                                               (s_burstCountReg[8] == 1'b1 && busyIn == 1'b0) ? END_TRANS1 : DO_BURST1;
-      END_TRANS1      : s_stateMachineNext <= (s_nrOfPixelsPerLineReg != 9'd0) ? REQUEST_BUS1 : IDLE;
+      END_TRANS1      : s_stateMachineNext <= (s_wordsLeftReg != 9'd0) ? REQUEST_BUS1 : IDLE;
+      DO_READ1        : s_stateMachineNext <= (s_endTransactionInReg == 1'b0) ? DO_READ1 :
+                                              (s_wordsLeftReg != 9'd0) ? REQUEST_BUS1 : IDLE;
       default         : s_stateMachineNext <= IDLE;
     endcase
   
   always @(posedge clock)
     begin
       s_busAddressReg        <= s_busAddressNext;
+      s_resultAddressReg     <= (reset == 1'b1 || s_newScreen == 1'b1) ? s_resultBase :
+                                (s_doWrite == 1'b1 && s_transferReg == TRANSFER_RESULT) ? s_resultAddressReg + 32'd4 : s_resultAddressReg;
+      s_stateWriteAddressReg <= (reset == 1'b1 || s_newScreen == 1'b1) ? s_stateBufferBaseReg :
+                                (s_doWrite == 1'b1 && s_transferReg == TRANSFER_STATE) ? s_stateWriteAddressReg + 32'd4 : s_stateWriteAddressReg;
+      s_colorAddressReg      <= (reset == 1'b1 || s_newScreen == 1'b1) ? s_colorBase :
+                                (s_doWrite == 1'b1 && s_transferReg == TRANSFER_COLOR) ? s_colorAddressReg + 32'd4 : s_colorAddressReg;
+      s_formatRunningReg     <= (reset == 1'b1) ? 2'd0 : (s_newScreen == 1'b1) ? s_formatNext : s_formatRunningReg;
+      s_stateReadAddressReg  <= (reset == 1'b1 || s_newScreen == 1'b1) ? s_stateBufferBaseReg :
+                                (s_stateReadValid == 1'b1) ? s_stateReadAddressReg + 32'd4 : s_stateReadAddressReg;
       s_grabberRunningReg    <= (reset == 1'b1) ? 1'b0 : (s_newScreen == 1'b1) ? s_grabberActiveReg : s_grabberRunningReg;
+      s_ringIndexReg         <= (reset == 1'b1 || (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd46)) ? 2'd0 : s_ringIndexNext;
+      s_outputBufferReg      <= (s_newScreen == 1'b1) ? ((s_streamControlReg[0] == 1'b1) ? s_resultBase :
+                                                         (s_formatReg == 2'd1) ? s_colorBase : s_frameBase) : s_outputBufferReg;
+      s_lastCompletedReg     <= (reset == 1'b1) ? 32'd0 : (s_newScreen == 1'b1 && s_grabbing == 1'b1) ? s_outputBufferReg : s_lastCompletedReg;
+      s_completedFramesReg   <= (reset == 1'b1) ? 32'd0 : (s_newScreen == 1'b1 && s_grabbing == 1'b1) ? s_completedFramesReg + 32'd1 : s_completedFramesReg;
+      s_streamRunningReg     <= (reset == 1'b1) ? 1'b0 : (s_newScreen == 1'b1) ? s_streamControlReg[0] : s_streamRunningReg;
+      s_streamFrameStartReg  <= ~reset & s_newScreen;
+      s_busLineCountReg      <= (s_newScreen == 1'b1) ? 11'd0 : (s_newLine == 1'b1) ? s_busLineCountReg + 11'd1 : s_busLineCountReg;
+      s_linesWrittenReg      <= (reset == 1'b1 || s_newScreen == 1'b1) ? 11'd0 : (s_lineWritten == 1'b1) ? s_linesWrittenReg + 11'd1 : s_linesWrittenReg;
+      s_irqLineCountReg      <= (reset == 1'b1 || s_newScreen == 1'b1) ? s_irqLinesReg :
+                                (s_lineWritten == 1'b1) ? ((s_irqLineCountReg <= 11'd1) ? s_irqLinesReg : s_irqLineCountReg - 11'd1) : s_irqLineCountReg;
+      s_irqPendingReg        <= (reset == 1'b1) ? 2'd0 : s_irqPendingNext;
+      // like the ramDmaCi the interrupt drops for a cycle on an acknowledge, so a remaining one gives a new edge
+      irq                    <= (reset == 1'b1 || s_irqAcknowledge == 1'b1) ? 1'b0 :
+                                ((s_irqPendingNext & s_irqEnableReg) != 2'd0) ? 1'b1 : 1'b0;
+      // the previous edges of the first line are read at the start of the frame, the ones of line L+1 after line L
+      s_stateParityReg       <= (s_newScreen == 1'b1) ? 1'b0 :
+                                (s_stateMachineReg == DO_READ1 && s_endTransactionInReg == 1'b1 && s_wordsLeftReg == 9'd0) ? ~s_stateParityReg : s_stateParityReg;
+      s_transfersPendingReg  <= (reset == 1'b1) ? 5'd0 :
+                                (s_newLine == 1'b1 && s_lineHasWords == 1'b1) ? s_transfersLeft | {s_grabbing & s_colorRunning,
+                                                                               s_streaming & ((s_busLineCountReg + 11'd1 < s_lineCountValueReg) ? 1'b1 : 1'b0),
+                                                                               {2{s_streaming & ((s_busLineCountReg != 11'd0) ? 1'b1 : 1'b0)}},
+                                                                               s_grabbing & ~s_streamRunningReg & s_grayRunning} :
+                                (s_streamFrameStartReg == 1'b1 && s_lineHasWords == 1'b1) ? s_transfersLeft | {1'b0,s_streaming,3'd0} : s_transfersLeft;
+      s_transferReg          <= (s_stateMachineReg == IDLE) ? s_nextTransfer : s_transferReg;
+      s_endTransactionInReg  <= endTransactionIn;
+      s_dataValidInReg       <= dataValidIn;
+      s_addressDataInReg     <= addressDataIn;
       // s_singleShotActionReg  <= (reset == 1'b1 || s_singleShotActionReg[1] == 1'b1) ? 2'b0 : (s_newScreen == 1'b1) ? {1'b0,s_grabberSingleShotReg} : s_singleShotActionReg;
       // s_singleShotDoneReg    <= (reset == 1'b1 || (s_isMyCi == 1'b1 && ciValueA[2:0] == 3'd7)) ? 1'b1 : (s_singleShotActionReg[1] == 1'b1) ? 1'b1 : s_singleShotDoneReg;
       s_singleShotActionReg  <= (reset == 1'b1 || s_singleShotActionReg[1] == 1'b1) ? 2'b0 : 
                                                   (s_newScreen == 1'b1) ? {s_singleShotActionReg[0],s_grabberSingleShotReg} : s_singleShotActionReg;
-      s_singleShotDoneReg    <= (reset == 1'b1 || (s_isMyCi == 1'b1 && ciValueA[2:0] == 3'd6 && ciValueB[1] == 1'b1 && ciValueB[0] == 1'b0)) ? 1'b0 : 
+      s_singleShotDoneReg    <= (reset == 1'b1 || (s_isMyCi == 1'b1 && ciValueA[5:0] == 6'd6 && ciValueB[1] == 1'b1 && ciValueB[0] == 1'b0)) ? 1'b0 : 
                                                   (s_singleShotActionReg[1] == 1'b1) ? 1'b1 : s_singleShotDoneReg;
       s_stateMachineReg      <= (reset == 1'b1) ? IDLE : s_stateMachineNext;
       beginTransactionOut    <= (s_stateMachineReg == INIT_BURST1) ? 1'd1 : 1'd0;
+      readNotWriteOut        <= (s_stateMachineReg == INIT_BURST1 && s_transferReg == TRANSFER_READ_STATE) ? 1'b1 : 1'b0;
       byteEnablesOut         <= (s_stateMachineReg == INIT_BURST1) ? 4'hF : 4'd0;
-      s_addressDataOutReg    <= (s_stateMachineReg == INIT_BURST1) ? s_busAddressReg : 
-                                (s_doWrite == 1'b1) ? s_busPixelWord :
+      s_addressDataOutReg    <= (s_stateMachineReg == INIT_BURST1) ? s_transferAddress : 
+                                (s_doWrite == 1'b1) ? s_transferWord :
                                 (busyIn == 1'b1) ? s_addressDataOutReg : 32'd0;
       s_dataValidReg         <= (s_doWrite == 1'b1) ? 1'b1 : (busyIn == 1'b1) ? s_dataValidReg : 1'b0;
       endTransactionOut      <= (s_stateMachineReg == END_TRANS1 || s_stateMachineReg == END_TRANS2) ? 1'b1 : 1'b0;
       burstSizeOut           <= (s_stateMachineReg == INIT_BURST1) ? s_burstSizeNext - 8'd1 : 8'd0;
       s_burstCountReg        <= (s_stateMachineReg == INIT_BURST1) ? s_burstSizeNext - 8'd1 :
                                 (s_doWrite == 1'b1) ? s_burstCountReg - 9'd1 : s_burstCountReg;
-      s_busSelectReg         <= (s_stateMachineReg == IDLE) ? 9'd0 : (s_doWrite == 1'b1) ? s_busSelectReg + 9'd1 : s_busSelectReg;
-      s_nrOfPixelsPerLineReg <= (s_newLine == 1'b1) ? (s_pixelCountValueReg[11:3]):
-                                (s_stateMachineReg == INIT_BURST1) ? s_nrOfPixelsPerLineReg - {1'b0,s_burstSizeNext} : s_nrOfPixelsPerLineReg;
+      s_busSelectReg         <= s_busSelectNext;
+      s_wordsLeftReg         <= (s_stateMachineReg == IDLE) ? ((s_nextTransfer == TRANSFER_COLOR) ? s_colorWords :
+                                                                (s_nextTransfer[1] == 1'b0) ? s_lineWords : s_stateWords) :
+                                (s_stateMachineReg == INIT_BURST1) ? s_wordsLeftReg - {1'b0,s_burstSizeNext} : s_wordsLeftReg;
     end
   
   synchroFlop sns ( .clockIn(pclk),
@@ -369,7 +636,7 @@ assign s_grayscalePixelWord = {s_grayscale_4,s_grayscale_3,s_grayscale_2,s_grays
   synchroFlop snl ( .clockIn(pclk),
                     .clockOut(clock),
                     .reset(reset),
-                    .D(s_hsyncNegEdge),
+                    .D(s_lineEnd),
                     .Q(s_newLine) );
   
 endmodule
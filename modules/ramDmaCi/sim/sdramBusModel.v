@@ -0,0 +1,91 @@
+/*
+ * Behavioral model of the sdram controller as seen from the bus: a word
+ * array that answers read bursts after readLatency cycles with one word per
+ * cycle followed by an end of transaction, and stores write bursts as they
+ * come. Every writeBusyPeriod-th cycle of a write burst busy is raised, as
+ * the controller does when its write fifo is full (0 disables it).
+ */
+module sdramBusModel #( parameter nrOfWords = 1048576,
+                        parameter readLatency = 8,
+                        parameter writeBusyPeriod = 0 )
+                      ( input wire         clock,
+                                           reset,
+                        input wire         beginTransactionIn,
+                                           endTransactionIn,
+                                           readNotWriteIn,
+                                           dataValidIn,
+                        input wire [31:0]  addressDataIn,
+                        input wire [7:0]   burstSizeIn,
+                        output reg         endTransactionOut,
+                                           dataValidOut,
+                        output wire        busyOut,
+                                           busErrorOut,
+                        output reg [31:0]  addressDataOut );
+
+  reg [31:0] memory [0:nrOfWords-1];
+
+  localparam [2:0] IDLE = 3'd0;
+  localparam [2:0] WAIT_READ = 3'd1;
+  localparam [2:0] DO_READ = 3'd2;
+  localparam [2:0] END_READ = 3'd3;
+  localparam [2:0] DO_WRITE = 3'd4;
+
+  reg [2:0]  s_stateReg;
+  reg [29:0] s_wordAddressReg;
+  reg [8:0]  s_wordsLeftReg;
+  reg [7:0]  s_latencyReg;
+  reg [7:0]  s_busyCountReg;
+
+  assign busErrorOut = 1'b0;
+  assign busyOut = (writeBusyPeriod != 0 && s_stateReg == DO_WRITE && s_busyCountReg == 8'd0) ? 1'b1 : 1'b0;
+
+  always @(posedge clock)
+    if (reset == 1'b1)
+      begin
+        s_stateReg        <= IDLE;
+        endTransactionOut <= 1'b0;
+        dataValidOut      <= 1'b0;
+        addressDataOut    <= 32'd0;
+        s_busyCountReg    <= 8'd0;
+      end
+    else
+      begin
+        endTransactionOut <= 1'b0;
+        dataValidOut      <= 1'b0;
+        addressDataOut    <= 32'd0;
+        s_busyCountReg    <= (s_stateReg != DO_WRITE || s_busyCountReg == 8'd0) ? writeBusyPeriod - 1 : s_busyCountReg - 8'd1;
+        case (s_stateReg)
+          IDLE      : if (beginTransactionIn == 1'b1)
+                        begin
+                          s_wordAddressReg <= addressDataIn[31:2];
+                          s_wordsLeftReg   <= {1'b0,burstSizeIn} + 9'd1;
+                          s_latencyReg     <= readLatency;
+                          s_stateReg       <= (readNotWriteIn == 1'b1) ? WAIT_READ : DO_WRITE;
+                        end
+          WAIT_READ : if (s_latencyReg <= 8'd1) s_stateReg <= DO_READ;
+                      else s_latencyReg <= s_latencyReg - 8'd1;
+          DO_READ   : begin
+                        dataValidOut     <= 1'b1;
+                        addressDataOut   <= (s_wordAddressReg < nrOfWords) ? memory[s_wordAddressReg] : 32'd0;
+                        s_wordAddressReg <= s_wordAddressReg + 30'd1;
+                        s_wordsLeftReg   <= s_wordsLeftReg - 9'd1;
+                        if (s_wordsLeftReg == 9'd1) s_stateReg <= END_READ;
+                      end
+          END_READ  : begin
+                        endTransactionOut <= 1'b1;
+                        s_stateReg        <= IDLE;
+                      end
+          DO_WRITE  : begin
+                        // a word that is valid while busy is presented again in the next cycle
+                        if (dataValidIn == 1'b1 && busyOut == 1'b0)
+                          begin
+                            if (s_wordAddressReg < nrOfWords) memory[s_wordAddressReg] <= addressDataIn;
+                            s_wordAddressReg <= s_wordAddressReg + 30'd1;
+                          end
+                        if (endTransactionIn == 1'b1) s_stateReg <= IDLE;
+                      end
+          default   : s_stateReg <= IDLE;
+        endcase
+      end
+
+endmodule
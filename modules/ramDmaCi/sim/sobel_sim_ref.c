@@ -0,0 +1,330 @@
+/*
+ * sobel_sim_ref.c
+ *
+ * Host side of tb_ramDmaCi.v.
+ *   gen [-s frames] [pgm ...]   writes frame<n>.hex, the 640x480 grayscale frames
+ *                               as the camera stores them (4 pixels per bus word,
+ *                               first pixel in bits [7:0]); without PGM files a
+ *                               bright square moving over a textured background
+ *   check [-t threshold] [-n frames] [-m] [-x tile width] [-y tile height] [-s]
+ *                               compares result<n>.hex, the output image of every
+ *                               frame, pixel by pixel with edgeDetection and
+ *                               movementDetection of programms/sobel, or with -m
+ *                               (gradient magnitude output) with min(|Gx|+|Gy|,255),
+ *                               histogram<n>.hex, the 256 bins of the magnitude
+ *                               histogram read after every frame, and
+ *                               summary<n>.hex, the {edges, moved} tile summaries
+ *                               in the order of the walk, row by row or with -s
+ *                               stripe by stripe, and boxes<n>.hex, the motion
+ *                               boxes of the frame and of the zones below
+ * The accelerator marks an edge when |Gx|+|Gy| >= threshold, edgeDetection when
+ * it is > threshold, so the reference runs with threshold - 1. The dma writes
+ * word aligned, so the output of the pixel at &sobelImage[641] lands at
+ * &sobelImage[640]: the hardware image is the software one shifted left by
+ * one pixel. The tiles only produce a valid result for the lines 1..478 and
+ * the columns 1..638.
+ * The filter computes the pixels 1..640 of the lines 1..480. It reads its
+ * input blocks from the linear image, so the window of the pixels 639 and 640
+ * continues on the next line, and the lines below the frame are the zero
+ * words the testbench leaves behind it. hardwareGradient models this for the
+ * histogram and the tile summaries, which count all of these pixels. A pixel
+ * is an edge when |Gx|+|Gy| >= threshold and has moved when it is an edge and
+ * was none in the frame before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sobel.h>
+#include <movement.h>
+
+#define WIDTH 640
+#define HEIGHT 480
+#define NR_OF_PIXELS (WIDTH*HEIGHT)
+#define NR_OF_BINS 256
+#define NR_OF_BOXES 5
+
+/* the zones tb_ramDmaCi.v sets, {min x, max x, min y, max y} with the bounds included; zone 1 is disabled */
+static const int32_t zones[NR_OF_BOXES - 1][4] = {{96, 160, 64, 120}, {1, 0, 1, 0}, {200, 640, 1, 480}, {0, 2047, 100, 100}};
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s gen [-s frames] [pgm ...]\n"
+                  "       %s check [-t threshold] [-n frames] [-m] [-x tile width] [-y tile height] [-s]\n", name, name);
+  exit(1);
+}
+
+static void readPgm(const char *path, uint8_t *image) {
+  FILE *file = fopen(path, "rb");
+  int width, height, maxValue;
+  if (file == NULL || fscanf(file, "P5 %d %d %d", &width, &height, &maxValue) != 3 ||
+      width != WIDTH || height != HEIGHT || maxValue != 255 || fgetc(file) == EOF ||
+      fread(image, 1, NR_OF_PIXELS, file) != NR_OF_PIXELS) {
+    fprintf(stderr, "%s: not a %dx%d 8-bit binary PGM\n", path, WIDTH, HEIGHT);
+    exit(1);
+  }
+  fclose(file);
+}
+
+static void makeFrame(int32_t frameNr, uint8_t *image) {
+  for (int32_t line = 0; line < HEIGHT; line++) {
+    for (int32_t pixel = 0; pixel < WIDTH; pixel++) {
+      uint8_t value = ((line >> 3) ^ (pixel >> 3)) & 1 ? 80 : 64;
+      value += (line * 7 + pixel * 3) & 15;
+      int32_t x = pixel - 100 - frameNr * 13;
+      int32_t y = line - 80 - frameNr * 9;
+      if (x >= 0 && x < 120 && y >= 0 && y < 90) value = 220;
+      image[line * WIDTH + pixel] = value;
+    }
+  }
+}
+
+static void writeHex(const char *path, uint8_t *image) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  for (int32_t word = 0; word < NR_OF_PIXELS / 4; word++) {
+    uint8_t *pixels = image + word * 4;
+    fprintf(file, "%02x%02x%02x%02x\n", pixels[3], pixels[2], pixels[1], pixels[0]);
+  }
+  fclose(file);
+}
+
+/* $writememh output; address (@) and comment lines are skipped, x and z count as errors */
+static int32_t readWords(const char *path, uint32_t *words, int32_t nrOfWords) {
+  FILE *file = fopen(path, "r");
+  char line[128];
+  int32_t word = 0, nrOfUnknown = 0;
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  while (word < nrOfWords && fgets(line, sizeof(line), file) != NULL) {
+    char *text = line + strspn(line, " \t");
+    if (*text == '@' || *text == '/' || *text == '\n' || *text == '\0') continue;
+    char *end;
+    words[word] = strtoul(text, &end, 16);
+    if (end - text != 8) {
+      nrOfUnknown++;
+      words[word] = 0xFFFFFFFF;
+    }
+    word++;
+  }
+  fclose(file);
+  if (word != nrOfWords) {
+    fprintf(stderr, "%s: %d of %d words\n", path, word, nrOfWords);
+    exit(1);
+  }
+  return nrOfUnknown;
+}
+
+static int32_t readHex(const char *path, uint8_t *image) {
+  static uint32_t words[NR_OF_PIXELS / 4];
+  int32_t nrOfUnknown = readWords(path, words, NR_OF_PIXELS / 4);
+  for (int32_t word = 0; word < NR_OF_PIXELS / 4; word++) {
+    for (int32_t byte = 0; byte < 4; byte++) image[word * 4 + byte] = words[word] >> (byte * 8);
+  }
+  return nrOfUnknown;
+}
+
+/* |Gx|+|Gy| of the pixel (pixel, line) as the filter computes it, gray is followed by 2 lines and 2 pixels of 0 */
+static int32_t hardwareGradient(const uint8_t *gray, int32_t pixel, int32_t line) {
+  const uint8_t *center = gray + line * WIDTH + pixel;
+  const uint8_t *top = center - WIDTH, *bottom = center + WIDTH;
+  int32_t gx = top[-1] - top[1] + 2 * (center[-1] - center[1]) + bottom[-1] - bottom[1];
+  int32_t gy = bottom[-1] + 2 * bottom[0] + bottom[1] - top[-1] - 2 * top[0] - top[1];
+  return abs(gx) + abs(gy);
+}
+
+static int32_t saturate(int32_t gradient) {
+  return (gradient > 255) ? 255 : gradient;
+}
+
+/* compares the {edges, moved} summaries of the tiles with the ones of the pixel flags (index line*WIDTH+pixel-1) */
+static void checkSummaries(int32_t frameNr, const bool *edge, const bool *moved, int32_t tileWidth,
+                           int32_t tileHeight, bool stripeWalk, bool *ok) {
+  int32_t tilesPerRow = WIDTH / tileWidth, tilesPerColumn = HEIGHT / tileHeight;
+  int32_t nrOfTiles = tilesPerRow * tilesPerColumn, nrOfMismatches = 0, nrOfMovingTiles = 0;
+  uint32_t *summary = malloc(nrOfTiles * sizeof(uint32_t));
+  char path[32];
+  if (summary == NULL) exit(1);
+  snprintf(path, sizeof(path), "summary%d.hex", frameNr);
+  int32_t nrOfUnknown = readWords(path, summary, nrOfTiles);
+  for (int32_t entry = 0; entry < nrOfTiles; entry++) {
+    int32_t column = stripeWalk ? entry / tilesPerColumn : entry % tilesPerRow;
+    int32_t row = stripeWalk ? entry % tilesPerColumn : entry / tilesPerRow;
+    uint32_t edges = 0, nrOfMoved = 0;
+    for (int32_t line = row * tileHeight + 1; line <= (row + 1) * tileHeight; line++) {
+      for (int32_t pixel = column * tileWidth + 1; pixel <= (column + 1) * tileWidth; pixel++) {
+        edges += edge[line * WIDTH + pixel - 1];
+        nrOfMoved += moved[line * WIDTH + pixel - 1];
+      }
+    }
+    nrOfMovingTiles += nrOfMoved != 0;
+    if (summary[entry] == (edges << 16 | nrOfMoved)) continue;
+    if (nrOfMismatches++ < 10) {
+      printf("frame %d summary %d (tile %d, %d): hardware %u edges %u moved, software %u edges %u moved\n",
+             frameNr, entry, column, row, summary[entry] >> 16, summary[entry] & 0xFFFF, edges, nrOfMoved);
+    }
+  }
+  printf("frame %d: %d tile summaries, %d with moved pixels, %d mismatches, %d unknown words\n",
+         frameNr, nrOfTiles, nrOfMovingTiles, nrOfMismatches, nrOfUnknown);
+  *ok &= nrOfMismatches == 0 && nrOfUnknown == 0;
+  free(summary);
+}
+
+/* compares the motion boxes, {max x, min x} and {max y, min y} of the moved pixels of the frame (box 0) and of
+   every zone, with a scan of the moved flags; an empty box is min 2047, max 0 */
+static void checkBoxes(int32_t frameNr, const bool *moved, bool *ok) {
+  uint32_t words[NR_OF_BOXES * 2];
+  int32_t nrOfMismatches = 0;
+  char path[32];
+  snprintf(path, sizeof(path), "boxes%d.hex", frameNr);
+  int32_t nrOfUnknown = readWords(path, words, NR_OF_BOXES * 2);
+  for (int32_t box = 0; box < NR_OF_BOXES; box++) {
+    const int32_t *zone = (box == 0) ? NULL : zones[box - 1];
+    int32_t minX = 2047, maxX = 0, minY = 2047, maxY = 0;
+    for (int32_t line = 1; line <= HEIGHT; line++) {
+      for (int32_t pixel = 1; pixel <= WIDTH; pixel++) {
+        if (!moved[line * WIDTH + pixel - 1]) continue;
+        if (zone != NULL && (pixel < zone[0] || pixel > zone[1] || line < zone[2] || line > zone[3])) continue;
+        if (pixel < minX) minX = pixel;
+        if (pixel > maxX) maxX = pixel;
+        if (line < minY) minY = line;
+        if (line > maxY) maxY = line;
+      }
+    }
+    uint32_t x = (uint32_t) maxX << 16 | minX, y = (uint32_t) maxY << 16 | minY;
+    if (words[box * 2] == x && words[box * 2 + 1] == y) {
+      if (minX <= maxX) printf("frame %d box %d: x %d..%d, y %d..%d\n", frameNr, box, minX, maxX, minY, maxY);
+      continue;
+    }
+    nrOfMismatches++;
+    printf("frame %d box %d: hardware x %u..%u, y %u..%u, software x %d..%d, y %d..%d\n", frameNr, box,
+           words[box * 2] & 0x7FF, words[box * 2] >> 16, words[box * 2 + 1] & 0x7FF, words[box * 2 + 1] >> 16,
+           minX, maxX, minY, maxY);
+  }
+  printf("frame %d: %d motion boxes, %d mismatches, %d unknown words\n", frameNr, NR_OF_BOXES, nrOfMismatches, nrOfUnknown);
+  *ok &= nrOfMismatches == 0 && nrOfUnknown == 0;
+}
+
+static int generate(int argc, char **argv) {
+  int32_t nrOfFrames = 2;
+  char path[32];
+  int opt;
+  while ((opt = getopt(argc, argv, "s:")) != -1) {
+    switch (opt) {
+      case 's': nrOfFrames = atoi(optarg); break;
+      default : usage("sobel_sim_ref");
+    }
+  }
+  uint8_t *image = malloc(NR_OF_PIXELS);
+  if (image == NULL) return 1;
+  if (optind < argc) nrOfFrames = argc - optind;
+  for (int32_t frameNr = 0; frameNr < nrOfFrames; frameNr++) {
+    if (optind < argc) readPgm(argv[optind + frameNr], image);
+    else makeFrame(frameNr, image);
+    snprintf(path, sizeof(path), "frame%d.hex", frameNr);
+    writeHex(path, image);
+  }
+  printf("%d frames written\n", nrOfFrames);
+  free(image);
+  return 0;
+}
+
+static int check(int argc, char **argv) {
+  int32_t threshold = 127, nrOfFrames = 2, tileWidth = 64, tileHeight = 12;
+  bool ok = true, magnitude = false, stripeWalk = false;
+  char path[32];
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:mx:y:s")) != -1) {
+    switch (opt) {
+      case 't': threshold = atoi(optarg); break;
+      case 'n': nrOfFrames = atoi(optarg); break;
+      case 'm': magnitude = true; break;
+      case 'x': tileWidth = atoi(optarg); break;
+      case 'y': tileHeight = atoi(optarg); break;
+      case 's': stripeWalk = true; break;
+      default : usage("sobel_sim_ref");
+    }
+  }
+  if (tileWidth <= 0 || WIDTH % tileWidth != 0 || tileHeight <= 0 || HEIGHT % tileHeight != 0) usage("sobel_sim_ref");
+  uint8_t *gray = calloc(NR_OF_PIXELS + 2 * WIDTH + 2, 1);
+  uint8_t *sobel = calloc(NR_OF_PIXELS, 1);
+  uint8_t *movement = malloc(NR_OF_PIXELS);
+  uint8_t *hardware = malloc(NR_OF_PIXELS);
+  bool *edge = calloc((HEIGHT + 1) * WIDTH, sizeof(bool));
+  bool *previousEdge = calloc((HEIGHT + 1) * WIDTH, sizeof(bool));
+  bool *moved = calloc((HEIGHT + 1) * WIDTH, sizeof(bool));
+  if (gray == NULL || sobel == NULL || movement == NULL || hardware == NULL ||
+      edge == NULL || previousEdge == NULL || moved == NULL) return 1;
+  memset(movement, 127, NR_OF_PIXELS);
+  for (int32_t frameNr = 0; frameNr < nrOfFrames; frameNr++) {
+    snprintf(path, sizeof(path), "frame%d.hex", frameNr);
+    readHex(path, gray);
+    edgeDetection(gray, sobel, WIDTH, HEIGHT, threshold - 1);
+    movementDetection(frameNr == 0, sobel, movement, WIDTH, HEIGHT);
+    snprintf(path, sizeof(path), "result%d.hex", frameNr);
+    int32_t nrOfUnknown = readHex(path, hardware);
+    int32_t nrOfMismatches = 0, nrOfEdges = 0;
+    for (int32_t line = 1; line < HEIGHT - 1; line++) {
+      for (int32_t pixel = 1; pixel < WIDTH - 1; pixel++) {
+        int32_t index = line * WIDTH + pixel;
+        nrOfEdges += sobel[index] == 255;
+        if (magnitude || hardware[index - 1] == movement[index]) continue;
+        if (nrOfMismatches++ < 10) {
+          printf("frame %d line %d pixel %d: hardware %d, software %d\n",
+                 frameNr, line, pixel, hardware[index - 1], movement[index]);
+        }
+      }
+    }
+    uint32_t histogram[NR_OF_BINS] = {0};
+    for (int32_t line = 1; line <= HEIGHT; line++) {
+      for (int32_t pixel = 1; pixel <= WIDTH; pixel++) {
+        int32_t gradient = hardwareGradient(gray, pixel, line), value = saturate(gradient);
+        int32_t index = line * WIDTH + pixel - 1;
+        histogram[value]++;
+        edge[index] = gradient >= threshold;
+        moved[index] = edge[index] && !previousEdge[index];
+        if (!magnitude || line == HEIGHT || hardware[index] == value) continue;
+        if (nrOfMismatches++ < 10) {
+          printf("frame %d line %d pixel %d: hardware magnitude %d, software %d\n",
+                 frameNr, line, pixel, hardware[index], value);
+        }
+      }
+    }
+    printf("frame %d: %d edges, %d mismatches, %d unknown words\n", frameNr, nrOfEdges, nrOfMismatches, nrOfUnknown);
+    ok &= nrOfMismatches == 0 && nrOfUnknown == 0;
+    uint32_t bins[NR_OF_BINS];
+    snprintf(path, sizeof(path), "histogram%d.hex", frameNr);
+    nrOfUnknown = readWords(path, bins, NR_OF_BINS);
+    nrOfMismatches = 0;
+    for (int32_t bin = 0; bin < NR_OF_BINS; bin++) {
+      if (bins[bin] == histogram[bin]) continue;
+      if (nrOfMismatches++ < 10) {
+        printf("frame %d histogram bin %d: hardware %u, software %u\n", frameNr, bin, bins[bin], histogram[bin]);
+      }
+    }
+    printf("frame %d: histogram of %d pixels, %d bin mismatches, %d unknown words\n",
+           frameNr, WIDTH * HEIGHT, nrOfMismatches, nrOfUnknown);
+    ok &= nrOfMismatches == 0 && nrOfUnknown == 0;
+    checkSummaries(frameNr, edge, moved, tileWidth, tileHeight, stripeWalk, &ok);
+    checkBoxes(frameNr, moved, &ok);
+    bool *swap = previousEdge;
+    previousEdge = edge;
+    edge = swap;
+  }
+  printf("%s\n", ok ? "identical" : "MISMATCH");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) usage(argv[0]);
+  if (strcmp(argv[1], "gen") == 0) return generate(argc - 1, argv + 1);
+  if (strcmp(argv[1], "check") == 0) return check(argc - 1, argv + 1);
+  usage(argv[0]);
+  return 1;
+}
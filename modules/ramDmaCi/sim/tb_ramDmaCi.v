@@ -0,0 +1,853 @@
+/*
+ * Testbench of the Sobel + movement detection accelerator
+ * (ramDmaCi_sobel_movement_detection.v). The custom instructions are issued
+ * in the same order as programms/sobel_mov_detection/src/sobel_mov_detection.c
+ * does for every frame, against the real bus arbiter and a behavioral sdram
+ * (sdramBusModel.v). The frames are read from frame<n>.hex and the 8-bit
+ * output image of every frame is written to result<n>.hex, both one 32-bit
+ * bus word (4 pixels, first pixel in bits [7:0]) per line; sobel_sim_ref.c
+ * creates the frames and checks the results against edgeDetection and
+ * movementDetection. Per frame the cycles, the cycles per tile and the cycles
+ * the bus is busy are reported. With descriptorChain set the transfers of a
+ * frame are executed as a descriptor chain started by a single custom
+ * instruction (CHAIN_WALK of sobel_mov_detection.c), with frameMode set the
+ * accelerator walks the tiles itself (FRAME_WALK). The tile geometry is
+ * set with tileWidth and tileHeight (tile geometry register). With
+ * overlapWriteBack (and packedState) the tiles are triple buffered
+ * (overlapWriteBack). With stripeWalk (and frameMode) the tiles are walked
+ * down vertical stripes that keep their halo lines in the filter (stripeWalk).
+ * Before the frames the completion interrupt is checked: pending, enable and
+ * acknowledge, and the one cycle drop of irq on an acknowledge that leaves a
+ * bit pending, which the or1420 needs to see a new edge. In descriptor chain
+ * and frame mode the end of a frame is then waited for on irq (irqCompletion).
+ * With magnitudeOutput (and packedState) the output image is the gradient
+ * magnitude (magnitudeOutput). The magnitude histogram is cleared before the
+ * first frame and read, which empties it again, after every frame into
+ * histogram<n>.hex (adaptiveThreshold, without changing the threshold).
+ * The tile summaries of every frame are read with custom instructions into
+ * summary<n>.hex (tileSummary); in frame mode the dma writes them to
+ * summaryBase after the last tile, and that copy has to match. A read of a
+ * summary in the cycle the filter writes the next one, and the overflow flag
+ * of a 513th summary, are checked before the frames. The 4 zones of the motion boxes are set as in sobel_sim_ref.c, the
+ * 5 boxes are read into boxes<n>.hex and cleared after every frame (motionBox).
+ * Failed checks are reported with ERROR.
+ */
+module tb_ramDmaCi;
+
+  parameter nrOfFrames = 2;
+  parameter packedState = 1;          // packedState of sobel_mov_detection.c
+  parameter sobelThreshold = 127;
+  parameter cpuCyclesBetweenCi = 3;   // instructions the cpu executes between two custom instructions
+  parameter readLatency = 8;          // cycles from the start of a read burst to the first word
+  parameter writeBusyPeriod = 0;
+  parameter descriptorChain = 0;      // CHAIN_WALK of sobel_mov_detection.c
+  parameter frameMode = 0;            // FRAME_WALK of sobel_mov_detection.c, has precedence over descriptorChain
+  parameter tileWidth = 64;           // TILE_WIDTH and TILE_HEIGHT of sobel_mov_detection.c
+  parameter tileHeight = 12;
+  parameter overlapWriteBack = 1;     // overlapWriteBack of sobel_mov_detection.c, with packedState only
+  parameter stripeWalk = 1;           // stripeWalk of sobel_mov_detection.c, with frameMode only
+  parameter magnitudeOutput = 0;      // magnitudeOutput of sobel_mov_detection.c, with packedState only
+
+  /*
+   *
+   * Here we define the memory map of the sdram model and the constants of sobel_mov_detection.c
+   *
+   */
+  localparam [31:0] grayBase  = 32'h00100000;
+  localparam [31:0] sobelBase = 32'h00200000;
+  localparam [31:0] stateBase = 32'h00300000;
+  localparam [31:0] chainBase = 32'h00380000;
+  localparam [31:0] summaryBase = 32'h003C0000;
+  localparam        nrOfFrameWords = 640*480/4;
+  localparam        tilesPerRow = 640/tileWidth;
+  localparam        nrOfTiles = tilesPerRow*480/tileHeight;
+
+  localparam [31:0] writeBusStartAddress = 32'h00000600;
+  localparam [31:0] writeMemoryStartAddress = 32'h00000A00;
+  localparam [31:0] writeControlRegister = 32'h00001600;
+  localparam [31:0] readStatusRegister = 32'h00001400;
+  localparam [31:0] writeBlockSize = 32'h00000E00;
+  localparam [31:0] writeBurstSize = 32'h00001200;
+  localparam [31:0] writeSobelTreshold = 32'h00001A00;
+  localparam [31:0] writeSobelConfig = 32'h00001E00;
+  localparam [31:0] block_size = (tileWidth/4+1)*(tileHeight+2);
+  localparam [31:0] burst_size = tileWidth/4;
+  localparam [31:0] block_size_output = tileWidth/4*tileHeight;
+  localparam [31:0] burst_size_output = tileWidth/4-1;
+  localparam [31:0] skip_line = 640*(tileHeight-1)+tileWidth;
+  localparam [31:0] buff1 = 0;
+  localparam [31:0] buff2 = 238;
+  localparam [31:0] block_size_state = tileWidth*tileHeight/16;
+  localparam [31:0] burst_size_state = tileWidth*tileHeight/16-1;
+  localparam [31:0] state_memory = 476;
+  localparam        tripleBuffer = (overlapWriteBack != 0 && packedState != 0) ? 1 : 0;
+  localparam        stripe = (stripeWalk != 0 && frameMode != 0) ? 1 : 0;
+  localparam        magnitude = (magnitudeOutput != 0 && packedState != 0) ? 1 : 0;
+  localparam [31:0] writeFrameGrayAddress = 32'h00002200;
+  localparam [31:0] writeFramePreviousAddress = 32'h00002600;
+  localparam [31:0] writeFrameOutputAddress = 32'h00002A00;
+  localparam [31:0] writeFrameWidth = 32'h00002E00;
+  localparam [31:0] writeFrameHeight = 32'h00003200;
+  localparam [31:0] writeStride = 32'h00003600;
+  localparam [31:0] writeFrameControl = 32'h00003A00;
+  localparam [31:0] writeTileGeometry = 32'h00003E00;
+  localparam [31:0] readFrameStatus = 32'h00003800;
+  localparam [31:0] readIrqPending = 32'h00004000;
+  localparam [31:0] writeIrqEnable = 32'h00004200;
+  localparam [31:0] readIrqEnable = 32'h00004400;
+  localparam [31:0] writeIrqAcknowledge = 32'h00004600;
+  localparam [31:0] irqDma = 32'd1;
+  localparam [31:0] irqSobel = 32'd2;
+  localparam [31:0] readHistogram = 32'h00004800;
+  localparam [31:0] writeHistogramClear = 32'h00004A00;
+  localparam [31:0] readHistogramStatus = 32'h00004C00;
+  localparam [31:0] writeSummaryAddress = 32'h00004E00;
+  localparam [31:0] readSummary = 32'h00005000;
+  localparam [31:0] readSummaryCount = 32'h00005400;
+  localparam [31:0] writeZone = 32'h00005200;
+  localparam [31:0] writeBoxClear = 32'h00005600;
+  localparam [31:0] readBox = 32'h00005800;
+  localparam [7:0]  ciDma = 8'd20;
+  localparam [7:0]  ciSobel = 8'd21;
+  localparam [31:0] descriptorMemoryToBus = 32'h08000000;
+  localparam [31:0] descriptorWaitSobel = 32'h10000000;
+  localparam [31:0] descriptorStartSobel = 32'h20000000;
+  localparam [31:0] descriptorLast = 32'h80000000;
+
+  /*
+   *
+   * Here we define the clock, the cpu side of the custom instruction interface and the bus
+   *
+   */
+  reg        clock = 1'b0;
+  reg        reset = 1'b1;
+  reg        start = 1'b0;
+  reg [7:0]  ciN = 8'd0;
+  reg [31:0] valueA = 32'd0;
+  reg [31:0] valueB = 32'd0;
+  wire       done;
+  wire [31:0] result;
+  wire       irq;
+
+  always #5 clock = ~clock;
+
+  wire        s_dmaRequest, s_dmaBeginTransaction, s_dmaReadNotWrite, s_dmaEndTransaction, s_dmaDataValid;
+  wire [3:0]  s_dmaByteEnables;
+  wire [7:0]  s_dmaBurstSize;
+  wire [31:0] s_dmaAddressData;
+  wire [31:0] s_busGrants;
+  wire        s_arbBusError, s_arbEndTransaction, s_busIdle, s_snoopableBurst;
+  wire        s_sdramEndTransaction, s_sdramDataValid, s_sdramBusy, s_sdramBusError;
+  wire [31:0] s_sdramAddressData;
+
+  wire        s_beginTransaction = s_dmaBeginTransaction;
+  wire        s_endTransaction   = s_dmaEndTransaction | s_arbEndTransaction | s_sdramEndTransaction;
+  wire        s_dataValid        = s_dmaDataValid | s_sdramDataValid;
+  wire [31:0] s_addressData      = s_dmaAddressData | s_sdramAddressData;
+  wire        s_busError         = s_arbBusError | s_sdramBusError;
+
+  ramDmaCi #(.customIdDMA(ciDma),
+             .customIdSobel(ciSobel)) dut
+            (.start(start),
+             .clock(clock),
+             .reset(reset),
+             .valueA(valueA),
+             .valueB(valueB),
+             .ciN(ciN),
+             .done(done),
+             .result(result),
+             .irq(irq),
+             .requestTransaction(s_dmaRequest),
+             .transactionGranted(s_busGrants[0]),
+             .endTransactionIn(s_endTransaction),
+             .dataValidIn(s_dataValid),
+             .busErrorIn(s_busError),
+             .busyIn(s_sdramBusy),
+             .addressDataIn(s_addressData),
+             .beginTransactionOut(s_dmaBeginTransaction),
+             .readNotWriteOut(s_dmaReadNotWrite),
+             .endTransactionOut(s_dmaEndTransaction),
+             .dataValidOut(s_dmaDataValid),
+             .byteEnablesOut(s_dmaByteEnables),
+             .burstSizeOut(s_dmaBurstSize),
+             .addressDataOut(s_dmaAddressData));
+
+  busArbiter arbiter ( .clock(clock),
+                       .reset(reset),
+                       .busRequests({31'd0,s_dmaRequest}),
+                       .busGrants(s_busGrants),
+                       .busErrorOut(s_arbBusError),
+                       .endTransactionOut(s_arbEndTransaction),
+                       .busIdle(s_busIdle),
+                       .snoopableBurst(s_snoopableBurst),
+                       .beginTransactionIn(s_beginTransaction),
+                       .endTransactionIn(s_endTransaction),
+                       .dataValidIn(s_dataValid),
+                       .addressDataIn(s_addressData[31:30]),
+                       .burstSizeIn(s_dmaBurstSize));
+
+  sdramBusModel #(.readLatency(readLatency),
+                  .writeBusyPeriod(writeBusyPeriod)) sdram
+                 ( .clock(clock),
+                   .reset(reset),
+                   .beginTransactionIn(s_beginTransaction),
+                   .endTransactionIn(s_endTransaction),
+                   .readNotWriteIn(s_dmaReadNotWrite),
+                   .dataValidIn(s_dataValid),
+                   .addressDataIn(s_addressData),
+                   .burstSizeIn(s_dmaBurstSize),
+                   .endTransactionOut(s_sdramEndTransaction),
+                   .dataValidOut(s_sdramDataValid),
+                   .busyOut(s_sdramBusy),
+                   .busErrorOut(s_sdramBusError),
+                   .addressDataOut(s_sdramAddressData));
+
+  /*
+   *
+   * Here we define the counters: all cycles, and the cycles between the begin and the end of a bus transaction
+   *
+   */
+  reg [31:0] s_cycleReg = 32'd0;
+  reg [31:0] s_busBusyCycleReg = 32'd0;
+  reg        s_busActiveReg = 1'b0;
+
+  always @(posedge clock)
+    begin
+      s_cycleReg        <= s_cycleReg + 32'd1;
+      s_busActiveReg    <= (reset == 1'b1 || s_endTransaction == 1'b1) ? 1'b0 :
+                           (s_beginTransaction == 1'b1) ? 1'b1 : s_busActiveReg;
+      s_busBusyCycleReg <= (s_busActiveReg == 1'b1 || s_beginTransaction == 1'b1) ? s_busBusyCycleReg + 32'd1 : s_busBusyCycleReg;
+    end
+
+  /*
+   *
+   * Here we define the interrupt monitor: the rising edges of irq, on which the or1420 takes the interrupt,
+   * and the cycles irq was low before the last one
+   *
+   */
+  reg        s_irqReg = 1'b0;
+  reg [31:0] s_irqRisesReg = 32'd0;
+  reg [31:0] s_irqLowCyclesReg = 32'd0;
+  reg [31:0] s_irqLastLowCyclesReg = 32'd0;
+
+  always @(posedge clock)
+    begin
+      s_irqReg              <= irq;
+      s_irqRisesReg         <= (irq == 1'b1 && s_irqReg == 1'b0) ? s_irqRisesReg + 32'd1 : s_irqRisesReg;
+      s_irqLowCyclesReg     <= (irq == 1'b0) ? s_irqLowCyclesReg + 32'd1 : 32'd0;
+      s_irqLastLowCyclesReg <= (irq == 1'b1 && s_irqReg == 1'b0) ? s_irqLowCyclesReg : s_irqLastLowCyclesReg;
+    end
+
+  integer s_errors = 0;
+
+  task check;
+    input [8*40-1:0] what;
+    input [31:0]     value;
+    input [31:0]     expected;
+    if (value !== expected)
+      begin
+        $display("ERROR: %0s is %0d, expected %0d", what, value, expected);
+        s_errors = s_errors + 1;
+      end
+  endtask
+
+  /*
+   *
+   * Here we define the cpu: a custom instruction raises start for one cycle and waits for done.
+   * The inputs change on the falling edge, so they are stable on the rising edge the ci samples them.
+   *
+   */
+  task ci;
+    input  [7:0]  n;
+    input  [31:0] a;
+    input  [31:0] b;
+    output [31:0] r;
+    reg           doneInStartCycle;
+    integer       gap;
+    begin
+      @(negedge clock);
+      ciN    = n;
+      valueA = a;
+      valueB = b;
+      start  = 1'b1;
+      #1 doneInStartCycle = done;
+      @(negedge clock);
+      start = 1'b0;
+      if (doneInStartCycle == 1'b0)
+        while (done !== 1'b1) @(negedge clock);
+      #1 r = result;
+      for (gap = 0 ; gap < cpuCyclesBetweenCi ; gap = gap + 1) @(negedge clock);
+    end
+  endtask
+
+  reg [31:0] s_unused;
+
+  task ciWrite;
+    input [7:0]  n;
+    input [31:0] a;
+    input [31:0] b;
+    ci(n, a, b, s_unused);
+  endtask
+
+  task waitDma;
+    reg [31:0] status;
+    begin
+      status = 32'd1;
+      while (status != 32'd0) ci(ciDma, readStatusRegister, 32'd0, status);
+    end
+  endtask
+
+  task waitFrame;
+    reg [31:0] status;
+    begin
+      status = 32'd0;
+      while (status[1] == 1'b0) ci(ciDma, readFrameStatus, 32'd0, status);
+    end
+  endtask
+
+  task waitSobel;
+    reg [31:0] status;
+    begin
+      status = 32'd1;
+      while (status != 32'd0) ci(ciDma, 32'd0, 32'd0, status);
+    end
+  endtask
+
+  // ramdma_wait(RAMDMA_IRQ_DMA) with the acknowledge of ramdma_interrupt, the end of the frame raises a single edge
+  task waitIrq;
+    input [31:0] rises;
+    reg [31:0]   pending, enable;
+    begin
+      while (irq !== 1'b1) @(negedge clock);
+      ci(ciDma, readIrqPending, 32'd0, pending);
+      ci(ciDma, readIrqEnable, 32'd0, enable);
+      check("enabled pending irq", pending & enable, irqDma);
+      ciWrite(ciDma, writeIrqAcknowledge, pending & enable);
+      check("irq after acknowledge", irq, 0);
+      check("irq edges of the frame", s_irqRisesReg - rises, 1);
+    end
+  endtask
+
+  // ramdma_histogram_clear
+  task clearHistogram;
+    reg [31:0] status;
+    begin
+      ciWrite(ciDma, writeHistogramClear, 32'd0);
+      status = 32'd1;
+      while (status[0] == 1'b1) ci(ciDma, readHistogramStatus, 32'd0, status);
+    end
+  endtask
+
+  // ramdma_histogram_read, reading a bin clears it
+  reg [31:0] histogram [0:255];
+
+  task readHistogramBins;
+    integer bin;
+    for (bin = 0 ; bin < 256 ; bin = bin + 1) ci(ciDma, readHistogram | bin, 32'd0, histogram[bin]);
+  endtask
+
+  // ramdma_summary_read, in frame mode the dma copy has to be the same
+  reg [31:0] summary [0:511];
+
+  task readSummaries;
+    reg [31:0] count;
+    integer    entry;
+    begin
+      ci(ciDma, readSummaryCount, 32'd0, count);
+      check("tile summaries", count, nrOfTiles);
+      for (entry = 0 ; entry < nrOfTiles ; entry = entry + 1)
+        begin
+          ci(ciDma, readSummary | entry, 32'd0, summary[entry]);
+          if (frameMode != 0) check("dma copy of a tile summary", sdram.memory[(summaryBase >> 2) + entry], summary[entry]);
+        end
+    end
+  endtask
+
+  // ramdma_zone_set with the zones of sobel_sim_ref.c: a part of the moving square, a disabled zone,
+  // the right part of the frame and a single line
+  task setZones;
+    begin
+      ciWrite(ciDma, writeZone | 0, (160 << 16) | 96);
+      ciWrite(ciDma, writeZone | 1, (120 << 16) | 64);
+      ciWrite(ciDma, writeZone | 2, (0 << 16) | 1);
+      ciWrite(ciDma, writeZone | 3, (0 << 16) | 1);
+      ciWrite(ciDma, writeZone | 4, (640 << 16) | 200);
+      ciWrite(ciDma, writeZone | 5, (480 << 16) | 1);
+      ciWrite(ciDma, writeZone | 6, (2047 << 16) | 0);
+      ciWrite(ciDma, writeZone | 7, (100 << 16) | 100);
+    end
+  endtask
+
+  // ramdma_box_read of all boxes, {x, y} per box
+  reg [31:0] boxes [0:9];
+
+  task readBoxes;
+    integer word;
+    for (word = 0 ; word < 10 ; word = word + 1) ci(ciDma, readBox | word, 32'd0, boxes[word]);
+  endtask
+
+  /*
+   *
+   * Here we check a read of a tile summary that starts in the cycle the filter writes the next one
+   *
+   */
+  task summaryReadTest;
+    reg [31:0] first, written, value;
+    begin
+      // every pixel is an edge
+      ciWrite(ciDma, writeSobelTreshold, 0);
+      ciWrite(ciDma, writeSummaryAddress, 32'd0);
+      ciWrite(ciSobel, 32'd0, 32'd0);
+      waitSobel;
+      ci(ciDma, readSummary, 32'd0, first);
+      check("summary of a tile of edges", first, 768 << 16);
+      // the next summary is a tile without edges
+      ciWrite(ciDma, writeSobelTreshold, 255);
+      ciWrite(ciSobel, 32'd0, 32'd0);
+      while (dut.sobel_done !== 1'b1) @(negedge clock);
+      written = {dut.s_tileEdgesReg,dut.s_tileMovedReg};
+      ciN    = ciDma;
+      valueA = readSummary;
+      valueB = 32'd0;
+      start  = 1'b1;
+      @(negedge clock);
+      start = 1'b0;
+      while (done !== 1'b1) @(negedge clock);
+      #1 value = result;
+      check("summary read while one is written", value, first);
+      ci(ciDma, readSummary | 1, 32'd0, value);
+      check("summary written during a read", value, written);
+      check("summary of a tile without edges", written, 0);
+      ci(ciDma, readSummaryCount, 32'd0, value);
+      check("summaries after the read test", value, 2);
+    end
+  endtask
+
+  /*
+   *
+   * Here we check the overflow flag of the tile summaries, the 513th tile sets it and its summary is dropped
+   *
+   */
+  task summaryOverflowTest;
+    reg [31:0] last, value;
+    integer    tile;
+    begin
+      for (tile = 2 ; tile < 512 ; tile = tile + 1)
+        begin
+          ciWrite(ciSobel, 32'd0, 32'd0);
+          waitSobel;
+        end
+      ci(ciDma, readSummaryCount, 32'd0, value);
+      check("summaries of a full summary memory", value, 512);
+      ci(ciDma, readSummary | 511, 32'd0, last);
+      ciWrite(ciSobel, 32'd0, 32'd0);
+      waitSobel;
+      ci(ciDma, readSummaryCount, 32'd0, value);
+      check("summaries after an overflow", value, 32'h80000200);
+      ci(ciDma, readSummary | 511, 32'd0, value);
+      check("last summary after an overflow", value, last);
+      ciWrite(ciDma, writeSummaryAddress, 32'd0);
+      ci(ciDma, readSummaryCount, 32'd0, value);
+      check("summaries after a write of the summary address", value, 0);
+    end
+  endtask
+
+  /*
+   *
+   * Here we check the completion interrupt with a transfer and a filter run
+   *
+   */
+  task irqTest;
+    reg [31:0] value, rises;
+    begin
+      ci(ciDma, readIrqEnable, 32'd0, value);
+      check("irq enable after reset", value, 0);
+      ci(ciDma, readIrqPending, 32'd0, value);
+      check("irq pending after reset", value, 0);
+      // the end of a transfer sets the dma bit, irq stays low while it is disabled
+      ciWrite(ciDma, writeBusStartAddress, grayBase);
+      ciWrite(ciDma, writeMemoryStartAddress, 0);
+      ciWrite(ciDma, writeBlockSize, 4);
+      ciWrite(ciDma, writeBurstSize, 3);
+      ciWrite(ciDma, writeControlRegister, 1);
+      waitDma;
+      ci(ciDma, readIrqPending, 32'd0, value);
+      check("irq pending after a transfer", value, irqDma);
+      check("disabled irq", irq, 0);
+      // enabling a pending bit raises irq
+      rises = s_irqRisesReg;
+      ciWrite(ciDma, writeIrqEnable, irqDma | irqSobel);
+      ci(ciDma, readIrqEnable, 32'd0, value);
+      check("irq enable", value, irqDma | irqSobel);
+      check("irq after enable", irq, 1);
+      // the end of the filter sets the sobel bit, irq stays high
+      ciWrite(ciSobel, 32'd0, 32'd0);
+      waitSobel;
+      ci(ciDma, readIrqPending, 32'd0, value);
+      check("irq pending after the filter", value, irqDma | irqSobel);
+      check("irq edges before the acknowledge", s_irqRisesReg - rises, 1);
+      // acknowledging the dma bit drops irq for one cycle, the sobel bit raises it again
+      ciWrite(ciDma, writeIrqAcknowledge, irqDma);
+      ci(ciDma, readIrqPending, 32'd0, value);
+      check("irq pending after the dma acknowledge", value, irqSobel);
+      check("irq after the dma acknowledge", irq, 1);
+      check("irq edges after the dma acknowledge", s_irqRisesReg - rises, 2);
+      check("irq low cycles on acknowledge", s_irqLastLowCyclesReg, 1);
+      // acknowledging the last bit leaves irq low
+      ciWrite(ciDma, writeIrqAcknowledge, irqSobel);
+      ci(ciDma, readIrqPending, 32'd0, value);
+      check("irq pending after the sobel acknowledge", value, 0);
+      check("irq after the sobel acknowledge", irq, 0);
+      check("irq edges after the sobel acknowledge", s_irqRisesReg - rises, 2);
+      ciWrite(ciDma, writeIrqEnable, 0);
+    end
+  endtask
+
+  /*
+   *
+   * Here we replay sobel_mov_detection.c
+   *
+   */
+  integer    frameNr, tile, word;
+  reg [31:0] gray, sobel, state;
+  reg        buffer;
+  reg [31:0] lastrow;
+  reg [31:0] frameStart, tileStart, phaseStart, busStart;
+  reg [31:0] tileCycles, minTileCycles, maxTileCycles;
+  reg [31:0] stateReadCycles, sobelCycles, outputCycles, stateWriteCycles;
+  reg [8*32-1:0] fileName;
+  reg [31:0] readState, slot, previous;
+  reg [31:0] frameRises;
+
+  // input_slot and state_slot of sobel_mov_detection.c
+  function [31:0] inputSlot;
+    input [31:0] slot;
+    inputSlot = slot * 238;
+  endfunction
+
+  function [31:0] stateSlot;
+    input [31:0] slot;
+    stateSlot = 714 + slot * 48;
+  endfunction
+
+  /*
+   *
+   * Here we build the descriptor chain of sobel_mov_detection.c, directly in bus byte order
+   *
+   */
+  reg [31:0] descriptor;
+
+  task addDescriptor;
+    input [31:0] busAddress;
+    input [31:0] memoryAddress;
+    input [31:0] blockSize;
+    input [31:0] burstSize;
+    input [31:0] flags;
+    begin
+      sdram.memory[descriptor >> 2]       = busAddress;
+      sdram.memory[(descriptor >> 2) + 1] = blockSize | (burstSize << 10) | ((memoryAddress & 32'h1FF) << 18) | ((memoryAddress >> 9) << 30) | flags;
+      sdram.memory[(descriptor >> 2) + 2] = descriptor + 16;
+      sdram.memory[(descriptor >> 2) + 3] = 32'd0;
+      descriptor = descriptor + 16;
+    end
+  endtask
+
+  task buildDescriptorChain;
+    begin
+      descriptor = chainBase;
+      gray = grayBase;
+      sobel = sobelBase + 641;
+      state = stateBase;
+      buffer = 1'b0;
+      addDescriptor(gray, buff2, block_size, burst_size, 0);
+      for (tile = 1 ; tile <= nrOfTiles ; tile = tile + 1)
+        begin
+          lastrow = tile % tilesPerRow;
+          if (packedState != 0) addDescriptor(state, state_memory, block_size_state, burst_size_state, 0);
+          else addDescriptor(sobel, state_memory, block_size_output, burst_size_output, 0);
+          gray = (lastrow == 0) ? gray + skip_line : gray + tileWidth;
+          addDescriptor(gray, (buffer == 1'b1) ? buff2 : buff1, (tile < nrOfTiles) ? block_size : 0, burst_size, descriptorStartSobel);
+          addDescriptor(sobel, (buffer == 1'b1) ? buff1 : buff2, block_size_output, burst_size_output,
+                        descriptorMemoryToBus | descriptorWaitSobel);
+          sobel = (lastrow == 0) ? sobel + skip_line : sobel + tileWidth;
+          if (packedState != 0)
+            begin
+              addDescriptor(state, state_memory, block_size_state, burst_size_state, descriptorMemoryToBus);
+              state = state + block_size_state*4;
+            end
+          buffer = ~buffer;
+        end
+      sdram.memory[(descriptor >> 2) - 3] = sdram.memory[(descriptor >> 2) - 3] | descriptorLast;
+    end
+  endtask
+
+  task buildOverlappedChain;
+    begin
+      descriptor = chainBase;
+      gray = grayBase;
+      sobel = sobelBase + 641;
+      state = stateBase;
+      readState = stateBase;
+      for (tile = 0 ; tile <= nrOfTiles ; tile = tile + 1)
+        begin
+          slot = tile % 3;
+          previous = (tile + 2) % 3;
+          if (tile < nrOfTiles)
+            begin
+              addDescriptor(readState, stateSlot(slot), block_size_state, burst_size_state, 0);
+              addDescriptor(gray, inputSlot(slot), block_size, burst_size, 0);
+              readState = readState + block_size_state*4;
+              gray = ((tile + 1) % tilesPerRow == 0) ? gray + skip_line : gray + tileWidth;
+            end
+          addDescriptor(sobel, inputSlot(previous), (tile > 0) ? block_size_output : 0, burst_size_output,
+                        descriptorMemoryToBus | descriptorWaitSobel | ((tile < nrOfTiles) ? descriptorStartSobel : 0));
+          if (tile > 0)
+            begin
+              addDescriptor(state, stateSlot(previous), block_size_state, burst_size_state, descriptorMemoryToBus);
+              state = state + block_size_state*4;
+              sobel = (tile % tilesPerRow == 0) ? sobel + skip_line : sobel + tileWidth;
+            end
+        end
+      sdram.memory[(descriptor >> 2) - 3] = sdram.memory[(descriptor >> 2) - 3] | descriptorLast;
+    end
+  endtask
+
+  initial
+    begin
+      // no pixel is an edge in the frame before: the output image, with the line below it the filter computes too,
+      // and the packed state
+      for (word = 0 ; word < 1048576 ; word = word + 1)
+        sdram.memory[word] = (word >= (sobelBase >> 2) && word < (sobelBase >> 2) + nrOfFrameWords + 160) ? 32'h7F7F7F7F :
+                             (word >= (stateBase >> 2) && word < (stateBase >> 2) + nrOfTiles*block_size_state) ? 32'h55555555 : 32'd0;
+      repeat (4) @(negedge clock);
+      reset = 1'b0;
+      repeat (4) @(negedge clock);
+      irqTest;
+      summaryReadTest;
+      summaryOverflowTest;
+      ciWrite(ciDma, writeSobelTreshold, sobelThreshold);
+      ciWrite(ciDma, writeSobelConfig, (magnitude << 3) | (stripe << 2) | (tripleBuffer << 1) | packedState);
+      ciWrite(ciDma, writeStride, 640);
+      ciWrite(ciDma, writeTileGeometry, (tileHeight << 16) | tileWidth);
+      if (frameMode != 0)
+        begin
+          ciWrite(ciDma, writeFrameGrayAddress, grayBase);
+          ciWrite(ciDma, writeFramePreviousAddress, (packedState != 0) ? stateBase : sobelBase);
+          ciWrite(ciDma, writeFrameOutputAddress, sobelBase);
+          ciWrite(ciDma, writeFrameWidth, 640);
+          ciWrite(ciDma, writeFrameHeight, 480);
+          ciWrite(ciDma, writeSummaryAddress, summaryBase);
+        end
+      else if (descriptorChain != 0 && tripleBuffer != 0) buildOverlappedChain;
+      else if (descriptorChain != 0) buildDescriptorChain;
+      clearHistogram;
+      setZones;
+      // ramdma_irq_enable(RAMDMA_IRQ_DMA)
+      if (frameMode != 0 || descriptorChain != 0)
+        begin
+          ciWrite(ciDma, writeIrqAcknowledge, irqDma);
+          ciWrite(ciDma, writeIrqEnable, irqDma);
+        end
+      for (frameNr = 0 ; frameNr < nrOfFrames ; frameNr = frameNr + 1)
+        begin
+          // takeSingleImageBlocking
+          $sformat(fileName, "frame%0d.hex", frameNr);
+          $readmemh(fileName, sdram.memory, grayBase >> 2, (grayBase >> 2) + nrOfFrameWords - 1);
+          frameStart = s_cycleReg;
+          busStart = s_busBusyCycleReg;
+          minTileCycles = 32'hFFFFFFFF;
+          maxTileCycles = 32'd0;
+          stateReadCycles = 32'd0;
+          sobelCycles = 32'd0;
+          outputCycles = 32'd0;
+          stateWriteCycles = 32'd0;
+          frameRises = s_irqRisesReg;
+          if (frameMode != 0)
+            begin
+              ciWrite(ciDma, writeFrameControl, 1);
+              waitIrq(frameRises);
+              waitFrame;
+              $display("frame %0d: %0d cycles, %0d cycles/tile, bus busy %0d cycles (%0d%%), frame mode",
+                       frameNr, s_cycleReg - frameStart, (s_cycleReg - frameStart) / nrOfTiles,
+                       s_busBusyCycleReg - busStart, (s_busBusyCycleReg - busStart) * 100 / (s_cycleReg - frameStart));
+            end
+          else if (descriptorChain != 0)
+            begin
+              ciWrite(ciDma, writeBusStartAddress, chainBase);
+              ciWrite(ciDma, writeControlRegister, 4);
+              waitIrq(frameRises);
+              waitDma;
+              $display("frame %0d: %0d cycles, %0d cycles/tile, bus busy %0d cycles (%0d%%), descriptor chain",
+                       frameNr, s_cycleReg - frameStart, (s_cycleReg - frameStart) / nrOfTiles,
+                       s_busBusyCycleReg - busStart, (s_busBusyCycleReg - busStart) * 100 / (s_cycleReg - frameStart));
+            end
+          else if (tripleBuffer != 0)
+            begin
+              gray = grayBase;
+              sobel = sobelBase + 641;
+              state = stateBase;
+              readState = stateBase;
+              ciWrite(ciDma, writeSobelConfig, (magnitude << 3) | 3);
+              for (tile = 0 ; tile <= nrOfTiles ; tile = tile + 1)
+                begin
+                  tileStart = s_cycleReg;
+                  slot = tile % 3;
+                  previous = (tile + 2) % 3;
+                  // state and input of tile, while the filter runs on the one before
+                  if (tile < nrOfTiles)
+                    begin
+                      ciWrite(ciDma, writeBusStartAddress, readState);
+                      ciWrite(ciDma, writeBlockSize, block_size_state);
+                      ciWrite(ciDma, writeBurstSize, burst_size_state);
+                      ciWrite(ciDma, writeMemoryStartAddress, stateSlot(slot));
+                      ciWrite(ciDma, writeControlRegister, 1);
+                      readState = readState + block_size_state*4;
+                      waitDma;
+                      stateReadCycles = stateReadCycles + s_cycleReg - tileStart;
+                    end
+                  phaseStart = s_cycleReg;
+                  if (tile < nrOfTiles)
+                    begin
+                      ciWrite(ciDma, writeBusStartAddress, gray);
+                      ciWrite(ciDma, writeBlockSize, block_size);
+                      ciWrite(ciDma, writeBurstSize, burst_size);
+                      ciWrite(ciDma, writeMemoryStartAddress, inputSlot(slot));
+                      ciWrite(ciDma, writeControlRegister, 1);
+                      gray = ((tile + 1) % tilesPerRow == 0) ? gray + skip_line : gray + tileWidth;
+                      waitDma;
+                    end
+                  waitSobel;
+                  if (tile < nrOfTiles) ciWrite(ciSobel, 32'd0, 32'd0);
+                  sobelCycles = sobelCycles + s_cycleReg - phaseStart;
+                  phaseStart = s_cycleReg;
+                  // output and state of the tile before, while the filter runs
+                  if (tile > 0)
+                    begin
+                      ciWrite(ciDma, writeMemoryStartAddress, inputSlot(previous));
+                      ciWrite(ciDma, writeBlockSize, block_size_output);
+                      ciWrite(ciDma, writeBurstSize, burst_size_output);
+                      ciWrite(ciDma, writeBusStartAddress, sobel);
+                      ciWrite(ciDma, writeControlRegister, 2);
+                      sobel = (tile % tilesPerRow == 0) ? sobel + skip_line : sobel + tileWidth;
+                      waitDma;
+                      outputCycles = outputCycles + s_cycleReg - phaseStart;
+                      phaseStart = s_cycleReg;
+                      ciWrite(ciDma, writeMemoryStartAddress, stateSlot(previous));
+                      ciWrite(ciDma, writeBlockSize, block_size_state);
+                      ciWrite(ciDma, writeBurstSize, burst_size_state);
+                      ciWrite(ciDma, writeBusStartAddress, state);
+                      ciWrite(ciDma, writeControlRegister, 2);
+                      state = state + block_size_state*4;
+                      waitDma;
+                      stateWriteCycles = stateWriteCycles + s_cycleReg - phaseStart;
+                    end
+                  tileCycles = s_cycleReg - tileStart;
+                  if (tileCycles < minTileCycles) minTileCycles = tileCycles;
+                  if (tileCycles > maxTileCycles) maxTileCycles = tileCycles;
+                end
+              $display("frame %0d: %0d cycles, %0d cycles/tile (min %0d, max %0d), bus busy %0d cycles (%0d%%), overlapped",
+                       frameNr, s_cycleReg - frameStart, (s_cycleReg - frameStart) / nrOfTiles, minTileCycles, maxTileCycles,
+                       s_busBusyCycleReg - busStart, (s_busBusyCycleReg - busStart) * 100 / (s_cycleReg - frameStart));
+              $display("  previous state %0d, input + wait sobel %0d, output %0d, state write back %0d cycles",
+                       stateReadCycles, sobelCycles, outputCycles, stateWriteCycles);
+            end
+          else
+            begin
+              gray = grayBase;
+              sobel = sobelBase + 641;
+              state = stateBase;
+              ciWrite(ciDma, writeMemoryStartAddress, buff2);
+              ciWrite(ciDma, writeBusStartAddress, gray);
+              ciWrite(ciDma, writeBlockSize, block_size);
+              ciWrite(ciDma, writeBurstSize, burst_size);
+              ciWrite(ciDma, writeControlRegister, 1);
+              buffer = 1'b0;
+              waitDma;
+              for (tile = 1 ; tile <= nrOfTiles ; tile = tile + 1)
+                begin
+                  tileStart = s_cycleReg;
+                  lastrow = tile % tilesPerRow;
+                  // previous state of the tile
+                  if (packedState != 0)
+                    begin
+                      ciWrite(ciDma, writeBusStartAddress, state);
+                      ciWrite(ciDma, writeBlockSize, block_size_state);
+                      ciWrite(ciDma, writeBurstSize, burst_size_state);
+                    end
+                  else
+                    begin
+                      ciWrite(ciDma, writeBusStartAddress, sobel);
+                      ciWrite(ciDma, writeBlockSize, block_size_output);
+                      ciWrite(ciDma, writeBurstSize, burst_size_output);
+                    end
+                  ciWrite(ciDma, writeMemoryStartAddress, state_memory);
+                  ciWrite(ciDma, writeControlRegister, 1);
+                  waitDma;
+                  stateReadCycles = stateReadCycles + s_cycleReg - tileStart;
+                  phaseStart = s_cycleReg;
+                  // next input tile and filter
+                  if (tile < nrOfTiles)
+                    begin
+                      ciWrite(ciDma, writeMemoryStartAddress, (buffer == 1'b1) ? buff2 : buff1);
+                      gray = (lastrow == 0) ? gray + skip_line : gray + tileWidth;
+                      ciWrite(ciDma, writeBlockSize, block_size);
+                      ciWrite(ciDma, writeBurstSize, burst_size);
+                      ciWrite(ciDma, writeBusStartAddress, gray);
+                      ciWrite(ciDma, writeControlRegister, 1);
+                    end
+                  ciWrite(ciSobel, 32'd0, 32'd0);
+                  waitDma;
+                  waitSobel;
+                  sobelCycles = sobelCycles + s_cycleReg - phaseStart;
+                  phaseStart = s_cycleReg;
+                  // output of the tile
+                  ciWrite(ciDma, writeMemoryStartAddress, (buffer == 1'b1) ? buff1 : buff2);
+                  ciWrite(ciDma, writeBlockSize, block_size_output);
+                  ciWrite(ciDma, writeBurstSize, burst_size_output);
+                  ciWrite(ciDma, writeBusStartAddress, sobel);
+                  sobel = (lastrow == 0) ? sobel + skip_line : sobel + tileWidth;
+                  ciWrite(ciDma, writeControlRegister, 2);
+                  waitDma;
+                  outputCycles = outputCycles + s_cycleReg - phaseStart;
+                  phaseStart = s_cycleReg;
+                  if (packedState != 0)
+                    begin
+                      ciWrite(ciDma, writeMemoryStartAddress, state_memory);
+                      ciWrite(ciDma, writeBlockSize, block_size_state);
+                      ciWrite(ciDma, writeBurstSize, burst_size_state);
+                      ciWrite(ciDma, writeBusStartAddress, state);
+                      ciWrite(ciDma, writeControlRegister, 2);
+                      state = state + block_size_state*4;
+                      waitDma;
+                    end
+                  stateWriteCycles = stateWriteCycles + s_cycleReg - phaseStart;
+                  buffer = ~buffer;
+                  tileCycles = s_cycleReg - tileStart;
+                  if (tileCycles < minTileCycles) minTileCycles = tileCycles;
+                  if (tileCycles > maxTileCycles) maxTileCycles = tileCycles;
+                end
+              $display("frame %0d: %0d cycles, %0d cycles/tile (min %0d, max %0d), bus busy %0d cycles (%0d%%)",
+                       frameNr, s_cycleReg - frameStart, (s_cycleReg - frameStart) / nrOfTiles, minTileCycles, maxTileCycles,
+                       s_busBusyCycleReg - busStart, (s_busBusyCycleReg - busStart) * 100 / (s_cycleReg - frameStart));
+              $display("  previous state %0d, input + sobel %0d, output %0d, state write back %0d cycles",
+                       stateReadCycles, sobelCycles, outputCycles, stateWriteCycles);
+            end
+          $sformat(fileName, "result%0d.hex", frameNr);
+          $writememh(fileName, sdram.memory, sobelBase >> 2, (sobelBase >> 2) + nrOfFrameWords - 1);
+          readHistogramBins;
+          $sformat(fileName, "histogram%0d.hex", frameNr);
+          $writememh(fileName, histogram);
+          readSummaries;
+          if (frameMode == 0) ciWrite(ciDma, writeSummaryAddress, 32'd0); // the next frame starts again at entry 0
+          $sformat(fileName, "summary%0d.hex", frameNr);
+          $writememh(fileName, summary, 0, nrOfTiles - 1);
+          readBoxes;
+          ciWrite(ciDma, writeBoxClear, 32'd0);
+          $sformat(fileName, "boxes%0d.hex", frameNr);
+          $writememh(fileName, boxes);
+        end
+      if (s_errors != 0) $display("ERROR: %0d checks failed", s_errors);
+      $finish;
+    end
+
+endmodule
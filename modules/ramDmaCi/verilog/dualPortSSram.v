@@ -11,13 +11,13 @@ module dualPortSSRAM #( parameter bitwidth = 8,
   always @(posedge clockA)
     begin
       if (writeEnableA == 1'b1) memoryContent[addressA] = dataInA;
-      dataOutA = memoryContent[addressA];
+      dataOutA <= memoryContent[addressA];
     end
 
   always @(posedge clockB)
     begin
       if (writeEnableB == 1'b1) memoryContent[addressB] = dataInB;
-      dataOutB = memoryContent[addressB];
+      dataOutB <= memoryContent[addressB];
     end
 
 endmodule
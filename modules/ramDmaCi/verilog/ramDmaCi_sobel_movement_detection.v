@@ -7,6 +7,7 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
                    input wire [7:0]   ciN,
                    output wire        done ,
                    output wire [31:0] result,
+                   output reg         irq,
 
                    // Here the required bus signals are defined
                    output wire        requestTransaction,
@@ -36,7 +37,8 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
   
   assign done   = (s_isMyCi & valueA[9]) | s_isSramReadReg | s_isMyCiSobel;
   
-  always @(posedge clock) s_isSramReadReg = ~reset & s_isSramRead;
+  // a read of a tile summary in the cycle the filter writes one is done a cycle later (see below)
+  always @(posedge clock) s_isSramReadReg = ~reset & ((s_isSramRead & ~s_summaryReadCollision) | s_summaryReadRetryReg);
 
   /*
    *
@@ -44,26 +46,95 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
    *
    */
   reg[31:0] s_busStartAddressReg;
-  reg[8:0]  s_memoryStartAddressReg;
+  reg[9:0]  s_memoryStartAddressReg;
   reg[9:0]  s_blockSizeReg;
   reg[7:0]  s_usedBurstSizeReg;
   //register that holds the treshold value for the sobel filter. 
   //The treshold value idetermines the sensibility of the edge detection
   //The higher the value the less edges are detected (0 to 255)
   reg[7:0]  s_sobelTresholdReg;
+  //sobel configuration register:
+  //bit 0 : packed movement state, the state of the previous frame is read as 2 bits per pixel
+  //        (16 pixels per word, 48 words per tile at 476) and replaced by the state of this frame
+  //bit 1 : triple buffering (with bit 0 only), the filter runs in the slots 0, 1, 2, 0, ... (input at 0, 238 or 476,
+  //        packed state at 714, 762 or 810) instead of the buffer the dma does not use, so the write back of a tile and
+  //        the input of the next one are done while the filter runs. The slot restarts at 0 with every write of this
+  //        register and with the start of a chain or a frame
+  //bit 2 : stripe walk, the tiles are filtered down vertical stripes of the frame height (frame height register): the
+  //        filter keeps the last two lines of a tile in its line buffers, so every tile but the first one of a stripe is
+  //        an input block of (width/4+1) words by lines, the 2 lines of the block below the halo. The stripe restarts
+  //        with the slot above
+  //bit 3 : gradient magnitude output, the filter writes min(|Gx|+|Gy|,255) of every pixel instead of the movement
+  //        value; the packed state still gets the movement state of the frame
+  reg[7:0]  s_sobelConfigReg;
+  
+  //descriptor chain: with bit 2 of the control register the dma fetches transfer descriptors from the bus, starting at the bus start address.
+  //A descriptor is 4 words in bus byte order:
+  //word 0 : bus start address
+  //word 1 : [9:0] block size, [17:10] burst size, [26:18] memory start address bits [8:0],
+  //         [27] 1 = memory to bus, 0 = bus to memory, [28] wait until the sobel filter is idle before the transfer,
+  //         [29] start the sobel filter with the transfer, [30] memory start address bit 9, [31] last descriptor of the chain
+  //word 2 : bus address of the next descriptor
+  //word 3 : unused
+  //the fields are loaded in the registers below, so they read back the transfer in progress
+  reg[31:0] s_descriptorBusAddressReg, s_descriptorControlReg, s_descriptorNextReg;
+  wire      s_loadDescriptor;
+  //frame mode: with bit 0 of the frame control register the dma walks all tiles of a frame itself, generating the
+  //descriptors of the chain above from the frame registers. The gray image is read from the gray address, the
+  //output image is written at output address + stride (the first output line), the previous state is read from the
+  //previous address, in packed mode it is a packed state buffer (48 words per tile, in tile order) that is replaced
+  //by the state of this frame, otherwise the output image of the previous frame.
+  //The width has to be a multiple of the tile width and the height of the tile height.
+  //With triple buffering the write back of a tile and the reads of the next one are done while the filter runs.
+  //With the stripe walk the tiles are walked column by column, a tile below the first one of its column only reads
+  //the lines below the halo.
+  //With a summary address the walk ends with the transfer of the tile summaries of the frame (see below) to it.
+  reg[31:0] s_summaryAddressReg;
+  reg[31:0] s_frameGrayAddressReg, s_framePreviousAddressReg, s_frameOutputAddressReg;
+  reg[10:0] s_frameWidthReg, s_frameHeightReg;
+  //bytes between two image lines, used by all transfers
+  reg[11:0] s_strideReg;
+  //tile geometry: [6:2] output words per tile line (tile width in pixels / 4), [20:16] output lines per tile.
+  //An input block is (width/4+1) words by (lines+2) lines and has to fit in a buffer of 238 words, a tile
+  //has at most 192 output words, a multiple of 4, and at most 16 words per line (the line buffers of the filter).
+  reg[4:0]  s_tileWordsReg, s_tileLinesReg;
   
   always @(posedge clock)
     begin
       s_busStartAddressReg    <= (reset == 1'b1) ? 32'd0 :
-                                 (s_isMyCi == 1'b1 && valueA[12:9] == 4'b0011) ? valueB : s_busStartAddressReg;
-      s_memoryStartAddressReg <= (reset == 1'b1) ? 9'd0 :
-                                 (s_isMyCi == 1'b1 && valueA[12:9] == 4'b0101) ? valueB[8:0] : s_memoryStartAddressReg;
+                                 (s_loadDescriptor == 1'b1) ? s_descriptorBusAddressReg :
+                                 (s_isMyCi == 1'b1 && valueA[14:9] == 6'b000011) ? valueB : s_busStartAddressReg;
+      s_memoryStartAddressReg <= (reset == 1'b1) ? 10'd0 :
+                                 (s_loadDescriptor == 1'b1) ? {s_descriptorControlReg[30],s_descriptorControlReg[26:18]} :
+                                 (s_isMyCi == 1'b1 && valueA[14:9] == 6'b000101) ? valueB[9:0] : s_memoryStartAddressReg;
       s_blockSizeReg          <= (reset == 1'b1) ? 10'd0 :
-                                 (s_isMyCi == 1'b1 && valueA[12:9] == 4'b0111) ? valueB[9:0] : s_blockSizeReg;
+                                 (s_loadDescriptor == 1'b1) ? s_descriptorControlReg[9:0] :
+                                 (s_isMyCi == 1'b1 && valueA[14:9] == 6'b000111) ? valueB[9:0] : s_blockSizeReg;
       s_usedBurstSizeReg      <= (reset == 1'b1) ? 8'd0 :
-                                 (s_isMyCi == 1'b1 && valueA[12:9] == 4'b1001) ? valueB[7:0] : s_usedBurstSizeReg;
+                                 (s_loadDescriptor == 1'b1) ? s_descriptorControlReg[17:10] :
+                                 (s_isMyCi == 1'b1 && valueA[14:9] == 6'b001001) ? valueB[7:0] : s_usedBurstSizeReg;
       s_sobelTresholdReg      <= (reset==1'b1)  ? 8'd127 : 
-                                 (s_isMyCi == 1'b1 && valueA[12:9] == 4'b1101) ? valueB[7:0] : s_sobelTresholdReg;
+                                 (s_isMyCi == 1'b1 && valueA[14:9] == 6'b001101) ? valueB[7:0] : s_sobelTresholdReg;
+      s_sobelConfigReg        <= (reset == 1'b1) ? 8'd0 :
+                                 (s_isMyCi == 1'b1 && valueA[14:9] == 6'b001111) ? valueB[7:0] : s_sobelConfigReg;
+      s_frameGrayAddressReg     <= (reset == 1'b1) ? 32'd0 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b010001) ? valueB : s_frameGrayAddressReg;
+      s_framePreviousAddressReg <= (reset == 1'b1) ? 32'd0 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b010011) ? valueB : s_framePreviousAddressReg;
+      s_frameOutputAddressReg   <= (reset == 1'b1) ? 32'd0 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b010101) ? valueB : s_frameOutputAddressReg;
+      s_frameWidthReg           <= (reset == 1'b1) ? 11'd640 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b010111) ? valueB[10:0] : s_frameWidthReg;
+      s_frameHeightReg          <= (reset == 1'b1) ? 11'd480 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b011001) ? valueB[10:0] : s_frameHeightReg;
+      s_strideReg               <= (reset == 1'b1) ? 12'd640 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b011011) ? valueB[11:0] : s_strideReg;
+      s_tileWordsReg            <= (reset == 1'b1) ? 5'd16 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b011111) ? valueB[6:2] : s_tileWordsReg;
+      s_tileLinesReg            <= (reset == 1'b1) ? 5'd12 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b011111) ? valueB[20:16] : s_tileLinesReg;
+      s_summaryAddressReg       <= (reset == 1'b1) ? 32'd0 :
+                                   (s_isMyCi == 1'b1 && valueA[14:9] == 6'b100111) ? valueB : s_summaryAddressReg;
     end
 
   /*
@@ -92,14 +163,14 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
   wire [31:0] s_busRamData;
   
   dualPortSSRAM #( .bitwidth(32),
-                   .nrOfEntries(668)) memory
+                   .nrOfEntries(858)) memory
                  ( .clockA(clock), 
                    .clockB(~clock),
                    .writeEnableA(writeEnableSobel), 
                    .writeEnableB(s_ramCiWriteEnable),
                    .addressA(addressSobel), 
                    .addressB(s_ramCiAddressReg),
-                   .dataInA(s_sobelDataInReg), 
+                   .dataInA(s_sobelMemoryDataIn), 
                    .dataInB(s_addressDataInReg),
                    .dataOutA(sobelDataOut), 
                    .dataOutB(s_busRamData));
@@ -118,32 +189,57 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
   localparam [3:0] DO_WRITE = 4'd6;
   localparam [3:0] END_TRANSACTION_ERROR = 4'd7;
   localparam [3:0] END_WRITE_TRANSACTION = 4'd8;
+  localparam [3:0] REQUEST_DESCRIPTOR = 4'd9;
+  localparam [3:0] SET_UP_DESCRIPTOR = 4'd10;
+  localparam [3:0] READ_DESCRIPTOR = 4'd11;
+  localparam [3:0] LOAD_DESCRIPTOR = 4'd12;
+  localparam [3:0] GENERATE_DESCRIPTOR = 4'd13;
   
   reg [3:0] s_dmaCurrentStateReg, s_dmaNextState;
   reg       s_busErrorReg;
   reg       s_isReadBurstReg;
   reg[8:0]  s_wordsWrittenReg;
+  reg       s_chainActiveReg;
+  reg       s_frameModeReg;
+  reg[31:0] s_descriptorAddressReg;
+  reg[1:0]  s_descriptorWordReg;
   
   // a dma action is requested by the ci:
-  wire s_requestDmaIn = (valueA[12:9] == 4'b1011) ? s_isMyCi & valueB[0] & ~valueB[1] : 1'b0;
-  wire s_requestDmaOut = (valueA[12:9] == 4'b1011) ? s_isMyCi & ~valueB[0] & valueB[1] : 1'b0;
+  wire s_requestDmaIn = (valueA[14:9] == 6'b001011) ? s_isMyCi & valueB[0] & ~valueB[1] & ~valueB[2] : 1'b0;
+  wire s_requestDmaOut = (valueA[14:9] == 6'b001011) ? s_isMyCi & ~valueB[0] & valueB[1] & ~valueB[2] : 1'b0;
+  wire s_requestChain = (valueA[14:9] == 6'b001011) ? s_isMyCi & ~valueB[0] & ~valueB[1] & valueB[2] : 1'b0;
+  wire s_requestFrame = (valueA[14:9] == 6'b011101) ? s_isMyCi & valueB[0] : 1'b0;
   wire s_dmaIsBusy = (s_dmaCurrentStateReg == IDLE) ? 1'b0 : 1'b1;
   wire s_dmaDone;
+  // after a block the chain continues with the next descriptor
+  wire [3:0] s_dmaBlockDoneState = (s_chainActiveReg == 1'b0 || s_descriptorControlReg[31] == 1'b1) ? IDLE :
+                                   (s_frameModeReg == 1'b1) ? GENERATE_DESCRIPTOR : REQUEST_DESCRIPTOR;
+  wire s_waitForSobel = s_descriptorControlReg[28] & sobelStatusRegister;
+  
+  assign s_loadDescriptor = (s_dmaCurrentStateReg == LOAD_DESCRIPTOR) ? ~s_waitForSobel : 1'b0;
   
   // here we define the next state
   always @*
     case (s_dmaCurrentStateReg)
-      IDLE                  : s_dmaNextState <= (s_requestDmaIn == 1'b1 || s_requestDmaOut == 1'b1) ? INIT : IDLE;
-      INIT                  : s_dmaNextState <= REQUEST_BUS;
+      IDLE                  : s_dmaNextState <= (s_requestDmaIn == 1'b1 || s_requestDmaOut == 1'b1) ? INIT :
+                                                (s_requestChain == 1'b1) ? REQUEST_DESCRIPTOR :
+                                                (s_requestFrame == 1'b1) ? GENERATE_DESCRIPTOR : IDLE;
+      INIT                  : s_dmaNextState <= (s_blockSizeReg == 10'd0) ? s_dmaBlockDoneState : REQUEST_BUS;
       REQUEST_BUS           : s_dmaNextState <= (transactionGranted == 1'b1) ? SET_UP_TRANSACTION : REQUEST_BUS;
       SET_UP_TRANSACTION    : s_dmaNextState <= (s_isReadBurstReg == 1'b1) ? DO_READ : DO_WRITE;
       DO_READ               : s_dmaNextState <= (busErrorIn == 1'b1) ? WAIT_END:
-                                                (s_endTransactionInReg == 1'b1 && s_dmaDone == 1'b1) ? IDLE :
+                                                (s_endTransactionInReg == 1'b1 && s_dmaDone == 1'b1) ? s_dmaBlockDoneState :
                                                 (s_endTransactionInReg == 1'b1) ? REQUEST_BUS : DO_READ;
       WAIT_END              : s_dmaNextState <= (s_endTransactionInReg == 1'b1) ? IDLE : WAIT_END;
       DO_WRITE              : s_dmaNextState <= (busErrorIn == 1'b1) ? END_TRANSACTION_ERROR :
                                                 (s_wordsWrittenReg[8] == 1'b1 && busyIn == 1'b0) ? END_WRITE_TRANSACTION : DO_WRITE;
-      END_WRITE_TRANSACTION : s_dmaNextState <= (s_dmaDone == 1'b1) ? IDLE : REQUEST_BUS;
+      END_WRITE_TRANSACTION : s_dmaNextState <= (s_dmaDone == 1'b1) ? s_dmaBlockDoneState : REQUEST_BUS;
+      REQUEST_DESCRIPTOR    : s_dmaNextState <= (transactionGranted == 1'b1) ? SET_UP_DESCRIPTOR : REQUEST_DESCRIPTOR;
+      SET_UP_DESCRIPTOR     : s_dmaNextState <= READ_DESCRIPTOR;
+      READ_DESCRIPTOR       : s_dmaNextState <= (busErrorIn == 1'b1) ? WAIT_END :
+                                                (s_endTransactionInReg == 1'b1) ? LOAD_DESCRIPTOR : READ_DESCRIPTOR;
+      LOAD_DESCRIPTOR       : s_dmaNextState <= (s_waitForSobel == 1'b1) ? LOAD_DESCRIPTOR : INIT;
+      GENERATE_DESCRIPTOR   : s_dmaNextState <= LOAD_DESCRIPTOR;
       default               : s_dmaNextState <= IDLE;
     endcase
   
@@ -152,9 +248,192 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
       s_dmaCurrentStateReg <= (reset == 1'b1) ? IDLE : s_dmaNextState;
       s_busErrorReg        <= (reset == 1'b1 || s_dmaCurrentStateReg == INIT) ? 1'b0 :
                               (s_dmaCurrentStateReg == WAIT_END || s_dmaCurrentStateReg == END_TRANSACTION_ERROR) ? 1'b1 : s_busErrorReg;
-      s_isReadBurstReg     <= (s_dmaCurrentStateReg == IDLE) ? s_requestDmaIn : s_isReadBurstReg;
+      s_isReadBurstReg     <= (s_dmaCurrentStateReg == IDLE) ? s_requestDmaIn :
+                              (s_dmaCurrentStateReg == LOAD_DESCRIPTOR) ? ~s_descriptorControlReg[27] : s_isReadBurstReg;
+      s_chainActiveReg     <= (reset == 1'b1) ? 1'b0 : (s_dmaCurrentStateReg == IDLE) ? s_requestChain | s_requestFrame : s_chainActiveReg;
+      s_frameModeReg       <= (reset == 1'b1) ? 1'b0 : (s_dmaCurrentStateReg == IDLE) ? s_requestFrame : s_frameModeReg;
+    end
+
+  /*
+   *
+   * Here we define the descriptor fetch, a read burst of 4 words that is captured in the descriptor registers
+   *
+   */
+  wire s_descriptorWordValid = (s_dmaCurrentStateReg == READ_DESCRIPTOR) ? s_dataValidInReg : 1'b0;
+
+  always @(posedge clock)
+    begin
+      s_descriptorAddressReg    <= (s_dmaCurrentStateReg == IDLE) ? s_busStartAddressReg :
+                                   (s_loadDescriptor == 1'b1) ? s_descriptorNextReg : s_descriptorAddressReg;
+      s_descriptorWordReg       <= (s_dmaCurrentStateReg == SET_UP_DESCRIPTOR) ? 2'd0 :
+                                   (s_descriptorWordValid == 1'b1) ? s_descriptorWordReg + 2'd1 : s_descriptorWordReg;
+      s_descriptorBusAddressReg <= (s_dmaCurrentStateReg == GENERATE_DESCRIPTOR) ? s_frameBusAddress :
+                                   (s_descriptorWordValid == 1'b1 && s_descriptorWordReg == 2'd0) ? s_addressDataInReg : s_descriptorBusAddressReg;
+      s_descriptorControlReg    <= (reset == 1'b1) ? 32'd0 :
+                                   (s_dmaCurrentStateReg == GENERATE_DESCRIPTOR) ? s_frameControl :
+                                   (s_descriptorWordValid == 1'b1 && s_descriptorWordReg == 2'd1) ? s_addressDataInReg : s_descriptorControlReg;
+      s_descriptorNextReg       <= (s_descriptorWordValid == 1'b1 && s_descriptorWordReg == 2'd2) ? s_addressDataInReg : s_descriptorNextReg;
+    end
+
+  /*
+   *
+   * Here we define the tile walk of the frame mode. Every tile is a state read, the input of the next tile together
+   * with the start of the sobel filter, the output and, in packed mode, the state write back; the same sequence as
+   * sobel_mov_detection.c. The input of the first tile comes before.
+   * With triple buffering the walk starts with the state read and every step reads the state and the input of tile
+   * n+1 in slot n+1, starts the filter on tile n once the one of tile n-1 is done and writes the output and the
+   * state of tile n-1 back from slot n-1; the walk ends with an empty step that writes the last tile back.
+   * With a summary address the transfer of the written tile summaries follows the last tile, in contiguous bursts
+   * of 64 words independent of the stride.
+   *
+   */
+  localparam [2:0] FIRST_INPUT = 3'd0;
+  localparam [2:0] STATE_READ = 3'd1;
+  localparam [2:0] NEXT_INPUT = 3'd2;
+  localparam [2:0] TILE_OUTPUT = 3'd3;
+  localparam [2:0] STATE_WRITE = 3'd4;
+  localparam [2:0] SUMMARY_WRITE = 3'd5;
+
+  wire [9:0]  s_tileInputWords = ({5'd0,s_tileWordsReg} + 10'd1) * ({5'd0,s_tileLinesReg} + 10'd2);
+  wire [9:0]  s_tileStripeInputWords = ({5'd0,s_tileWordsReg} + 10'd1) * {5'd0,s_tileLinesReg};
+  wire [9:0]  s_tileOutputWords = {5'd0,s_tileWordsReg} * {5'd0,s_tileLinesReg};
+  wire [9:0]  s_tileStateWords = {2'd0,s_tileOutputWords[9:2]};
+  wire [7:0]  s_tileLineBurst = {3'd0,s_tileWordsReg} - 8'd1;
+  wire [10:0] s_tilePixels = {4'd0,s_tileWordsReg,2'd0};
+  wire        s_tripleBuffer = s_sobelConfigReg[1] & s_packedState;
+  wire        s_stripeWalk = s_sobelConfigReg[2];
+  wire        s_frameSummary = (s_summaryAddressReg != 32'd0) ? 1'b1 : 1'b0;
+  wire        s_frameLastTransfer = s_frameLastTileReg & ~s_frameSummary;
+  wire        s_magnitudeOutput = s_sobelConfigReg[3];
+
+  reg [2:0]  s_framePhaseReg;
+  reg        s_frameBufferReg, s_frameLastTileReg, s_frameDoneReg;
+  reg        s_frameFilterPendingReg;   // triple buffering: the input of the next step exists, its filter is started
+  reg        s_frameOutputPendingReg;   // triple buffering: the step writes a tile back
+  reg [1:0]  s_frameSlotReg;            // triple buffering: slot of the next input
+  reg [10:0] s_framePixelsLeftReg;      // pixels left in the row of the next input, its tile included (stripe walk: from its stripe on)
+  reg [10:0] s_frameLinesLeftReg;       // lines left from the row of the next input on (stripe walk: in its stripe, its tile included)
+  reg [31:0] s_frameRowOffsetReg;       // offset of the row (stripe walk: of the stripe) of the next input
+  reg [31:0] s_frameNextOffsetReg;      // offset of the next input block
+  reg [31:0] s_framePendingOffsetReg;   // offset of the block that is filtered next
+  reg [31:0] s_frameTileOffsetReg;      // offset of the block of the current tile
+  reg [31:0] s_frameStateAddressReg;    // packed state of the current tile
+  reg [31:0] s_frameStateReadAddressReg;// triple buffering: packed state of the next input
+  reg [15:0] s_frameTilesDoneReg;
+  reg        s_summaryTransfer;         // the transfer in progress reads the tile summaries instead of the ci memory
+  reg [9:0]  s_summaryEntriesReg;       // tile summaries written, the block size of the summary transfer
+
+  wire        s_frameGenerate = (s_dmaCurrentStateReg == GENERATE_DESCRIPTOR) ? 1'b1 : 1'b0;
+  wire        s_frameStart = (s_dmaCurrentStateReg == IDLE) ? s_requestFrame : 1'b0;
+  wire        s_frameInputExists = (s_stripeWalk == 1'b1) ? ((s_framePixelsLeftReg >= s_tilePixels) ? 1'b1 : 1'b0) :
+                                   (s_frameLinesLeftReg >= {6'd0,s_tileLinesReg}) ? 1'b1 : 1'b0;
+  // the next input is the last tile of its row, or of its stripe
+  wire        s_frameRowEnd = (s_stripeWalk == 1'b1) ? ((s_frameLinesLeftReg <= {6'd0,s_tileLinesReg}) ? 1'b1 : 1'b0) :
+                              (s_framePixelsLeftReg <= s_tilePixels) ? 1'b1 : 1'b0;
+  // the next input continues a stripe, the filter holds its halo lines
+  wire        s_frameContinue = (s_stripeWalk == 1'b1 && s_frameLinesLeftReg != s_frameHeightReg) ? 1'b1 : 1'b0;
+  wire        s_frameAdvance = (s_frameGenerate == 1'b1 && (s_framePhaseReg == FIRST_INPUT || s_framePhaseReg == NEXT_INPUT)) ? s_frameInputExists : 1'b0;
+  wire        s_frameTileDone = (s_frameGenerate == 1'b1 && (s_framePhaseReg == STATE_WRITE || (s_framePhaseReg == TILE_OUTPUT && s_packedState == 1'b0))) ? 1'b1 : 1'b0;
+  wire        s_frameTileWritten = s_frameTileDone & (~s_tripleBuffer | s_frameOutputPendingReg);
+  wire        s_frameNextStep = (s_frameGenerate == 1'b1 && s_framePhaseReg == NEXT_INPUT) ? 1'b1 : 1'b0;
+  wire [31:0] s_frameStride = {20'd0,s_strideReg};
+  wire [31:0] s_frameRowSize = s_frameStride * {27'd0,s_tileLinesReg};
+  // offset from a tile to the next one in the walk, and from a row (stripe) to the next one
+  wire [31:0] s_frameTileStep = (s_stripeWalk == 1'b1) ? s_frameRowSize : {21'd0,s_tilePixels};
+  wire [31:0] s_frameRowStep = (s_stripeWalk == 1'b1) ? {21'd0,s_tilePixels} : s_frameRowSize;
+  wire [31:0] s_frameInputAddress = s_frameGrayAddressReg + s_frameNextOffsetReg + ((s_frameContinue == 1'b1) ? {s_frameStride[30:0],1'b0} : 32'd0);
+  wire [9:0]  s_frameInputWords = (s_frameContinue == 1'b1) ? s_tileStripeInputWords : s_tileInputWords;
+  wire [31:0] s_frameTileOutputOffset = s_frameTileOffsetReg + s_frameStride;
+  wire [8:0]  s_frameNextBuffer = (s_frameBufferReg == 1'b1) ? 9'd238 : 9'd0;
+  wire [8:0]  s_frameFilterBuffer = (s_frameBufferReg == 1'b1) ? 9'd0 : 9'd238;
+  // slot of the tile written back, two behind the one of the next input
+  wire [1:0]  s_frameOutputSlot = (s_frameSlotReg == 2'd2) ? 2'd0 : s_frameSlotReg + 2'd1;
+  wire [8:0]  s_frameSlotBuffer = (s_frameSlotReg == 2'd0) ? 9'd0 : (s_frameSlotReg == 2'd1) ? 9'd238 : 9'd476;
+  wire [9:0]  s_frameSlotState = (s_frameSlotReg == 2'd0) ? 10'd714 : (s_frameSlotReg == 2'd1) ? 10'd762 : 10'd810;
+  wire [8:0]  s_frameOutputBuffer = (s_frameOutputSlot == 2'd0) ? 9'd0 : (s_frameOutputSlot == 2'd1) ? 9'd238 : 9'd476;
+  wire [9:0]  s_frameOutputState = (s_frameOutputSlot == 2'd0) ? 10'd714 : (s_frameOutputSlot == 2'd1) ? 10'd762 : 10'd810;
+  wire [9:0]  s_frameStateBlock = (s_tripleBuffer == 1'b0 || s_frameOutputPendingReg == 1'b1) ? s_tileStateWords : 10'd0;
+  reg [31:0]  s_frameBusAddress, s_frameControl;
+
+  // {last, memory address bit 9, start sobel, wait sobel, memory to bus, memory address, burst size, block size}
+  always @*
+    case (s_framePhaseReg)
+      FIRST_INPUT : begin
+                      s_frameBusAddress <= s_frameInputAddress;
+                      s_frameControl    <= {5'b00000,9'd238,s_tileLineBurst + 8'd1,s_tileInputWords};
+                    end
+      STATE_READ  : begin
+                      s_frameBusAddress <= (s_tripleBuffer == 1'b1) ? s_frameStateReadAddressReg :
+                                           (s_packedState == 1'b1) ? s_frameStateAddressReg : s_framePreviousAddressReg + s_frameTileOutputOffset;
+                      s_frameControl    <= (s_tripleBuffer == 1'b1) ? {1'b0,s_frameSlotState[9],3'b000,s_frameSlotState[8:0],s_tileStateWords[7:0] - 8'd1,
+                                                                       (s_frameInputExists == 1'b1) ? s_tileStateWords : 10'd0} :
+                                           (s_packedState == 1'b1) ? {5'b00000,9'd476,s_tileStateWords[7:0] - 8'd1,s_tileStateWords} :
+                                                                     {5'b00000,9'd476,s_tileLineBurst,s_tileOutputWords};
+                    end
+      NEXT_INPUT  : begin
+                      s_frameBusAddress <= s_frameInputAddress;
+                      s_frameControl    <= {2'b00,~s_tripleBuffer,2'b00,(s_tripleBuffer == 1'b1) ? s_frameSlotBuffer : s_frameNextBuffer,
+                                            s_tileLineBurst + 8'd1,(s_frameInputExists == 1'b1) ? s_frameInputWords : 10'd0};
+                    end
+      TILE_OUTPUT : begin
+                      s_frameBusAddress <= s_frameOutputAddressReg + s_frameTileOutputOffset;
+                      s_frameControl    <= (s_tripleBuffer == 1'b1) ? {2'b00,s_frameFilterPendingReg,2'b11,s_frameOutputBuffer,s_tileLineBurst,
+                                                                       (s_frameOutputPendingReg == 1'b1) ? s_tileOutputWords : 10'd0} :
+                                                                      {s_frameLastTransfer & ~s_packedState,4'b0011,s_frameFilterBuffer,s_tileLineBurst,s_tileOutputWords};
+                    end
+      SUMMARY_WRITE : begin
+                      s_frameBusAddress <= s_summaryAddressReg;
+                      s_frameControl    <= {5'b10011,9'd0,8'd63,s_summaryEntriesReg};
+                    end
+      default     : begin
+                      s_frameBusAddress <= s_frameStateAddressReg;
+                      s_frameControl    <= (s_tripleBuffer == 1'b1) ? {s_frameLastTransfer,s_frameOutputState[9],3'b001,s_frameOutputState[8:0],s_tileStateWords[7:0] - 8'd1,s_frameStateBlock} :
+                                                                      {s_frameLastTransfer,4'b0001,9'd476,s_tileStateWords[7:0] - 8'd1,s_tileStateWords};
+                    end
+    endcase
+
+  always @(posedge clock)
+    begin
+      s_framePhaseReg         <= (reset == 1'b1) ? FIRST_INPUT :
+                                 (s_frameStart == 1'b1) ? ((s_tripleBuffer == 1'b1) ? STATE_READ : FIRST_INPUT) :
+                                 (s_frameTileDone == 1'b1 && s_frameLastTileReg == 1'b1 && s_frameSummary == 1'b1) ? SUMMARY_WRITE :
+                                 (s_frameTileDone == 1'b1 || (s_frameGenerate == 1'b1 && s_framePhaseReg == FIRST_INPUT)) ? STATE_READ :
+                                 (s_frameGenerate == 1'b1 && s_framePhaseReg == SUMMARY_WRITE) ? SUMMARY_WRITE :
+                                 (s_frameGenerate == 1'b1) ? s_framePhaseReg + 3'd1 : s_framePhaseReg;
+      s_frameBufferReg        <= (s_frameStart == 1'b1) ? 1'b0 : (s_frameTileDone == 1'b1) ? ~s_frameBufferReg : s_frameBufferReg;
+      s_frameLastTileReg      <= (s_frameStart == 1'b1) ? 1'b0 :
+                                 (s_frameNextStep == 1'b1) ? ~s_frameInputExists : s_frameLastTileReg;
+      s_frameFilterPendingReg <= (s_frameStart == 1'b1) ? 1'b0 : (s_frameNextStep == 1'b1) ? s_frameInputExists : s_frameFilterPendingReg;
+      s_frameOutputPendingReg <= (s_frameStart == 1'b1) ? 1'b0 : (s_frameNextStep == 1'b1) ? s_frameFilterPendingReg : s_frameOutputPendingReg;
+      s_frameSlotReg          <= (s_frameStart == 1'b1) ? 2'd0 :
+                                 (s_frameNextStep == 1'b1) ? ((s_frameSlotReg == 2'd2) ? 2'd0 : s_frameSlotReg + 2'd1) : s_frameSlotReg;
+      s_framePixelsLeftReg    <= (s_frameStart == 1'b1 || (s_frameAdvance == 1'b1 && s_frameRowEnd == 1'b1 && s_stripeWalk == 1'b0)) ? s_frameWidthReg :
+                                 (s_frameAdvance == 1'b1 && (s_frameRowEnd == 1'b1 || s_stripeWalk == 1'b0)) ? s_framePixelsLeftReg - s_tilePixels : s_framePixelsLeftReg;
+      s_frameLinesLeftReg     <= (s_frameStart == 1'b1 || (s_frameAdvance == 1'b1 && s_frameRowEnd == 1'b1 && s_stripeWalk == 1'b1)) ? s_frameHeightReg :
+                                 (s_frameAdvance == 1'b1 && (s_frameRowEnd == 1'b1 || s_stripeWalk == 1'b1)) ? s_frameLinesLeftReg - {6'd0,s_tileLinesReg} : s_frameLinesLeftReg;
+      s_frameRowOffsetReg     <= (s_frameStart == 1'b1) ? 32'd0 :
+                                 (s_frameAdvance == 1'b1 && s_frameRowEnd == 1'b1) ? s_frameRowOffsetReg + s_frameRowStep : s_frameRowOffsetReg;
+      s_frameNextOffsetReg    <= (s_frameStart == 1'b1) ? 32'd0 :
+                                 (s_frameAdvance == 1'b1 && s_frameRowEnd == 1'b1) ? s_frameRowOffsetReg + s_frameRowStep :
+                                 (s_frameAdvance == 1'b1) ? s_frameNextOffsetReg + s_frameTileStep : s_frameNextOffsetReg;
+      s_framePendingOffsetReg <= (s_frameNextStep == 1'b1) ? s_frameNextOffsetReg : s_framePendingOffsetReg;
+      s_frameTileOffsetReg    <= (s_frameGenerate == 1'b1 && s_framePhaseReg == FIRST_INPUT) ? s_frameNextOffsetReg :
+                                 (s_frameNextStep == 1'b1 && s_tripleBuffer == 1'b1) ? s_framePendingOffsetReg :
+                                 (s_frameTileDone == 1'b1 && s_tripleBuffer == 1'b0) ? s_framePendingOffsetReg : s_frameTileOffsetReg;
+      s_frameStateAddressReg  <= (s_frameStart == 1'b1) ? s_framePreviousAddressReg :
+                                 (s_frameTileWritten == 1'b1) ? s_frameStateAddressReg + {22'd0,s_tileOutputWords} : s_frameStateAddressReg;
+      s_frameStateReadAddressReg <= (s_frameStart == 1'b1) ? s_framePreviousAddressReg :
+                                    (s_frameGenerate == 1'b1 && s_framePhaseReg == STATE_READ && s_frameInputExists == 1'b1) ?
+                                     s_frameStateReadAddressReg + {22'd0,s_tileOutputWords} : s_frameStateReadAddressReg;
+      s_summaryTransfer       <= (s_dmaCurrentStateReg == IDLE) ? 1'b0 :
+                                 (s_frameGenerate == 1'b1) ? ((s_framePhaseReg == SUMMARY_WRITE) ? 1'b1 : 1'b0) : s_summaryTransfer;
+      s_frameTilesDoneReg     <= (s_frameStart == 1'b1) ? 16'd0 : (s_frameTileWritten == 1'b1) ? s_frameTilesDoneReg + 16'd1 : s_frameTilesDoneReg;
+      s_frameDoneReg          <= (reset == 1'b1 || s_frameStart == 1'b1) ? 1'b0 :
+                                 (s_frameModeReg == 1'b1 && s_dmaCurrentStateReg != IDLE && s_dmaNextState == IDLE) ? 1'b1 : s_frameDoneReg;
     end
 
+  wire s_frameBusy = s_frameModeReg & s_dmaIsBusy;
+
   /*
    *
    * Here we define the shadow registers used by the dma-controller
@@ -171,13 +450,13 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
   
   always @(posedge clock)
     begin 
-      //at end of window line, increase buststartaddress to skip the image line
+      //at end of window line, increase buststartaddress to skip the image line, the tile summaries follow each other
       s_busStartAddressShadowReg <= (s_dmaCurrentStateReg == INIT) ? s_busStartAddressReg :
                                     ((s_dmaCurrentStateReg==DO_READ && s_endTransactionInReg == 1'b1 )||(s_dmaCurrentStateReg==END_WRITE_TRANSACTION) ) ?
-                                     s_busStartAddressShadowReg + 32'd640 : s_busStartAddressShadowReg;
+                                     s_busStartAddressShadowReg + ((s_summaryTransfer == 1'b1) ? 32'd256 : {20'd0,s_strideReg}) : s_busStartAddressShadowReg;
       s_blockSizeShadowReg       <= (s_dmaCurrentStateReg == INIT) ? s_blockSizeReg :
                                     (s_ramCiWriteEnable == 1'b1 || s_doBusWrite == 1'b1) ? s_blockSizeShadowReg - 10'd1 : s_blockSizeShadowReg;
-      s_ramCiAddressReg          <= (s_dmaCurrentStateReg == INIT) ? {1'b0,s_memoryStartAddressReg} :
+      s_ramCiAddressReg          <= (s_dmaCurrentStateReg == INIT) ? s_memoryStartAddressReg :
                                     (s_ramCiWriteEnable == 1'b1 || s_doBusWrite == 1'b1) ? s_ramCiAddressReg + 10'd1 : s_ramCiAddressReg;
     end
   
@@ -192,25 +471,51 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
   wire [9:0] s_restingBlockSize = s_blockSizeShadowReg - 10'd1;
   wire [7:0] s_usedBurstSize = (s_blockSizeShadowReg > s_maxBurstSize) ? s_usedBurstSizeReg : s_restingBlockSize[7:0];
   
-  assign requestTransaction = (s_dmaCurrentStateReg == REQUEST_BUS) ? 1'd1 : 1'd0;
+  wire s_setUpDescriptor = (s_dmaCurrentStateReg == SET_UP_DESCRIPTOR) ? 1'b1 : 1'b0;
+  
+  assign requestTransaction = (s_dmaCurrentStateReg == REQUEST_BUS || s_dmaCurrentStateReg == REQUEST_DESCRIPTOR) ? 1'd1 : 1'd0;
   assign dataValidOut = s_dataOutValidReg;
   assign addressDataOut = s_addressDataOutReg;
   
   always @(posedge clock)
     begin
-      beginTransactionOut <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? 1'b1 : 1'b0;
-      readNotWriteOut     <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? s_isReadBurstReg : 1'b0;
-      byteEnablesOut      <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? 4'hF : 4'd0;
-      burstSizeOut        <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? s_usedBurstSize : 8'd0;
+      beginTransactionOut <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION || s_setUpDescriptor == 1'b1) ? 1'b1 : 1'b0;
+      readNotWriteOut     <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? s_isReadBurstReg : s_setUpDescriptor;
+      byteEnablesOut      <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION || s_setUpDescriptor == 1'b1) ? 4'hF : 4'd0;
+      burstSizeOut        <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? s_usedBurstSize : 
+                             (s_setUpDescriptor == 1'b1) ? 8'd3 : 8'd0;
       s_addressDataOutReg <= (s_dmaCurrentStateReg == DO_WRITE && busyIn == 1'b1) ? s_addressDataOutReg :
-                             (s_doBusWrite == 1'b1) ? s_busRamData : 
-                             (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? {s_busStartAddressShadowReg[31:2],2'd0} : 32'd0;
+                             (s_doBusWrite == 1'b1) ? ((s_summaryTransfer == 1'b1) ? s_summaryBusData : s_busRamData) : 
+                             (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? {s_busStartAddressShadowReg[31:2],2'd0} :
+                             (s_setUpDescriptor == 1'b1) ? {s_descriptorAddressReg[31:2],2'd0} : 32'd0;
       s_wordsWrittenReg   <= (s_dmaCurrentStateReg == SET_UP_TRANSACTION) ? {1'b0,s_usedBurstSize} : 
                              (s_doBusWrite == 1'b1) ? s_wordsWrittenReg - 9'd1 : s_wordsWrittenReg;
       endTransactionOut   <= (s_dmaCurrentStateReg == END_TRANSACTION_ERROR || s_dmaCurrentStateReg == END_WRITE_TRANSACTION) ? 1'b1 : 1'b0;
       s_dataOutValidReg   <= (busyIn == 1'b1 && s_dmaCurrentStateReg == DO_WRITE) ? s_dataOutValidReg : s_doBusWrite;
     end
 
+  /*
+   *
+   * Here we define the completion interrupt. A pending bit is set when the dma returns to idle (bit 0, the end of a
+   * transfer, a chain or a frame) and when the sobel filter is done (bit 1); irq is the or of the enabled pending bits.
+   * Writing the interrupt acknowledge register clears the pending bits set in valueB and drops irq for a cycle, so a
+   * bit that is still pending raises a new edge for the cpu.
+   *
+   */
+  reg [1:0] s_irqEnableReg, s_irqPendingReg;
+  wire      s_irqAcknowledge = (s_isMyCi == 1'b1 && valueA[14:9] == 6'b100011) ? 1'b1 : 1'b0;
+  wire [1:0] s_irqEvents = {sobel_done, (s_dmaCurrentStateReg != IDLE && s_dmaNextState == IDLE) ? 1'b1 : 1'b0};
+  wire [1:0] s_irqPendingNext = (s_irqPendingReg & ~((s_irqAcknowledge == 1'b1) ? valueB[1:0] : 2'd0)) | s_irqEvents;
+
+  always @(posedge clock)
+    begin
+      s_irqEnableReg  <= (reset == 1'b1) ? 2'd0 :
+                         (s_isMyCi == 1'b1 && valueA[14:9] == 6'b100001) ? valueB[1:0] : s_irqEnableReg;
+      s_irqPendingReg <= (reset == 1'b1) ? 2'd0 : s_irqPendingNext;
+      irq             <= (reset == 1'b1 || s_irqAcknowledge == 1'b1) ? 1'b0 :
+                         (s_irqPendingNext & s_irqEnableReg) != 2'd0 ? 1'b1 : 1'b0;
+    end
+
   /*
    *
    * Here we define the result value
@@ -219,13 +524,30 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
   reg[31:0] s_result;
   
   always @*
-    case (valueA[12:10])
-      3'b000    : s_result <= {31'd0,sobelStatusRegister};
-      3'b001    : s_result <= s_busStartAddressReg;
-      3'b010    : s_result <= {23'd0,s_memoryStartAddressReg};
-      3'b011    : s_result <= {22'd0,s_blockSizeReg};
-      3'b100    : s_result <= {24'd0,s_usedBurstSizeReg};
-      3'b101    : s_result <= {30'd0,s_busErrorReg,s_dmaIsBusy};
+    case (valueA[14:10])
+      5'b00000  : s_result <= {31'd0,sobelStatusRegister};
+      5'b00001  : s_result <= s_busStartAddressReg;
+      5'b00010  : s_result <= {22'd0,s_memoryStartAddressReg};
+      5'b00011  : s_result <= {22'd0,s_blockSizeReg};
+      5'b00100  : s_result <= {24'd0,s_usedBurstSizeReg};
+      5'b00101  : s_result <= {30'd0,s_busErrorReg,s_dmaIsBusy};
+      5'b00110  : s_result <= s_descriptorAddressReg;
+      5'b00111  : s_result <= {24'd0,s_sobelConfigReg};
+      5'b01000  : s_result <= s_frameGrayAddressReg;
+      5'b01001  : s_result <= s_framePreviousAddressReg;
+      5'b01010  : s_result <= s_frameOutputAddressReg;
+      5'b01011  : s_result <= {21'd0,s_frameWidthReg};
+      5'b01100  : s_result <= {21'd0,s_frameHeightReg};
+      5'b01101  : s_result <= {20'd0,s_strideReg};
+      5'b01110  : s_result <= {s_frameTilesDoneReg,14'd0,s_frameDoneReg,s_frameBusy};
+      5'b01111  : s_result <= {11'd0,s_tileLinesReg,9'd0,s_tileWordsReg,2'd0};
+      5'b10000  : s_result <= {30'd0,s_irqPendingReg};
+      5'b10001  : s_result <= {30'd0,s_irqEnableReg};
+      5'b10010  : s_result <= s_histogramResult;
+      5'b10011  : s_result <= {31'd0,s_histogramClearing};
+      5'b10100  : s_result <= s_summaryCiData;
+      5'b10101  : s_result <= {s_summaryOverflowReg,21'd0,s_summaryEntriesReg};
+      5'b10110  : s_result <= (valueA[3:1] > 3'd4) ? 32'd0 : {5'd0,s_boxResult[21:11],5'd0,s_boxResult[10:0]};
       default   : s_result <= 32'd0;
     endcase
   
@@ -237,132 +559,400 @@ module ramDmaCi #( parameter [7:0] customIdDMA = 8'h00,  parameter [7:0] customI
 
   reg s_isMyCiSobel;
   always @(posedge clock) s_isMyCiSobel <= (reset==1'b1) ? 1'b0 : isMyCiSobel;
+  // the sobel filter is started by the ci or by a descriptor of the chain, when its transfer begins
+  wire s_chainStartsSobel = (s_dmaCurrentStateReg == INIT && s_chainActiveReg == 1'b1) ? s_descriptorControlReg[29] : 1'b0;
+  reg s_startSobelReg;
+  always @(posedge clock) s_startSobelReg <= (reset==1'b1) ? 1'b0 : isMyCiSobel | s_chainStartsSobel;
                                             
-  reg [2:0] counterSobel;                  // counter for the 3x3 window
-  wire sobel_done, counter_done;           // flags for the end of the sobel computation
-  wire [4:0] windowIndex;
-  
-  assign windowIndex = (counterSobel == 3'd0||counterSobel == 3'd1) ? 5'd0:
-                       (counterSobel == 3'd2) ? 5'd4:
-                       (counterSobel == 3'd3) ? 5'd6:
-                       (counterSobel == 3'd4) ? 5'd10:
-                       (counterSobel == 3'd5) ? 5'd12:
-                        5'd16;
+  // The filter reads the input block once, word by word in memory order. Every word is shifted into a column of
+  // 3 words (the same word of the two lines above comes from the line buffers), so the 3x6 window of a group of 4
+  // pixels is the previous column and the first 2 pixels of the new one, and every read of a word that is not in the
+  // first column or the first 2 lines of the block completes a group. The memory port alternates reads and writes
+  // of the results; the state of the previous frame is read before the read that completes a group that needs it
+  // (every group, or every 4 groups in packed mode) and the packed state word written after the 4th group.
+  // With the stripe walk a block that continues a stripe is read as if it followed the block above it.
+  localparam [2:0] IDLE_SOBEL = 3'd0;                 // idle state
+  localparam [2:0] SOBEL_READ = 3'd1;                 // read the next input word
+  localparam [2:0] SOBEL_WRITE = 3'd2;                // write the result of the last group that is ready
+  localparam [2:0] SOBEL_COMPARE = 3'd3;              // read the state of the previous frame for the next group
+  localparam [2:0] SOBEL_PACK = 3'd4;                 // write the packed state of the last 4 groups
+  localparam [2:0] SOBEL_DRAIN = 3'd5;                // wait for the last group after the last read
+
+  reg [2:0] s_SobelCurrentStateReg, s_SobelNextState;
+  wire sobelStatusRegister;
+  assign sobelStatusRegister = (s_SobelCurrentStateReg == IDLE_SOBEL) ? 1'b0 : 1'b1; // to wait for the end of the sobel filter
+  wire sobel_done;                         // the last transition of the sobel filter, back to idle
+
   reg [7:0] window [17:0];                 // 3x6 window  
-  reg [8:0]  initialCounterWord;                   // counter for the pixels on the image, it extends the 32-bit address to a 8-bit one
-  reg [7:0] counterWindow;                 // counter for the positions taken by the window 
+  reg [31:0] s_columnTopReg, s_columnMiddleReg, s_columnBottomReg;  // the last column shifted in
+  reg [31:0] s_lineBufferTop [16:0];       // the words of the two lines above the last read, the last one first
+  reg [31:0] s_lineBufferMiddle [16:0];
+  reg [9:0] s_sobelReadsLeftReg;           // input words left to read
+  reg [4:0] s_sobelColumnReg;              // word column of the next read in the block
+  reg [1:0] s_sobelLinesReg;               // block lines read, up to 2
+  reg [7:0] s_sobelGroupReg;               // group completed by the next read that completes one
+  reg [1:0] s_sobelCaptureGroupReg;        // group that is captured next, modulo 4
+  reg [1:0] s_sobelGroupDelayReg;          // a read that completes a group was issued 1 ([0]) or 2 ([1]) cycles ago
+  reg s_sobelReadDelayReg, s_sobelCompareDelayReg, s_sobelWritePendingReg;
+  reg [31:0] s_comparisonReg;              // state of the previous frame of the next captured group
+  reg [7:0] counterWindow;                 // groups written
   wire [31:0] sobelDataOut;
   reg [31:0] s_sobelDataOut;              // output of the memory to the sobel modules
   always @* s_sobelDataOut <= sobelDataOut;
   wire [31:0] s_sobelDataIn;                 
-  reg [31:0] s_sobelDataInReg;            // input of the memory from the sobel module
-  always @(posedge clock) s_sobelDataInReg <= s_sobelDataIn;   
-  // start address for the sobel filtering, it is either 0 or 238, the opposite of the start address of the dma, to allow the ping pong buffer
+  reg [31:0] s_sobelDataInReg;            // result of the last captured group, written by the next SOBEL_WRITE
+  // start address for the sobel filtering, it is either 0 or 238, the opposite of the start address of the dma, to allow the ping pong buffer,
+  // with triple buffering the input and the packed state of the slot
+  reg [1:0] s_sobelSlotReg;
+  reg [10:0] s_sobelStripeLinesReg;        // stripe walk: lines of the stripe filtered, 0 at the start of a stripe
+  wire s_sobelRestart = (s_isMyCi == 1'b1 && valueA[14:9] == 6'b001111) || s_frameStart == 1'b1 ||
+                        (s_dmaCurrentStateReg == IDLE && s_requestChain == 1'b1);
+  // the block continues the one before, the line buffers hold its two halo lines
+  wire s_sobelContinue = (s_stripeWalk == 1'b1 && s_sobelStripeLinesReg != 11'd0) ? 1'b1 : 1'b0;
+  wire [10:0] s_sobelStripeLinesNext = s_sobelStripeLinesReg + {6'd0,s_tileLinesReg};
   wire [9:0] sobelMemoryStartAddress;
-  assign sobelMemoryStartAddress = (s_memoryStartAddressReg==9'd0)? 10'd238 : 10'd0; // start address for the sobel memory allowing the ping pong buffer. 
-  wire [9:0] addressSobel = (s_SobelCurrentStateReg == SOBEL_FILTER) ? addressSobelWrite :
-                              (s_SobelCurrentStateReg==FILL_COMPARISON_BUFFER || (s_SobelCurrentStateReg==FILL_WINDOW && counterSobel==3'd7))? addressSobelComparison :
-                               addressSobelRead;
+  assign sobelMemoryStartAddress = (s_tripleBuffer == 1'b1) ? ((s_sobelSlotReg == 2'd0) ? 10'd0 : (s_sobelSlotReg == 2'd1) ? 10'd238 : 10'd476) :
+                                   (s_memoryStartAddressReg==10'd0)? 10'd238 : 10'd0; // start address for the sobel memory allowing the ping pong buffer. 
+  wire [9:0] s_sobelStateAddress = (s_tripleBuffer == 1'b0) ? 10'd476 : (s_sobelSlotReg == 2'd0) ? 10'd714 : (s_sobelSlotReg == 2'd1) ? 10'd762 : 10'd810;
+  wire s_packedState = s_sobelConfigReg[0];
+  // the read that is issued next completes a group, and needs the state of the previous frame first
+  wire s_sobelCompletesGroup = (s_sobelLinesReg == 2'd2 && s_sobelColumnReg != 5'd0) ? 1'b1 : 1'b0;
+  wire s_sobelNeedsState = s_sobelCompletesGroup & (~s_packedState | (s_sobelGroupReg[1:0] == 2'd0));
+  wire s_sobelCapture = s_sobelGroupDelayReg[1];
+  wire s_sobelWrite = (s_SobelCurrentStateReg == SOBEL_WRITE) ? s_sobelWritePendingReg : 1'b0;
+  wire [31:0] s_lineTop = s_lineBufferTop[s_tileWordsReg];
+  wire [31:0] s_lineMiddle = s_lineBufferMiddle[s_tileWordsReg];
   reg [9:0] addressSobelRead;          // address to read the from the memory and fill the window
   reg [9:0] addressSobelWrite;         // address to write the sobel+movement detection output
-  reg [9:0] addressSobelComparison;   // address to read the pixels of the previous frame, to perform the movement detection
+  wire [9:0] addressSobelComparison = (s_packedState == 1'b1) ? s_sobelStateAddress + {4'd0,s_sobelGroupReg[7:2]} :
+                                                                s_sobelStateAddress + {2'd0,s_sobelGroupReg}; //position where to read the sobel values of the previous iteration
+  wire [9:0] addressSobel = (s_SobelCurrentStateReg == SOBEL_WRITE) ? addressSobelWrite :
+                            (s_SobelCurrentStateReg == SOBEL_COMPARE) ? addressSobelComparison :
+                            (s_SobelCurrentStateReg == SOBEL_PACK) ? s_sobelStateAddress - 10'd1 + {4'd0,counterWindow[7:2]} :
+                             addressSobelRead;
   wire writeEnableSobel;
-  assign writeEnableSobel = (s_SobelCurrentStateReg == SOBEL_FILTER ) ? 1'b1 : 1'b0; // enable the write operation only when the sobel filter is applied
-  assign counter_done = (counterSobel == 3'd7) ? 1'b1 : 1'b0;  // when the window has been filled
-  assign sobel_done = (counterWindow == 8'd223) ? 1'b1 : 1'b0; // when the whole image has been processed
-
-  localparam [1:0] IDLE_SOBEL = 2'd0;                 // idle state
-  localparam [1:0] FILL_WINDOW = 2'd1;              // fill the 3x6 window
-  localparam [1:0] FILL_COMPARISON_BUFFER = 2'd2;  // read the same pixel of the previous frame for movement detection
-  localparam [1:0] SOBEL_FILTER = 2'd3;           // apply the sobel filter for 4 pixels at a time and perform the movement detection
-
-  reg [1:0] s_SobelCurrentStateReg, s_SobelNextState;
-  wire sobelStatusRegister;
-  assign sobelStatusRegister = (s_SobelCurrentStateReg == IDLE_SOBEL) ? 1'b0 : 1'b1; // to wait for the end of the sobel filter
+  assign writeEnableSobel = (s_sobelWrite == 1'b1 || s_SobelCurrentStateReg == SOBEL_PACK) ? 1'b1 : 1'b0;
+  reg [31:0] s_packedStateReg;            // packed movement state of the last 4 groups
+  wire [31:0] s_sobelMemoryDataIn = (s_SobelCurrentStateReg == SOBEL_PACK) ? s_packedStateReg : s_sobelDataInReg;
+  // bits [7:6] of the 4 movement values, the packed movement state of the group that is written
+  reg [7:0] s_sobelPackedCodes;
   integer i;
-  reg[31:0] comparisonBuffer;  // buffer to store the values of the previous frame
+  // values of the previous frame of the captured group
+  wire [7:0] s_packedComparison = (s_sobelCaptureGroupReg == 2'd0) ? s_comparisonReg[7:0] :
+                                  (s_sobelCaptureGroupReg == 2'd1) ? s_comparisonReg[15:8] :
+                                  (s_sobelCaptureGroupReg == 2'd2) ? s_comparisonReg[23:16] : s_comparisonReg[31:24];
+  wire [31:0] comparisonBuffer = (s_packedState == 1'b0) ? s_comparisonReg :
+                                 {s_packedComparison[7:6],6'd0,s_packedComparison[5:4],6'd0,s_packedComparison[3:2],6'd0,s_packedComparison[1:0],6'd0};
+
+  // the state after a write: the next read, or once all words are read the remaining groups
+  wire [2:0] s_sobelNextIssue = (s_sobelReadsLeftReg != 10'd0) ? ((s_sobelNeedsState == 1'b1) ? SOBEL_COMPARE : SOBEL_READ) :
+                                ((s_sobelWritePendingReg == 1'b1 && s_sobelWrite == 1'b0) || s_sobelCapture == 1'b1) ? SOBEL_WRITE :
+                                (s_sobelGroupDelayReg[0] == 1'b1) ? SOBEL_DRAIN : IDLE_SOBEL;
 
   // SOBEL state machine
  always @* 
     case (s_SobelCurrentStateReg)
-      IDLE_SOBEL       : s_SobelNextState <= (s_isMyCiSobel) ? FILL_WINDOW : IDLE_SOBEL;
-      FILL_WINDOW      : s_SobelNextState  <= (counter_done) ? FILL_COMPARISON_BUFFER : FILL_WINDOW;
-      FILL_COMPARISON_BUFFER : s_SobelNextState  <=  SOBEL_FILTER;
-      SOBEL_FILTER     : s_SobelNextState  <=  (sobel_done) ? IDLE_SOBEL  : FILL_WINDOW;
-      default          : s_SobelNextState  <= IDLE_SOBEL;
+      IDLE_SOBEL       : s_SobelNextState <= (s_startSobelReg) ? SOBEL_READ : IDLE_SOBEL;
+      SOBEL_READ       : s_SobelNextState <= SOBEL_WRITE;
+      SOBEL_WRITE      : s_SobelNextState <= (s_sobelWrite == 1'b1 && s_packedState == 1'b1 && counterWindow[1:0] == 2'd3) ? SOBEL_PACK : s_sobelNextIssue;
+      SOBEL_COMPARE    : s_SobelNextState <= SOBEL_READ;
+      default          : s_SobelNextState <= s_sobelNextIssue;
     endcase
 
+  assign sobel_done = (s_SobelCurrentStateReg != IDLE_SOBEL && s_SobelNextState == IDLE_SOBEL) ? 1'b1 : 1'b0;
+
 always @(posedge clock)
     begin
       s_SobelCurrentStateReg <= (reset==1'b1) ? IDLE_SOBEL : s_SobelNextState;
+      // the next slot once a tile is done
+      s_sobelSlotReg         <= (reset == 1'b1 || s_sobelRestart == 1'b1) ? 2'd0 :
+                                (sobel_done == 1'b1) ? ((s_sobelSlotReg == 2'd2) ? 2'd0 : s_sobelSlotReg + 2'd1) : s_sobelSlotReg;
+      // the next stripe starts once the tile at the bottom of the frame is done
+      s_sobelStripeLinesReg  <= (reset == 1'b1 || s_sobelRestart == 1'b1) ? 11'd0 :
+                                (sobel_done == 1'b1 && s_stripeWalk == 1'b1) ? ((s_sobelStripeLinesNext >= s_frameHeightReg) ? 11'd0 : s_sobelStripeLinesNext) :
+                                s_sobelStripeLinesReg;
     end
 
 always @(posedge clock)
 begin
+    s_sobelReadsLeftReg <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? ((s_sobelContinue == 1'b1) ? s_tileStripeInputWords : s_tileInputWords) :
+                           (s_SobelCurrentStateReg == SOBEL_READ) ? s_sobelReadsLeftReg - 10'd1 : s_sobelReadsLeftReg;
+    s_sobelColumnReg <= (s_SobelCurrentStateReg == IDLE_SOBEL || 
+                         (s_SobelCurrentStateReg == SOBEL_READ && s_sobelColumnReg == s_tileWordsReg)) ? 5'd0 :
+                        (s_SobelCurrentStateReg == SOBEL_READ) ? s_sobelColumnReg + 5'd1 : s_sobelColumnReg;
+    s_sobelLinesReg <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? ((s_sobelContinue == 1'b1) ? 2'd2 : 2'd0) :
+                       (s_SobelCurrentStateReg == SOBEL_READ && s_sobelColumnReg == s_tileWordsReg && s_sobelLinesReg != 2'd2) ? s_sobelLinesReg + 2'd1 : s_sobelLinesReg;
+    s_sobelGroupReg <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 8'd0 :
+                       (s_SobelCurrentStateReg == SOBEL_READ && s_sobelCompletesGroup == 1'b1) ? s_sobelGroupReg + 8'd1 : s_sobelGroupReg;
+    s_sobelGroupDelayReg <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 2'd0 :
+                            {s_sobelGroupDelayReg[0], (s_SobelCurrentStateReg == SOBEL_READ) ? s_sobelCompletesGroup : 1'b0};
+    s_sobelReadDelayReg <= (s_SobelCurrentStateReg == SOBEL_READ) ? 1'b1 : 1'b0;
+    s_sobelCompareDelayReg <= (s_SobelCurrentStateReg == SOBEL_COMPARE) ? 1'b1 : 1'b0;
+    s_sobelCaptureGroupReg <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 2'd0 :
+                              (s_sobelCapture == 1'b1) ? s_sobelCaptureGroupReg + 2'd1 : s_sobelCaptureGroupReg;
+    s_sobelWritePendingReg <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 1'b0 :
+                              (s_sobelCapture == 1'b1) ? 1'b1 : (s_sobelWrite == 1'b1) ? 1'b0 : s_sobelWritePendingReg;
+    s_sobelDataInReg <= (s_sobelCapture == 1'b1) ? s_sobelDataIn : s_sobelDataInReg;
+    s_sobelPackedCodes <= (s_sobelCapture == 1'b1) ? {sum_3[7:6], sum_2[7:6], sum_1[7:6], sum_0[7:6]} : s_sobelPackedCodes;
+    s_comparisonReg <= (s_sobelCompareDelayReg == 1'b1) ? s_sobelDataOut : s_comparisonReg;
     counterWindow <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 8'd0 : 
-                     (s_SobelCurrentStateReg == SOBEL_FILTER) ? counterWindow + 1 : counterWindow;
-    initialCounterWord <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? sobelMemoryStartAddress:
-                      (counterSobel==3'd5)? ((counterWindow[3:0] == 4'd15) ? initialCounterWord + 9'd2 :
-                      initialCounterWord + 9'd1) : initialCounterWord;
-    addressSobelRead <= (s_SobelCurrentStateReg == SOBEL_FILTER || s_SobelCurrentStateReg == IDLE_SOBEL)? {1'b0,initialCounterWord}:
-                      (s_SobelCurrentStateReg == FILL_WINDOW)? 
-                      ((counterSobel == 3'd1 || counterSobel == 3'd3) ? addressSobelRead + 10'd16 :(counterSobel > 4) ? addressSobelRead :addressSobelRead + 10'd1) :
-                       addressSobelRead;
-    addressSobelComparison <= addressSobelWrite + 10'd239 + {1'b0,s_memoryStartAddressReg}; //position where to read the sobel values of the previous iteration
+                     (s_sobelWrite == 1'b1) ? counterWindow + 8'd1 : counterWindow;
+    addressSobelRead <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? sobelMemoryStartAddress :
+                        (s_SobelCurrentStateReg == SOBEL_READ) ? addressSobelRead + 10'd1 : addressSobelRead;
     addressSobelWrite <= (s_SobelCurrentStateReg == IDLE_SOBEL)? sobelMemoryStartAddress :
-                     (s_SobelCurrentStateReg == SOBEL_FILTER)? addressSobelWrite+1 : addressSobelWrite;
-    comparisonBuffer <=(reset==1'b1)? 32'b0 : ( (s_SobelCurrentStateReg == FILL_COMPARISON_BUFFER) ? s_sobelDataOut : comparisonBuffer);                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                          
-    if(s_SobelCurrentStateReg == IDLE_SOBEL)begin
-                      for (i=0; i<18; i=i+1)begin
-                             window[i] <= 8'd0 ;
-                      end
-    end
-    if(counterSobel != 3'd7 && counterSobel!=3'd0 )begin
-      window[windowIndex] <= (s_SobelCurrentStateReg == FILL_WINDOW) ? s_sobelDataOut[7:0] : window[windowIndex];
-      window[windowIndex+1] <= (s_SobelCurrentStateReg == FILL_WINDOW) ? s_sobelDataOut[15:8] : window[windowIndex+1];
-      window[windowIndex+2] <= (s_SobelCurrentStateReg == FILL_WINDOW && (windowIndex==5'd0 || windowIndex==5'd12 || windowIndex==5'd6 ) ) ? s_sobelDataOut[23:16] : window[windowIndex+2];
-      window[windowIndex+3] <= (s_SobelCurrentStateReg == FILL_WINDOW && (windowIndex==5'd0 || windowIndex==5'd12 || windowIndex==5'd6 ) ) ? s_sobelDataOut[31:24] : window[windowIndex+3];
-    end
-    else begin
-      window[windowIndex] <= window[windowIndex];
-      window[windowIndex+1] <= window[windowIndex+1];
-      window[windowIndex+2] <= window[windowIndex+2];
-      window[windowIndex+3] <= window[windowIndex+3];
+                         (s_sobelWrite == 1'b1)? addressSobelWrite+10'd1 : addressSobelWrite;
+    s_packedStateReg[7:0]   <= (s_sobelWrite == 1'b1 && counterWindow[1:0] == 2'd0) ? s_sobelPackedCodes : s_packedStateReg[7:0];
+    s_packedStateReg[15:8]  <= (s_sobelWrite == 1'b1 && counterWindow[1:0] == 2'd1) ? s_sobelPackedCodes : s_packedStateReg[15:8];
+    s_packedStateReg[23:16] <= (s_sobelWrite == 1'b1 && counterWindow[1:0] == 2'd2) ? s_sobelPackedCodes : s_packedStateReg[23:16];
+    s_packedStateReg[31:24] <= (s_sobelWrite == 1'b1 && counterWindow[1:0] == 2'd3) ? s_sobelPackedCodes : s_packedStateReg[31:24];
+    // the word read in the last cycle is the bottom of the new column, the line buffers give the same word of the two lines above
+    if (s_sobelReadDelayReg == 1'b1) begin
+      s_lineBufferMiddle[0] <= s_sobelDataOut;
+      s_lineBufferTop[0]    <= s_lineMiddle;
+      for (i=1; i<17; i=i+1) begin
+        s_lineBufferMiddle[i] <= s_lineBufferMiddle[i-1];
+        s_lineBufferTop[i]    <= s_lineBufferTop[i-1];
+      end
+      s_columnTopReg    <= s_lineTop;
+      s_columnMiddleReg <= s_lineMiddle;
+      s_columnBottomReg <= s_sobelDataOut;
+      for (i=0; i<4; i=i+1) begin
+        window[i]    <= s_columnTopReg[i*8 +: 8];
+        window[i+6]  <= s_columnMiddleReg[i*8 +: 8];
+        window[i+12] <= s_columnBottomReg[i*8 +: 8];
+      end
+      for (i=0; i<2; i=i+1) begin
+        window[i+4]  <= s_lineTop[i*8 +: 8];
+        window[i+10] <= s_lineMiddle[i*8 +: 8];
+        window[i+16] <= s_sobelDataOut[i*8 +: 8];
+      end
     end
-    counterSobel <= (s_SobelCurrentStateReg == FILL_WINDOW) ? counterSobel + 1 : 3'd0; 
 end
 
 /// Calculate Gx for 4 pixels
-wire signed [9:0] Gx_0 = window[0] - window[2] + ((window[6]<<1)) - ((window[8])<<<1) + window[12] - window[14];
-wire signed [9:0] Gx_1 = window[1] - window[3] + ((window[7]<<1)) - ((window[9])<<<1) + window[13] - window[15];
-wire signed [9:0] Gx_2 = window[2] - window[4] + ((window[8]<<1)) - ((window[10])<<<1) + window[14] - window[16];
-wire signed [9:0] Gx_3 = window[3] - window[5] + ((window[9]<<1)) - ((window[11])<<<1) + window[15] - window[17];
+wire signed [10:0] Gx_0 = window[0] - window[2] + ((window[6]<<1)) - ((window[8])<<<1) + window[12] - window[14];
+wire signed [10:0] Gx_1 = window[1] - window[3] + ((window[7]<<1)) - ((window[9])<<<1) + window[13] - window[15];
+wire signed [10:0] Gx_2 = window[2] - window[4] + ((window[8]<<1)) - ((window[10])<<<1) + window[14] - window[16];
+wire signed [10:0] Gx_3 = window[3] - window[5] + ((window[9]<<1)) - ((window[11])<<<1) + window[15] - window[17];
 
 // Calculate Gy for 4 pixels
-wire signed [9:0] Gy_0 = window[12] + (window[13]<<<1) + window[14] - (window[0] + (window[1]<<1) + window[2]);
-wire signed [9:0] Gy_1 = window[13] + (window[14]<<<1) + window[15] - (window[1] + (window[2]<<1) + window[3]);
-wire signed [9:0] Gy_2 = window[14] + (window[15]<<<1) + window[16] - (window[2] + (window[3]<<1) + window[4]);
-wire signed [9:0] Gy_3 = window[15] + (window[16]<<<1) + window[17] - (window[3] + (window[4]<<1) + window[5]);
+wire signed [10:0] Gy_0 = window[12] + (window[13]<<<1) + window[14] - (window[0] + (window[1]<<1) + window[2]);
+wire signed [10:0] Gy_1 = window[13] + (window[14]<<<1) + window[15] - (window[1] + (window[2]<<1) + window[3]);
+wire signed [10:0] Gy_2 = window[14] + (window[15]<<<1) + window[16] - (window[2] + (window[3]<<1) + window[4]);
+wire signed [10:0] Gy_3 = window[15] + (window[16]<<<1) + window[17] - (window[3] + (window[4]<<1) + window[5]);
 
 // Compute absolute values of Gx and Gy
-wire [9:0] abs_Gx_0 = (Gx_0 < 0) ? -Gx_0 : Gx_0;
-wire [9:0] abs_Gx_1 = (Gx_1 < 0) ? -Gx_1 : Gx_1;
-wire [9:0] abs_Gx_2 = (Gx_2 < 0) ? -Gx_2 : Gx_2;
-wire [9:0] abs_Gx_3 = (Gx_3 < 0) ? -Gx_3 : Gx_3;
+wire [10:0] abs_Gx_0 = (Gx_0 < 0) ? -Gx_0 : Gx_0;
+wire [10:0] abs_Gx_1 = (Gx_1 < 0) ? -Gx_1 : Gx_1;
+wire [10:0] abs_Gx_2 = (Gx_2 < 0) ? -Gx_2 : Gx_2;
+wire [10:0] abs_Gx_3 = (Gx_3 < 0) ? -Gx_3 : Gx_3;
 
-wire [9:0] abs_Gy_0 = (Gy_0 < 0) ? -Gy_0 : Gy_0;     
-wire [9:0] abs_Gy_1 = (Gy_1 < 0) ? -Gy_1 : Gy_1;
-wire [9:0] abs_Gy_2 = (Gy_2 < 0) ? -Gy_2 : Gy_2;
-wire [9:0] abs_Gy_3 = (Gy_3 < 0) ? -Gy_3 : Gy_3;
+wire [10:0] abs_Gy_0 = (Gy_0 < 0) ? -Gy_0 : Gy_0;     
+wire [10:0] abs_Gy_1 = (Gy_1 < 0) ? -Gy_1 : Gy_1;
+wire [10:0] abs_Gy_2 = (Gy_2 < 0) ? -Gy_2 : Gy_2;
+wire [10:0] abs_Gy_3 = (Gy_3 < 0) ? -Gy_3 : Gy_3;
 
 // Sum the absolute values to get the gradient magnitude
-wire [7:0] sum_0 =  (abs_Gx_0 + abs_Gy_0 < {2'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[7]==comparisonBuffer[6])?  8'd0 : 8'd255) ;
-wire [7:0] sum_1 =  (abs_Gx_1 + abs_Gy_1 < {2'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[15]==comparisonBuffer[14])?  8'd0 : 8'd255) ;
-wire [7:0] sum_2 =  (abs_Gx_2 + abs_Gy_2 < {2'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[23]==comparisonBuffer[22])?  8'd0 : 8'd255) ;
-wire [7:0] sum_3 =  (abs_Gx_3 + abs_Gy_3 < {2'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[31]==comparisonBuffer[30])?  8'd0 : 8'd255) ;
+wire [7:0] sum_0 =  (abs_Gx_0 + abs_Gy_0 < {3'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[7]==comparisonBuffer[6])?  8'd0 : 8'd255) ;
+wire [7:0] sum_1 =  (abs_Gx_1 + abs_Gy_1 < {3'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[15]==comparisonBuffer[14])?  8'd0 : 8'd255) ;
+wire [7:0] sum_2 =  (abs_Gx_2 + abs_Gy_2 < {3'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[23]==comparisonBuffer[22])?  8'd0 : 8'd255) ;
+wire [7:0] sum_3 =  (abs_Gx_3 + abs_Gy_3 < {3'd0, s_sobelTresholdReg}) ? 8'd127 : ((comparisonBuffer[31]==comparisonBuffer[30])?  8'd0 : 8'd255) ;
+
+// Gradient magnitudes, saturated to 8 bits
+wire [10:0] magnitude_0 = abs_Gx_0 + abs_Gy_0;
+wire [10:0] magnitude_1 = abs_Gx_1 + abs_Gy_1;
+wire [10:0] magnitude_2 = abs_Gx_2 + abs_Gy_2;
+wire [10:0] magnitude_3 = abs_Gx_3 + abs_Gy_3;
+wire [31:0] s_magnitudes = {(magnitude_3[10:8] != 3'd0) ? 8'd255 : magnitude_3[7:0], (magnitude_2[10:8] != 3'd0) ? 8'd255 : magnitude_2[7:0],
+                            (magnitude_1[10:8] != 3'd0) ? 8'd255 : magnitude_1[7:0], (magnitude_0[10:8] != 3'd0) ? 8'd255 : magnitude_0[7:0]};
 
 // Combine the results into the output bus
-assign s_sobelDataIn = {sum_3, sum_2, sum_1, sum_0};
+assign s_sobelDataIn = (s_magnitudeOutput == 1'b1) ? s_magnitudes : {sum_3, sum_2, sum_1, sum_0};
+
+/*
+ *
+ * Here we define the histogram of the gradient magnitudes: 256 bins counting the saturated magnitude of every pixel
+ * the filter computes. Every pixel of a group has its own bank, that reads the bin when the group is captured and
+ * writes it back incremented in the next cycle. Reading a bin (valueA[7:0]) returns the sum of the 4 banks and clears
+ * it, so reading all bins after a frame leaves the histogram empty for the next one; the clear command empties all
+ * bins in 256 cycles (bit 0 of the histogram status). The filter has to be idle for both.
+ *
+ */
+reg        s_histogramIncrementReg, s_histogramReadReg;
+reg  [7:0] s_histogramReadBinReg;
+reg  [8:0] s_histogramClearReg;           // bin that is cleared next, bit 8 set when no clear is running
+wire       s_histogramClearing = ~s_histogramClearReg[8];
+wire       s_histogramRead = (s_isSramRead == 1'b1 && valueA[14:10] == 5'b10010) ? 1'b1 : 1'b0;
+wire [31:0] s_histogramCounts [3:0];
+reg  [31:0] s_histogramResult;
+
+always @(posedge clock)
+  begin
+    s_histogramIncrementReg <= (reset == 1'b1) ? 1'b0 : s_sobelCapture;
+    s_histogramReadReg      <= (reset == 1'b1) ? 1'b0 : s_histogramRead;
+    s_histogramReadBinReg   <= valueA[7:0];
+    s_histogramClearReg     <= (reset == 1'b1) ? 9'h100 :
+                               (s_isMyCi == 1'b1 && valueA[14:9] == 6'b100101) ? 9'd0 :
+                               (s_histogramClearing == 1'b1) ? s_histogramClearReg + 9'd1 : s_histogramClearReg;
+  end
+
+genvar bank;
+generate
+  for (bank = 0 ; bank < 4 ; bank = bank + 1)
+    begin : histogram
+      reg  [7:0]  s_binReg;
+      wire [7:0]  s_bin = s_magnitudes[bank*8 +: 8];
+      wire [31:0] s_count;
+      always @(posedge clock) s_binReg <= s_bin;
+      dualPortSSRAM #( .bitwidth(32),
+                       .nrOfEntries(256)) counts
+                     ( .clockA(clock),
+                       .clockB(clock),
+                       .writeEnableA(s_histogramIncrementReg),
+                       .writeEnableB(s_histogramReadReg | s_histogramClearing),
+                       .addressA((s_histogramIncrementReg == 1'b1) ? s_binReg : s_bin),
+                       .addressB((s_histogramClearing == 1'b1) ? s_histogramClearReg[7:0] :
+                                 (s_histogramReadReg == 1'b1) ? s_histogramReadBinReg : valueA[7:0]),
+                       .dataInA(s_count + 32'd1),
+                       .dataInB(32'd0),
+                       .dataOutA(s_count),
+                       .dataOutB(s_histogramCounts[bank]));
+    end
+endgenerate
+
+always @* s_histogramResult <= s_histogramCounts[0] + s_histogramCounts[1] + s_histogramCounts[2] + s_histogramCounts[3];
+
+/*
+ *
+ * Here we define the tile summaries: the filter counts the edge pixels (movement value 0 or 255) and the moved pixels
+ * (255) of a tile and writes {edges, moved} in the next entry of a 512 entry summary memory once the tile is done.
+ * The entries restart at 0 with the sobel filter slot and with every write of the summary address; the summaries of
+ * tiles beyond the 512th are dropped and set the overflow flag, bit 31 of the entry count. They are read with a custom
+ * instruction (valueA[8:0] the entry) and, in frame mode with a summary address, written to it by the dma after the
+ * last tile.
+ *
+ */
+reg  [15:0] s_tileEdgesReg, s_tileMovedReg;
+reg         s_summaryOverflowReg;
+wire [3:0]  s_groupEdges = {sum_3[7:6] != 2'b01, sum_2[7:6] != 2'b01, sum_1[7:6] != 2'b01, sum_0[7:6] != 2'b01};
+wire [3:0]  s_groupMoved = {sum_3[7:6] == 2'b11, sum_2[7:6] == 2'b11, sum_1[7:6] == 2'b11, sum_0[7:6] == 2'b11};
+wire [2:0]  s_groupEdgeCount = {2'd0,s_groupEdges[0]} + {2'd0,s_groupEdges[1]} + {2'd0,s_groupEdges[2]} + {2'd0,s_groupEdges[3]};
+wire [2:0]  s_groupMovedCount = {2'd0,s_groupMoved[0]} + {2'd0,s_groupMoved[1]} + {2'd0,s_groupMoved[2]} + {2'd0,s_groupMoved[3]};
+wire [31:0] s_summaryBusData, s_summaryCiData;
+
+always @(posedge clock)
+  begin
+    s_tileEdgesReg      <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 16'd0 :
+                           (s_sobelCapture == 1'b1) ? s_tileEdgesReg + {13'd0,s_groupEdgeCount} : s_tileEdgesReg;
+    s_tileMovedReg      <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 16'd0 :
+                           (s_sobelCapture == 1'b1) ? s_tileMovedReg + {13'd0,s_groupMovedCount} : s_tileMovedReg;
+    s_summaryEntriesReg <= (reset == 1'b1 || s_sobelRestart == 1'b1 || (s_isMyCi == 1'b1 && valueA[14:9] == 6'b100111)) ? 10'd0 :
+                           (sobel_done == 1'b1 && s_summaryEntriesReg != 10'd512) ? s_summaryEntriesReg + 10'd1 : s_summaryEntriesReg;
+    s_summaryOverflowReg <= (reset == 1'b1 || s_sobelRestart == 1'b1 || (s_isMyCi == 1'b1 && valueA[14:9] == 6'b100111)) ? 1'b0 :
+                            (sobel_done == 1'b1 && s_summaryEntriesReg == 10'd512) ? 1'b1 : s_summaryOverflowReg;
+  end
+
+// port A is written by the filter and read by the custom instruction, port B is read by the dma like the ci memory.
+// The write of a summary takes port A for the single cycle of sobel_done, a ci read in that cycle presents its entry
+// (valueA stays valid until done) in the next one and gets done a cycle later.
+wire s_summaryReadCollision = (s_isSramRead == 1'b1 && valueA[14:10] == 5'b10100) ? sobel_done : 1'b0;
+reg  s_summaryReadRetryReg;
+
+always @(posedge clock) s_summaryReadRetryReg <= ~reset & s_summaryReadCollision;
+
+dualPortSSRAM #( .bitwidth(32),
+                 .nrOfEntries(512)) summary
+               ( .clockA(clock),
+                 .clockB(~clock),
+                 .writeEnableA(sobel_done & ~s_summaryEntriesReg[9]),
+                 .writeEnableB(1'b0),
+                 .addressA((sobel_done == 1'b1) ? s_summaryEntriesReg[8:0] : valueA[8:0]),
+                 .addressB(s_ramCiAddressReg[8:0]),
+                 .dataInA({s_tileEdgesReg,s_tileMovedReg}),
+                 .dataInB(32'd0),
+                 .dataOutA(s_summaryCiData),
+                 .dataOutB(s_summaryBusData));
+
+/*
+ *
+ * Here we define the motion boxes: the smallest rectangles {min x, max x, min y, max y} that hold all moved pixels
+ * (movement value 255) of the frame, box 0, and of the pixels inside each of the 4 zones, boxes 1 to 4. The
+ * coordinates are the ones of the pixels in the frame, the filter follows the origin of its tiles with the walk of
+ * the frame (row by row, or stripe by stripe with the stripe walk) using the frame width and height registers. A zone
+ * is set with {max x, min x} (valueA[0] = 0) or {max y, min y} (valueA[0] = 1) in bits [26:16] and [10:0], a zone with
+ * min > max is disabled. The boxes are read the same way (valueA[3:1] the box) and are empty (min 2047, max 0) after a
+ * restart of the filter or a clear command.
+ *
+ */
+reg  [4:0]  s_boxWordReg, s_boxLineReg;   // position in the tile of the group that is captured next
+reg  [10:0] s_boxTileXReg, s_boxTileYReg; // origin of the input block of the tile (row walk)
+reg  [21:0] s_zoneXReg [3:0];
+reg  [21:0] s_zoneYReg [3:0];
+wire [21:0] s_boxX [4:0];
+wire [21:0] s_boxY [4:0];
+wire [10:0] s_boxTileY = (s_stripeWalk == 1'b1) ? s_sobelStripeLinesReg : s_boxTileYReg;
+wire        s_boxRowEnd = ({1'b0,s_boxTileXReg} + {s_tilePixels,1'b0} > {1'b0,s_frameWidthReg}) ? 1'b1 : 1'b0;
+wire [10:0] s_boxGroupX = s_boxTileXReg + {4'd0,s_boxWordReg,2'd0} + 11'd1;
+wire [10:0] s_boxGroupY = s_boxTileY + {6'd0,s_boxLineReg} + 11'd1;
+wire [10:0] s_boxTileYNext = s_boxTileYReg + {6'd0,s_tileLinesReg};
+wire        s_boxClear = (reset == 1'b1 || s_sobelRestart == 1'b1 || (s_isMyCi == 1'b1 && valueA[14:9] == 6'b101011)) ? 1'b1 : 1'b0;
+wire [21:0] s_boxResult = (valueA[0] == 1'b1) ? s_boxY[valueA[3:1]] : s_boxX[valueA[3:1]];
+integer zone;
+
+always @(posedge clock)
+  begin
+    s_boxWordReg  <= (s_SobelCurrentStateReg == IDLE_SOBEL || (s_sobelCapture == 1'b1 && s_boxWordReg == s_tileWordsReg - 5'd1)) ? 5'd0 :
+                     (s_sobelCapture == 1'b1) ? s_boxWordReg + 5'd1 : s_boxWordReg;
+    s_boxLineReg  <= (s_SobelCurrentStateReg == IDLE_SOBEL) ? 5'd0 :
+                     (s_sobelCapture == 1'b1 && s_boxWordReg == s_tileWordsReg - 5'd1) ? s_boxLineReg + 5'd1 : s_boxLineReg;
+    // the next tile is the one to the right, the first of the next row or of the next stripe
+    s_boxTileXReg <= (reset == 1'b1 || s_sobelRestart == 1'b1) ? 11'd0 :
+                     (sobel_done == 1'b1 && s_stripeWalk == 1'b1) ? ((s_sobelStripeLinesNext >= s_frameHeightReg) ? s_boxTileXReg + s_tilePixels : s_boxTileXReg) :
+                     (sobel_done == 1'b1) ? ((s_boxRowEnd == 1'b1) ? 11'd0 : s_boxTileXReg + s_tilePixels) : s_boxTileXReg;
+    s_boxTileYReg <= (reset == 1'b1 || s_sobelRestart == 1'b1) ? 11'd0 :
+                     (sobel_done == 1'b1 && s_stripeWalk == 1'b0 && s_boxRowEnd == 1'b1) ? ((s_boxTileYNext >= s_frameHeightReg) ? 11'd0 : s_boxTileYNext) : s_boxTileYReg;
+    for (zone = 0 ; zone < 4 ; zone = zone + 1)
+      begin
+        s_zoneXReg[zone] <= (reset == 1'b1) ? {11'd0,11'h7FF} :
+                            (s_isMyCi == 1'b1 && valueA[14:9] == 6'b101001 && valueA[2:1] == zone && valueA[0] == 1'b0) ? {valueB[26:16],valueB[10:0]} : s_zoneXReg[zone];
+        s_zoneYReg[zone] <= (reset == 1'b1) ? {11'd0,11'h7FF} :
+                            (s_isMyCi == 1'b1 && valueA[14:9] == 6'b101001 && valueA[2:1] == zone && valueA[0] == 1'b1) ? {valueB[26:16],valueB[10:0]} : s_zoneYReg[zone];
+      end
+  end
+
+genvar box;
+generate
+  for (box = 0 ; box < 5 ; box = box + 1)
+    begin : motionBox
+      reg  [10:0] s_minXReg, s_maxXReg, s_minYReg, s_maxYReg;
+      // box 0 covers the whole frame
+      wire [21:0] s_rangeX = (box == 0) ? {11'h7FF,11'd0} : s_zoneXReg[(box == 0) ? 0 : box-1];
+      wire [21:0] s_rangeY = (box == 0) ? {11'h7FF,11'd0} : s_zoneYReg[(box == 0) ? 0 : box-1];
+      wire        s_lineInside = (s_boxGroupY >= s_rangeY[10:0] && s_boxGroupY <= s_rangeY[21:11]) ? 1'b1 : 1'b0;
+      wire [3:0]  s_moved;
+      wire [1:0]  s_first = (s_moved[0] == 1'b1) ? 2'd0 : (s_moved[1] == 1'b1) ? 2'd1 : (s_moved[2] == 1'b1) ? 2'd2 : 2'd3;
+      wire [1:0]  s_last = (s_moved[3] == 1'b1) ? 2'd3 : (s_moved[2] == 1'b1) ? 2'd2 : (s_moved[1] == 1'b1) ? 2'd1 : 2'd0;
+      wire [10:0] s_firstX = s_boxGroupX + {9'd0,s_first};
+      wire [10:0] s_lastX = s_boxGroupX + {9'd0,s_last};
+      genvar pixel;
+      for (pixel = 0 ; pixel < 4 ; pixel = pixel + 1)
+        begin : inside
+          wire [10:0] s_x = s_boxGroupX + pixel;
+          assign s_moved[pixel] = (s_groupMoved[pixel] == 1'b1 && s_lineInside == 1'b1 &&
+                                   s_x >= s_rangeX[10:0] && s_x <= s_rangeX[21:11]) ? 1'b1 : 1'b0;
+        end
+      wire        s_update = (s_sobelCapture == 1'b1 && s_moved != 4'd0) ? 1'b1 : 1'b0;
+      always @(posedge clock)
+        begin
+          s_minXReg <= (s_boxClear == 1'b1) ? 11'h7FF : (s_update == 1'b1 && s_firstX < s_minXReg) ? s_firstX : s_minXReg;
+          s_maxXReg <= (s_boxClear == 1'b1) ? 11'd0 : (s_update == 1'b1 && s_lastX > s_maxXReg) ? s_lastX : s_maxXReg;
+          s_minYReg <= (s_boxClear == 1'b1) ? 11'h7FF : (s_update == 1'b1 && s_boxGroupY < s_minYReg) ? s_boxGroupY : s_minYReg;
+          s_maxYReg <= (s_boxClear == 1'b1) ? 11'd0 : (s_update == 1'b1 && s_boxGroupY > s_maxYReg) ? s_boxGroupY : s_maxYReg;
+        end
+      assign s_boxX[box] = {s_maxXReg,s_minXReg};
+      assign s_boxY[box] = {s_maxYReg,s_minYReg};
+    end
+endgenerate
 
 endmodule
 
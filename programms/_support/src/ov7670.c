@@ -360,8 +360,6 @@ void writeRegisterList(const regval_list *list) {
 }
 
 camParameters initOv7670(resolution res) {
-  camParameters result;
-  uint32_t value;
   writeOv7670Register(0x12, 0x80);
   asm volatile ("l.nios_rrc r0,%[in1],r0,0x6"::[in1]"r"(100000)); // wait 100 ms
   writeRegisterList(ov7670_default_regs);
@@ -375,6 +373,13 @@ camParameters initOv7670(resolution res) {
   writeRegisterList(rgb565_ov7670);
   writeOv7670Register(0x11, 0); // 1<<6 for 30FPS, 0 for 15 FPS
   asm volatile ("l.nios_rrc r0,%[in1],r0,0x6"::[in1]"r"(2000000)); // wait 2s
+  return getCameraParameters();
+}
+
+/* the geometry is the one written to memory: the region of interest after decimation */
+camParameters getCameraParameters() {
+  camParameters result;
+  uint32_t value;
   asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(value):[in1]"r"(0));
   result.nrOfPixelsPerLine = (value >> 1);
   asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(result.nrOfLinesPerImage):[in1]"r"(1));
@@ -412,3 +417,114 @@ void disableContinues() {
   asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(6),[in2]"r"(0));
 }
 
+/* from the next frame on the grabber writes the movement image (one byte per pixel) to resultBuffer instead of the
+ * grayscale image; stateBuffer holds the edges of the previous frame, one bit per pixel, and has to be cleared once */
+void enableStreamingSobel(uint32_t resultBuffer, uint32_t stateBuffer, uint32_t threshold) {
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(41),[in2]"r"(resultBuffer));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(42),[in2]"r"(stateBuffer));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(40),[in2]"r"((threshold << 8) | 1));
+}
+
+void disableStreamingSobel() {
+  uint32_t control;
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(control):[in1]"r"(8));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(40),[in2]"r"(control & ~1));
+}
+
+/* continuous grabbing into a ring of 2 or 3 frame buffers (the result buffers with the streaming sobel filter): the
+ * frame after a completed one goes to the next buffer, so the last completed frame can be processed meanwhile.
+ * A frame is only safe from being overwritten for (nrOfBuffers - 1) frame periods after it completes. Only one
+ * output image rotates, so the ring runs CAMERA_FORMAT_BOTH, and CAMERA_FORMAT_RGB565 with the streaming sobel
+ * filter, as CAMERA_FORMAT_GRAY */
+void enableContinuesRing(const uint32_t *framebuffers, uint32_t nrOfBuffers) {
+  for (uint32_t buffer = 0; buffer < nrOfBuffers && buffer < 3; buffer++) {
+    asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(43 + buffer),[in2]"r"(framebuffers[buffer]));
+  }
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(46),[in2]"r"(nrOfBuffers));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(6),[in2]"r"(1));
+}
+
+/* address of the last completed frame, 0 before the first one */
+uint32_t getLastCompletedFrame() {
+  uint32_t result;
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(result):[in1]"r"(15));
+  return result;
+}
+
+/* waits for the next completed frame and returns its address */
+uint32_t waitForCompletedFrame() {
+  uint32_t frames, result;
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(frames):[in1]"r"(16));
+  do {
+    asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(result):[in1]"r"(16));
+  } while (result == frames);
+  return getLastCompletedFrame();
+}
+
+volatile uint32_t cameraIrqLines;
+volatile uint32_t cameraIrqFrames;
+
+/* number of lines of the current frame that are in memory (the movement image lines when streaming) */
+uint32_t getLinesWritten() {
+  uint32_t result;
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(result):[in1]"r"(17));
+  return result;
+}
+
+/* waits until the first nrOfLines lines of a single image are in memory, or the image is complete */
+void waitForLines(uint32_t nrOfLines) {
+  uint32_t done;
+  do {
+    asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(done):[in1]"r"(7));
+  } while (done == 0 && getLinesWritten() < nrOfLines);
+}
+
+/* pending interrupts are dropped; with CAMERA_IRQ_LINES the interrupt is raised every nrOfLines lines of a frame */
+void enableCameraInterrupts(uint32_t mask, uint32_t nrOfLines) {
+  uint32_t enabled;
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(enabled):[in1]"r"(19));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(49),[in2]"r"(mask));
+  if (mask & CAMERA_IRQ_LINES) {
+    asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(48),[in2]"r"(nrOfLines));
+    cameraIrqLines = 0;
+  }
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(47),[in2]"r"(enabled | mask));
+}
+
+void disableCameraInterrupts(uint32_t mask) {
+  uint32_t enabled;
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(enabled):[in1]"r"(19));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(47),[in2]"r"(enabled & ~mask));
+}
+
+/* called by external_interrupt_handler, acknowledges the pending interrupts */
+void cameraInterrupt() {
+  uint32_t pending, enabled;
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(pending):[in1]"r"(18));
+  asm volatile ("l.nios_rrc %[out1],%[in1],r0,0x7":[out1]"=r"(enabled):[in1]"r"(19));
+  pending &= enabled;
+  if (pending == 0) return;
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(49),[in2]"r"(pending));
+  if (pending & CAMERA_IRQ_LINES) cameraIrqLines = getLinesWritten();
+  if (pending & CAMERA_IRQ_FRAME) cameraIrqFrames++;
+}
+
+/* only the pixels x..x+width-1 of the lines y..y+height-1 are grabbed, a width or height of 0 extends the region to the
+ * end of the line or frame; the region is taken over on the next vsync, getCameraParameters reports it a frame later */
+void setRegionOfInterest(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(50),[in2]"r"((y << 16) | x));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(51),[in2]"r"((height << 16) | width));
+}
+
+/* keeps every pixel and line, or every second or fourth of the region of interest (CAMERA_DECIMATE_x) */
+void setDecimation(uint32_t horizontal, uint32_t vertical) {
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(52),[in2]"r"((vertical << 4) | horizontal));
+}
+
+/* from the next frame on the grabber writes the grayscale image (CAMERA_FORMAT_GRAY, 4 pixels per word), the RGB565
+ * image (CAMERA_FORMAT_RGB565, 2 pixels per word) or both (CAMERA_FORMAT_BOTH) to the frame buffer; with both the
+ * RGB565 image goes to colorBuffer and the grayscale image to the frame buffer */
+void setCameraFormat(uint32_t format, uint32_t colorBuffer) {
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(54),[in2]"r"(colorBuffer));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(53),[in2]"r"(format));
+}
@@ -28,10 +28,12 @@ int main () {
   printf("FPS        : %d\n", camParams.framesPerSecond );
   uint32_t grayPixels;
 #ifdef __RGB565__
+  setCameraFormat(CAMERA_FORMAT_RGB565, 0);
   vga[2] = swap_u32(1);
   vga[3] = swap_u32((uint32_t) &rgb565[0]);
   enableContinues((uint32_t) &rgb565[0]);
 #else
+  setCameraFormat(CAMERA_FORMAT_GRAY, 0);
   vga[2] = swap_u32(2);
   vga[3] = swap_u32((uint32_t) &grayscale[0]);
   enableContinues((uint32_t) &grayscale[0]);
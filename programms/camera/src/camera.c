@@ -28,63 +28,34 @@ int main () {
   vga[1] = swap_u32(result);
   printf("PCLK (kHz) : %d\n", camParams.pixelClockInkHz );
   printf("FPS        : %d\n", camParams.framesPerSecond );
+  setCameraFormat(CAMERA_FORMAT_BOTH, (uint32_t) &rgb565[0]); // the camera writes the grayscale image as well
   while(1) {
     vga[2] = swap_u32(1);
     vga[3] = swap_u32((uint32_t) &rgb565[0]);
     asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x6"::[in1]"r"(5000000),[in2]"r"(1)); // set 5 seconds
     asm volatile ("l.nios_rrr %[out1],r0,r0,0x4":[out1]"=r"(reg));
     do {
-      takeSingleImageBlocking((uint32_t) &rgb565[0]);
+      takeSingleImageBlocking((uint32_t) &grayscale[0]);
       asm volatile ("l.nios_rrr %[out1],r0,%[in2],0x6":[out1]"=r"(result):[in2]"r"(3));
     } while (result != 0 || ((reg&0x8) != 0));
     vga[2] = swap_u32(2);
     vga[3] = swap_u32((uint32_t) &grayscale[0]);
     asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x6"::[in1]"r"(5000000),[in2]"r"(1)); // set 5 seconds
     do {
-      takeSingleImageBlocking((uint32_t) &rgb565[0]);
-      for (int line = 0; line < camParams.nrOfLinesPerImage; line++) {
-        for (int pixel = 0; pixel < camParams.nrOfPixelsPerLine; pixel++) {
-          uint16_t rgb = swap_u16(rgb565[line*camParams.nrOfPixelsPerLine+pixel]);
-          uint32_t red1 = ((rgb >> 11) & 0x1F) << 3;
-          uint32_t green1 = ((rgb >> 5) & 0x3F) << 2;
-          uint32_t blue1 = (rgb & 0x1F) << 3;
-          uint32_t gray = ((red1*54+green1*183+blue1*19) >> 8)&0xFF;
-          grayscale[line*camParams.nrOfPixelsPerLine+pixel] = gray;
-        }
-      }
+      takeSingleImageBlocking((uint32_t) &grayscale[0]);
       asm volatile ("l.nios_rrr %[out1],r0,%[in2],0x6":[out1]"=r"(result):[in2]"r"(3));
     } while (result != 0);
     vga[2] = swap_u32(2);
     vga[3] = swap_u32((uint32_t) &floyd[0]);
     asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x6"::[in1]"r"(5000000),[in2]"r"(1)); // set 5 seconds
     do {
-      takeSingleImageBlocking((uint32_t) &rgb565[0]);
-      for (int line = 0; line < camParams.nrOfLinesPerImage; line++) {
-        for (int pixel = 0; pixel < camParams.nrOfPixelsPerLine; pixel++) {
-          uint16_t rgb = swap_u16(rgb565[line*camParams.nrOfPixelsPerLine+pixel]);
-          uint32_t red1 = ((rgb >> 11) & 0x1F) << 3;
-          uint32_t green1 = ((rgb >> 5) & 0x3F) << 2;
-          uint32_t blue1 = (rgb & 0x1F) << 3;
-          uint32_t gray = ((red1*54+green1*183+blue1*19) >> 8)&0xFF;
-          grayscale[line*camParams.nrOfPixelsPerLine+pixel] = gray;
-        }
-      }
+      takeSingleImageBlocking((uint32_t) &grayscale[0]);
       floyd_steinberg(grayscale, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage, floyd, error_array);
       asm volatile ("l.nios_rrr %[out1],r0,%[in2],0x6":[out1]"=r"(result):[in2]"r"(3));
     } while (result != 0);
     asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x6"::[in1]"r"(5000000),[in2]"r"(1)); // set 5 seconds
     do {
-      takeSingleImageBlocking((uint32_t) &rgb565[0]);
-      for (int line = 0; line < camParams.nrOfLinesPerImage; line++) {
-        for (int pixel = 0; pixel < camParams.nrOfPixelsPerLine; pixel++) {
-          uint16_t rgb = swap_u16(rgb565[line*camParams.nrOfPixelsPerLine+pixel]);
-          uint32_t red1 = ((rgb >> 11) & 0x1F) << 3;
-          uint32_t green1 = ((rgb >> 5) & 0x3F) << 2;
-          uint32_t blue1 = (rgb & 0x1F) << 3;
-          uint32_t gray = ((red1*54+green1*183+blue1*19) >> 8)&0xFF;
-          grayscale[line*camParams.nrOfPixelsPerLine+pixel] = gray;
-        }
-      }
+      takeSingleImageBlocking((uint32_t) &grayscale[0]);
       edgeDetection(grayscale,floyd, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage,128);
       asm volatile ("l.nios_rrr %[out1],r0,%[in2],0x6":[out1]"=r"(result):[in2]"r"(3));
     } while (result != 0);
@@ -0,0 +1,179 @@
+/*
+ * band_engine.h
+ *
+ * Band parallel grayscale + Sobel + movement detection for the host build.
+ * A frame is split into horizontal bands, one per thread. Every band converts
+ * its lines plus a one line halo above and below into a private grayscale
+ * buffer, filters it (edgeDetectionSimd) and classifies its own lines in the shared movement map,
+ * so the threads only meet once per frame and no pixel depends on the
+ * partitioning: the result is identical to rgb565_to_grayscale,
+ * edgeDetection and movementDetection on the whole frame.
+ */
+
+#ifndef BAND_ENGINE_H_
+#define BAND_ENGINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <rgb565.h>
+#include <sobel.h>
+#include <sobel_simd.h>
+#include <movement.h>
+
+typedef struct {
+  int32_t firstLine;
+  int32_t nrOfLines;
+  uint8_t *grayscale;       // lines firstLine-1 .. firstLine+nrOfLines, clipped to the frame
+  uint8_t *sobel;           // same lines; the rows and columns on its border stay 0
+} bandEngineBand;
+
+typedef struct bandEngine {
+  int32_t width;
+  int32_t height;
+  int32_t threshold;
+  int32_t nrOfBands;
+  int32_t nrOfThreads;      // running threads, the calling thread included
+  bandEngineBand *bands;
+  pthread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  uint32_t generation;
+  int32_t nrOfBusy;
+  bool stop;
+  bool firstFrame;
+  uint16_t *rgb565;
+  uint8_t *movement;
+} bandEngine;
+
+typedef struct {
+  bandEngine *engine;
+  int32_t bandNr;
+} bandEngineWorker;
+
+static void bandEngineProcessBand(bandEngine *engine, bandEngineBand *band) {
+  int32_t width = engine->width;
+  int32_t top = (band->firstLine > 0) ? band->firstLine - 1 : 0;
+  int32_t bottom = band->firstLine + band->nrOfLines + 1;
+  if (bottom > engine->height) bottom = engine->height;
+  rgb565_to_grayscale(engine->rgb565 + top*width, band->grayscale, (bottom - top) * width);
+  edgeDetectionSimd(band->grayscale, band->sobel, width, bottom - top, engine->threshold);
+  movementDetectionWord(engine->firstFrame, band->sobel + (band->firstLine - top) * width,
+                        engine->movement + band->firstLine * width, width, band->nrOfLines);
+}
+
+static void *bandEngineThread(void *argument) {
+  bandEngineWorker *worker = argument;
+  bandEngine *engine = worker->engine;
+  uint32_t seen = 0;
+  while (1) {
+    pthread_mutex_lock(&engine->lock);
+    while (engine->generation == seen && !engine->stop) pthread_cond_wait(&engine->start, &engine->lock);
+    seen = engine->generation;
+    if (engine->stop) {
+      pthread_mutex_unlock(&engine->lock);
+      break;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    bandEngineProcessBand(engine, &engine->bands[worker->bandNr]);
+    pthread_mutex_lock(&engine->lock);
+    if (--engine->nrOfBusy == 0) pthread_cond_signal(&engine->done);
+    pthread_mutex_unlock(&engine->lock);
+  }
+  free(worker);
+  return NULL;
+}
+
+void bandEngineDestroy(bandEngine *engine) {
+  if (engine == NULL) return;
+  pthread_mutex_lock(&engine->lock);
+  engine->stop = true;
+  pthread_cond_broadcast(&engine->start);
+  pthread_mutex_unlock(&engine->lock);
+  for (int32_t thread = 1; thread < engine->nrOfThreads; thread++) pthread_join(engine->threads[thread], NULL);
+  for (int32_t bandNr = 0; engine->bands != NULL && bandNr < engine->nrOfBands; bandNr++) {
+    free(engine->bands[bandNr].grayscale);
+    free(engine->bands[bandNr].sobel);
+  }
+  pthread_mutex_destroy(&engine->lock);
+  pthread_cond_destroy(&engine->start);
+  pthread_cond_destroy(&engine->done);
+  free(engine->bands);
+  free(engine->threads);
+  free(engine);
+}
+
+/*
+ * Creates an engine for width x height frames with nrOfThreads threads (the
+ * calling thread included), at most one per line. rgb565_init_grayscale()
+ * has to be called once before. Returns NULL when out of resources.
+ */
+bandEngine *bandEngineCreate( int32_t width,
+                              int32_t height,
+                              int32_t threshold,
+                              int32_t nrOfThreads ) {
+  if (width <= 0 || height <= 0 || nrOfThreads <= 0) return NULL;
+  if (nrOfThreads > height) nrOfThreads = height;
+  bandEngine *engine = calloc(1, sizeof(bandEngine));
+  if (engine == NULL) return NULL;
+  engine->width = width;
+  engine->height = height;
+  engine->threshold = threshold;
+  engine->firstFrame = true;
+  engine->nrOfThreads = 1;
+  pthread_mutex_init(&engine->lock, NULL);
+  pthread_cond_init(&engine->start, NULL);
+  pthread_cond_init(&engine->done, NULL);
+  engine->bands = calloc(nrOfThreads, sizeof(bandEngineBand));
+  engine->threads = calloc(nrOfThreads, sizeof(pthread_t));
+  if (engine->bands == NULL || engine->threads == NULL) goto fail;
+  engine->nrOfBands = nrOfThreads;
+  for (int32_t bandNr = 0; bandNr < nrOfThreads; bandNr++) {
+    bandEngineBand *band = &engine->bands[bandNr];
+    band->firstLine = (int32_t) ((int64_t) height * bandNr / nrOfThreads);
+    band->nrOfLines = (int32_t) ((int64_t) height * (bandNr + 1) / nrOfThreads) - band->firstLine;
+    band->grayscale = malloc((size_t) (band->nrOfLines + 2) * width);
+    band->sobel = calloc((size_t) (band->nrOfLines + 2) * width, 1);
+    if (band->grayscale == NULL || band->sobel == NULL) goto fail;
+  }
+  // band 0 is processed by the calling thread
+  for (; engine->nrOfThreads < nrOfThreads; engine->nrOfThreads++) {
+    bandEngineWorker *worker = malloc(sizeof(bandEngineWorker));
+    if (worker == NULL) goto fail;
+    worker->engine = engine;
+    worker->bandNr = engine->nrOfThreads;
+    if (pthread_create(&engine->threads[engine->nrOfThreads], NULL, bandEngineThread, worker) != 0) {
+      free(worker);
+      goto fail;
+    }
+  }
+  return engine;
+fail:
+  bandEngineDestroy(engine);
+  return NULL;
+}
+
+/*
+ * Processes one RGB565 frame; movement holds the map of the previous frame
+ * (127 for the first one) and is replaced by the map of this frame.
+ */
+void bandEngineProcess( bandEngine *engine,
+                        uint16_t *rgb565,
+                        uint8_t *movement ) {
+  pthread_mutex_lock(&engine->lock);
+  engine->rgb565 = rgb565;
+  engine->movement = movement;
+  engine->nrOfBusy = engine->nrOfThreads - 1;
+  engine->generation++;
+  pthread_cond_broadcast(&engine->start);
+  pthread_mutex_unlock(&engine->lock);
+  bandEngineProcessBand(engine, &engine->bands[0]);
+  pthread_mutex_lock(&engine->lock);
+  while (engine->nrOfBusy != 0) pthread_cond_wait(&engine->done, &engine->lock);
+  engine->firstFrame = false;
+  pthread_mutex_unlock(&engine->lock);
+}
+
+#endif /* BAND_ENGINE_H_ */
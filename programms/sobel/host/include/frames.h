@@ -0,0 +1,38 @@
+#ifndef FRAMES_H_INCLUDED
+#define FRAMES_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Frame sequences for the host benchmarks. Frames hold the RGB565 halfwords
+ * as the OR1420 reads them from SDRAM, whatever the source.
+ */
+typedef struct {
+    int32_t width;
+    int32_t height;
+    int32_t nrOfFrames;
+    uint16_t **rgb565;
+} frameSequence;
+
+/*
+ * Appends a binary PGM (P5) file or a raw RGB565 dump of the camera frame
+ * buffer (width x height) to the sequence. Exits on errors.
+ */
+void frames_load(frameSequence *seq, const char *path, int32_t width, int32_t height);
+
+/* a textured background with a bright square sliding over it */
+void frames_make_synthetic(frameSequence *seq, int32_t width, int32_t height, int32_t nrOfFrames);
+
+void frames_write_pgm(const char *path, uint8_t *image, int32_t width, int32_t height);
+
+uint64_t frames_now_in_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAMES_H_INCLUDED */
@@ -0,0 +1,172 @@
+/*
+ * sobel_simd.h
+ *
+ * SSE2 and AVX2 versions of edgeDetection (sobel.h) for the host build.
+ * Every pixel is computed in a 16-bit lane: Gx and Gy are at most 1020 in
+ * magnitude and |Gx|+|Gy| at most 2040, so nothing saturates and the result
+ * is bit exact with edgeDetection. The AVX2 version is selected at run time
+ * when the cpu supports it; on other architectures edgeDetectionSwar is used.
+ */
+
+#ifndef SOBEL_SIMD_H_
+#define SOBEL_SIMD_H_
+
+#include <stdint.h>
+#include <sobel.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SOBEL_SIMD_AVAILABLE 1
+
+/* the scalar formula of edgeDetection for the columns the vectors do not cover */
+static inline uint8_t sobelSimdPixel( const uint8_t *top,
+                                      const uint8_t *middle,
+                                      const uint8_t *bottom,
+                                      int32_t pixel,
+                                      int32_t threshold ) {
+  int32_t valueX = (top[pixel+1] + (middle[pixel+1] << 1) + bottom[pixel+1]) -
+                   (top[pixel-1] + (middle[pixel-1] << 1) + bottom[pixel-1]);
+  int32_t valueY = (top[pixel-1] + (top[pixel] << 1) + top[pixel+1]) -
+                   (bottom[pixel-1] + (bottom[pixel] << 1) + bottom[pixel+1]);
+  int32_t result = (valueX < 0) ? -valueX : valueX;
+  result += (valueY < 0) ? -valueY : valueY;
+  return (result > threshold) ? 0xFF : 0;
+}
+
+/* |Gx|+|Gy| > threshold is clamped into the 16-bit lanes without changing the outcome */
+static inline int16_t sobelSimdThreshold(int32_t threshold) {
+  if (threshold < -1) return -1;
+  if (threshold > 2040) return 2040;
+  return threshold;
+}
+
+static inline __m128i sobelSse2Abs(__m128i value) {
+  return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+}
+
+/* 8 pixels from 16-bit columns: left, center and right neighbours of the three lines */
+static inline __m128i sobelSse2Lanes( __m128i topLeft, __m128i top, __m128i topRight,
+                                      __m128i middleLeft, __m128i middleRight,
+                                      __m128i bottomLeft, __m128i bottom, __m128i bottomRight,
+                                      __m128i threshold ) {
+  __m128i valueX = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(topRight, bottomRight), _mm_slli_epi16(middleRight, 1)),
+                                 _mm_add_epi16(_mm_add_epi16(topLeft, bottomLeft), _mm_slli_epi16(middleLeft, 1)));
+  __m128i valueY = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(topLeft, topRight), _mm_slli_epi16(top, 1)),
+                                 _mm_add_epi16(_mm_add_epi16(bottomLeft, bottomRight), _mm_slli_epi16(bottom, 1)));
+  return _mm_cmpgt_epi16(_mm_add_epi16(sobelSse2Abs(valueX), sobelSse2Abs(valueY)), threshold);
+}
+
+void edgeDetectionSse2( volatile uint8_t *grayscale,
+                        volatile uint8_t *sobelResult,
+                        int32_t width,
+                        int32_t height,
+                        int32_t threshold ) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i thresholds = _mm_set1_epi16(sobelSimdThreshold(threshold));
+  for (int line = 1; line < height - 1; line++) {
+    const uint8_t *top = (const uint8_t *) grayscale + (line-1)*width;
+    const uint8_t *middle = top + width;
+    const uint8_t *bottom = middle + width;
+    uint8_t *result = (uint8_t *) sobelResult + line*width;
+    int pixel = 1;
+    for (; pixel + 16 < width; pixel += 16) {
+      __m128i tl = _mm_loadu_si128((const __m128i *) (top + pixel - 1));
+      __m128i tc = _mm_loadu_si128((const __m128i *) (top + pixel));
+      __m128i tr = _mm_loadu_si128((const __m128i *) (top + pixel + 1));
+      __m128i ml = _mm_loadu_si128((const __m128i *) (middle + pixel - 1));
+      __m128i mr = _mm_loadu_si128((const __m128i *) (middle + pixel + 1));
+      __m128i bl = _mm_loadu_si128((const __m128i *) (bottom + pixel - 1));
+      __m128i bc = _mm_loadu_si128((const __m128i *) (bottom + pixel));
+      __m128i br = _mm_loadu_si128((const __m128i *) (bottom + pixel + 1));
+      __m128i low = sobelSse2Lanes(_mm_unpacklo_epi8(tl, zero), _mm_unpacklo_epi8(tc, zero), _mm_unpacklo_epi8(tr, zero),
+                                   _mm_unpacklo_epi8(ml, zero), _mm_unpacklo_epi8(mr, zero),
+                                   _mm_unpacklo_epi8(bl, zero), _mm_unpacklo_epi8(bc, zero), _mm_unpacklo_epi8(br, zero),
+                                   thresholds);
+      __m128i high = sobelSse2Lanes(_mm_unpackhi_epi8(tl, zero), _mm_unpackhi_epi8(tc, zero), _mm_unpackhi_epi8(tr, zero),
+                                    _mm_unpackhi_epi8(ml, zero), _mm_unpackhi_epi8(mr, zero),
+                                    _mm_unpackhi_epi8(bl, zero), _mm_unpackhi_epi8(bc, zero), _mm_unpackhi_epi8(br, zero),
+                                    thresholds);
+      _mm_storeu_si128((__m128i *) (result + pixel), _mm_packs_epi16(low, high));
+    }
+    for (; pixel < width - 1; pixel++) result[pixel] = sobelSimdPixel(top, middle, bottom, pixel, threshold);
+  }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sobelAvx2Lanes( __m256i topLeft, __m256i top, __m256i topRight,
+                                      __m256i middleLeft, __m256i middleRight,
+                                      __m256i bottomLeft, __m256i bottom, __m256i bottomRight,
+                                      __m256i threshold ) {
+  __m256i valueX = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(topRight, bottomRight), _mm256_slli_epi16(middleRight, 1)),
+                                    _mm256_add_epi16(_mm256_add_epi16(topLeft, bottomLeft), _mm256_slli_epi16(middleLeft, 1)));
+  __m256i valueY = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(topLeft, topRight), _mm256_slli_epi16(top, 1)),
+                                    _mm256_add_epi16(_mm256_add_epi16(bottomLeft, bottomRight), _mm256_slli_epi16(bottom, 1)));
+  return _mm256_cmpgt_epi16(_mm256_add_epi16(_mm256_abs_epi16(valueX), _mm256_abs_epi16(valueY)), threshold);
+}
+
+/* unpack and pack both work per 128-bit lane, so the pixel order is kept */
+__attribute__((target("avx2")))
+void edgeDetectionAvx2( volatile uint8_t *grayscale,
+                        volatile uint8_t *sobelResult,
+                        int32_t width,
+                        int32_t height,
+                        int32_t threshold ) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i thresholds = _mm256_set1_epi16(sobelSimdThreshold(threshold));
+  for (int line = 1; line < height - 1; line++) {
+    const uint8_t *top = (const uint8_t *) grayscale + (line-1)*width;
+    const uint8_t *middle = top + width;
+    const uint8_t *bottom = middle + width;
+    uint8_t *result = (uint8_t *) sobelResult + line*width;
+    int pixel = 1;
+    for (; pixel + 32 < width; pixel += 32) {
+      __m256i tl = _mm256_loadu_si256((const __m256i *) (top + pixel - 1));
+      __m256i tc = _mm256_loadu_si256((const __m256i *) (top + pixel));
+      __m256i tr = _mm256_loadu_si256((const __m256i *) (top + pixel + 1));
+      __m256i ml = _mm256_loadu_si256((const __m256i *) (middle + pixel - 1));
+      __m256i mr = _mm256_loadu_si256((const __m256i *) (middle + pixel + 1));
+      __m256i bl = _mm256_loadu_si256((const __m256i *) (bottom + pixel - 1));
+      __m256i bc = _mm256_loadu_si256((const __m256i *) (bottom + pixel));
+      __m256i br = _mm256_loadu_si256((const __m256i *) (bottom + pixel + 1));
+      __m256i low = sobelAvx2Lanes(_mm256_unpacklo_epi8(tl, zero), _mm256_unpacklo_epi8(tc, zero), _mm256_unpacklo_epi8(tr, zero),
+                                   _mm256_unpacklo_epi8(ml, zero), _mm256_unpacklo_epi8(mr, zero),
+                                   _mm256_unpacklo_epi8(bl, zero), _mm256_unpacklo_epi8(bc, zero), _mm256_unpacklo_epi8(br, zero),
+                                   thresholds);
+      __m256i high = sobelAvx2Lanes(_mm256_unpackhi_epi8(tl, zero), _mm256_unpackhi_epi8(tc, zero), _mm256_unpackhi_epi8(tr, zero),
+                                    _mm256_unpackhi_epi8(ml, zero), _mm256_unpackhi_epi8(mr, zero),
+                                    _mm256_unpackhi_epi8(bl, zero), _mm256_unpackhi_epi8(bc, zero), _mm256_unpackhi_epi8(br, zero),
+                                    thresholds);
+      _mm256_storeu_si256((__m256i *) (result + pixel), _mm256_packs_epi16(low, high));
+    }
+    for (; pixel < width - 1; pixel++) result[pixel] = sobelSimdPixel(top, middle, bottom, pixel, threshold);
+  }
+}
+
+void edgeDetectionSimd( volatile uint8_t *grayscale,
+                        volatile uint8_t *sobelResult,
+                        int32_t width,
+                        int32_t height,
+                        int32_t threshold ) {
+  if (__builtin_cpu_supports("avx2")) {
+    edgeDetectionAvx2(grayscale, sobelResult, width, height, threshold);
+  } else {
+    edgeDetectionSse2(grayscale, sobelResult, width, height, threshold);
+  }
+}
+
+#else
+
+#define SOBEL_SIMD_AVAILABLE 0
+
+void edgeDetectionSimd( volatile uint8_t *grayscale,
+                        volatile uint8_t *sobelResult,
+                        int32_t width,
+                        int32_t height,
+                        int32_t threshold ) {
+  edgeDetectionSwar(grayscale, sobelResult, width, height, threshold, SOBEL_THRESHOLD_SOFTWARE);
+}
+
+#endif
+
+#endif /* SOBEL_SIMD_H_ */
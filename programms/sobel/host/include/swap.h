@@ -0,0 +1,20 @@
+#ifndef SWAP_H_INCLUDED
+#define SWAP_H_INCLUDED
+
+#include <stdint.h>
+
+/*
+ * Host stand-in for the swap-byte custom instruction (ci 0x1). The frame
+ * buffers of the host build hold the halfwords exactly as the big-endian
+ * OR1420 reads them from SDRAM, so the kernels have to swap them the same way.
+ */
+
+static inline uint32_t swap_u32(uint32_t src) {
+    return __builtin_bswap32(src);
+}
+
+static inline uint16_t swap_u16(uint16_t src) {
+    return __builtin_bswap16(src);
+}
+
+#endif /* SWAP_H_INCLUDED */
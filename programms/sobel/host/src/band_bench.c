@@ -0,0 +1,114 @@
+/*
+ * band_bench.c
+ *
+ * Throughput of the band parallel engine (band_engine.h) from 1 to N threads
+ * on a replayed frame sequence. Every run is checked against the single
+ * threaded kernels, frame by frame, through a checksum of the movement maps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "frames.h"
+#include "grayscale.h"
+#include "band_engine.h"
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-W width] [-H height] [-t threshold] [-r repeat] [-s frames] [-T threads] [frame ...]\n"
+          "  frame       binary PGM (P5) file or raw RGB565 camera dump (*.raw, needs -W/-H)\n"
+          "  -W, -H      frame geometry for raw and synthetic frames (default 640x480)\n"
+          "  -t          sobel threshold (default 128, as in edgedetection.c)\n"
+          "  -r          number of passes over the frame sequence (default 4)\n"
+          "  -s          number of synthetic frames when no file is given (default 32)\n"
+          "  -T          highest number of threads (default: online cpus)\n", name);
+  exit(1);
+}
+
+/* FNV-1a, folded over all movement maps */
+static uint32_t checksum(uint32_t hash, uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+int main(int argc, char **argv) {
+  int32_t width = 640, height = 480, threshold = 128, repeat = 4, nrOfSynthetic = 32;
+  int32_t maxThreads = (int32_t) sysconf(_SC_NPROCESSORS_ONLN);
+  frameSequence seq = { 0, 0, 0, NULL };
+  int opt;
+
+  while ((opt = getopt(argc, argv, "W:H:t:r:s:T:")) != -1) {
+    switch (opt) {
+      case 'W': width = atoi(optarg); break;
+      case 'H': height = atoi(optarg); break;
+      case 't': threshold = atoi(optarg); break;
+      case 'r': repeat = atoi(optarg); break;
+      case 's': nrOfSynthetic = atoi(optarg); break;
+      case 'T': maxThreads = atoi(optarg); break;
+      default : usage(argv[0]);
+    }
+  }
+  if (width <= 2 || height <= 2 || repeat <= 0 || nrOfSynthetic <= 0 || maxThreads <= 0) usage(argv[0]);
+  for (int i = optind; i < argc; i++) frames_load(&seq, argv[i], width, height);
+  if (seq.nrOfFrames == 0) frames_make_synthetic(&seq, width, height, nrOfSynthetic);
+
+  size_t nrOfPixels = (size_t) seq.width * seq.height;
+  uint8_t *grayscale = malloc(nrOfPixels);
+  uint8_t *sobel = calloc(nrOfPixels, 1);
+  uint8_t *movement = malloc(nrOfPixels);
+  if (grayscale == NULL || sobel == NULL || movement == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  rgb565_init_grayscale();
+
+  /* the single threaded kernels on the whole frame */
+  uint32_t referenceHash = 2166136261u;
+  memset(movement, 127, nrOfPixels);
+  for (int32_t pass = 0; pass < repeat; pass++) {
+    for (int32_t frameNr = 0; frameNr < seq.nrOfFrames; frameNr++) {
+      rgb565ToGrayscale(seq.rgb565[frameNr], grayscale, seq.width, seq.height);
+      edgeDetection(grayscale, sobel, seq.width, seq.height, threshold);
+      movementDetection(pass == 0 && frameNr == 0, sobel, movement, seq.width, seq.height);
+      referenceHash = checksum(referenceHash, movement, nrOfPixels);
+    }
+  }
+
+  uint64_t nrOfProcessed = (uint64_t) seq.nrOfFrames * repeat;
+  double singleThreadNs = 0;
+  bool identical = true;
+  printf("frames            : %llu (%dx%d, threshold %d)\n", (unsigned long long) nrOfProcessed,
+         seq.width, seq.height, threshold);
+  printf("%-8s %12s %10s %10s %8s  %s\n", "threads", "total ms", "ns/pixel", "frames/s", "speedup", "result");
+  for (int32_t nrOfThreads = 1; nrOfThreads <= maxThreads; nrOfThreads++) {
+    bandEngine *engine = bandEngineCreate(seq.width, seq.height, threshold, nrOfThreads);
+    if (engine == NULL) {
+      fprintf(stderr, "cannot start %d threads\n", nrOfThreads);
+      return 1;
+    }
+    uint32_t hash = 2166136261u;
+    uint64_t totalNs = 0;
+    memset(movement, 127, nrOfPixels);
+    for (int32_t pass = 0; pass < repeat; pass++) {
+      for (int32_t frameNr = 0; frameNr < seq.nrOfFrames; frameNr++) {
+        uint64_t t0 = frames_now_in_ns();
+        bandEngineProcess(engine, seq.rgb565[frameNr], movement);
+        totalNs += frames_now_in_ns() - t0;
+        hash = checksum(hash, movement, nrOfPixels);
+      }
+    }
+    bandEngineDestroy(engine);
+    if (nrOfThreads == 1) singleThreadNs = totalNs;
+    identical &= (hash == referenceHash);
+    printf("%-8d %12.3f %10.3f %10.2f %8.2f  %s\n", nrOfThreads, totalNs / 1e6,
+           totalNs / ((double) nrOfProcessed * nrOfPixels), nrOfProcessed / (totalNs / 1e9),
+           singleThreadNs / totalNs, (hash == referenceHash) ? "identical" : "MISMATCH");
+  }
+  printf("checksum          : 0x%08x\n", referenceHash);
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*
+ * frames.c
+ *
+ * Frame sequences for the host benchmarks: binary PGM (P5) files, raw RGB565
+ * dumps of the camera frame buffer and a synthetic moving square.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "frames.h"
+#include "swap.h"
+
+uint64_t frames_now_in_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint16_t grayToRgb565(uint8_t gray) {
+  uint16_t rgb = ((gray >> 3) << 11) | ((gray >> 2) << 5) | (gray >> 3);
+  return swap_u16(rgb);
+}
+
+static void addFrame(frameSequence *seq, uint16_t *frame) {
+  seq->rgb565 = realloc(seq->rgb565, (seq->nrOfFrames + 1) * sizeof(uint16_t *));
+  if (seq->rgb565 == NULL) {
+    perror("realloc");
+    exit(1);
+  }
+  seq->rgb565[seq->nrOfFrames++] = frame;
+}
+
+static uint16_t *allocFrame(int32_t width, int32_t height) {
+  uint16_t *frame = malloc((size_t) width * height * sizeof(uint16_t));
+  if (frame == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  return frame;
+}
+
+static void checkGeometry(frameSequence *seq, const char *path, int32_t width, int32_t height) {
+  if (seq->nrOfFrames == 0) {
+    seq->width = width;
+    seq->height = height;
+  } else if (seq->width != width || seq->height != height) {
+    fprintf(stderr, "%s: frame is %dx%d, sequence is %dx%d\n", path, width, height, seq->width, seq->height);
+    exit(1);
+  }
+}
+
+static int readPgmValue(FILE *file) {
+  int c, value = 0;
+  do {
+    c = fgetc(file);
+    if (c == '#') {
+      while (c != '\n' && c != EOF) c = fgetc(file);
+    }
+  } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+  if (c < '0' || c > '9') return -1;
+  while (c >= '0' && c <= '9') {
+    value = value * 10 + (c - '0');
+    c = fgetc(file);
+  }
+  return value;
+}
+
+static void loadPgm(frameSequence *seq, const char *path, FILE *file) {
+  int32_t width = readPgmValue(file);
+  int32_t height = readPgmValue(file);
+  int maxValue = readPgmValue(file);
+  if (width <= 2 || height <= 2 || maxValue <= 0 || maxValue > 255) {
+    fprintf(stderr, "%s: unsupported PGM header\n", path);
+    exit(1);
+  }
+  checkGeometry(seq, path, width, height);
+  uint8_t *gray = malloc((size_t) width * height);
+  uint16_t *frame = allocFrame(width, height);
+  if (gray == NULL || fread(gray, 1, (size_t) width * height, file) != (size_t) width * height) {
+    fprintf(stderr, "%s: truncated PGM\n", path);
+    exit(1);
+  }
+  for (int32_t i = 0; i < width * height; i++) frame[i] = grayToRgb565(gray[i]);
+  free(gray);
+  addFrame(seq, frame);
+}
+
+static void loadRaw(frameSequence *seq, const char *path, FILE *file, int32_t width, int32_t height) {
+  size_t nrOfBytes = (size_t) width * height * 2;
+  uint8_t *bytes = malloc(nrOfBytes);
+  checkGeometry(seq, path, width, height);
+  if (bytes == NULL || fread(bytes, 1, nrOfBytes, file) != nrOfBytes) {
+    fprintf(stderr, "%s: expected %zu bytes of RGB565 data\n", path, nrOfBytes);
+    exit(1);
+  }
+  uint16_t *frame = allocFrame(width, height);
+  // the dump holds the SDRAM bytes; rebuild the halfwords the big-endian cpu sees
+  for (int32_t i = 0; i < width * height; i++) frame[i] = (bytes[2*i] << 8) | bytes[2*i+1];
+  free(bytes);
+  addFrame(seq, frame);
+}
+
+void frames_load(frameSequence *seq, const char *path, int32_t width, int32_t height) {
+  FILE *file = fopen(path, "rb");
+  char magic[2];
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  if (fread(magic, 1, 2, file) == 2 && magic[0] == 'P' && magic[1] == '5') {
+    loadPgm(seq, path, file);
+  } else {
+    rewind(file);
+    loadRaw(seq, path, file, width, height);
+  }
+  fclose(file);
+}
+
+void frames_make_synthetic(frameSequence *seq, int32_t width, int32_t height, int32_t nrOfFrames) {
+  seq->width = width;
+  seq->height = height;
+  for (int32_t frameNr = 0; frameNr < nrOfFrames; frameNr++) {
+    uint16_t *frame = allocFrame(width, height);
+    int32_t size = height / 4;
+    int32_t x0 = (frameNr * 8) % (width - size);
+    int32_t y0 = (frameNr * 4) % (height - size);
+    for (int32_t line = 0; line < height; line++) {
+      for (int32_t pixel = 0; pixel < width; pixel++) {
+        uint8_t gray = ((pixel / 16 + line / 16) & 1) ? 96 : 32;
+        if (pixel >= x0 && pixel < x0 + size && line >= y0 && line < y0 + size) gray = 224;
+        frame[line*width+pixel] = grayToRgb565(gray);
+      }
+    }
+    addFrame(seq, frame);
+  }
+}
+
+void frames_write_pgm(const char *path, uint8_t *image, int32_t width, int32_t height) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fprintf(file, "P5\n%d %d\n255\n", width, height);
+  fwrite(image, 1, (size_t) width * height, file);
+  fclose(file);
+}
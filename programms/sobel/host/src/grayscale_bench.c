@@ -0,0 +1,96 @@
+/*
+ * grayscale_bench.c
+ *
+ * Compares the table driven RGB565 to grayscale conversion (rgb565.c) with
+ * the arithmetic loop of edgedetection.c (grayscale.h) and with a bit exact
+ * model of modules/grayscaleCi/verilog/rgb565Grayscale.v, for all 65536
+ * RGB565 values, and times both software versions on a VGA frame.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "rgb565.h"
+#include "grayscale.h"
+
+static uint64_t nowInNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* rgb565Grayscale.v, net by net */
+static uint8_t rgb565GrayscaleHardware(uint16_t rgb565) {
+  uint32_t red = (rgb565 >> 11) & 0x1F;
+  uint32_t green = (rgb565 >> 5) & 0x3F;
+  uint32_t blue = rgb565 & 0x1F;
+  uint32_t redSum = red + (red << 1);
+  uint32_t redResult = (redSum + (redSum << 3)) & 0xFFF;
+  uint32_t blueSum = blue + (blue << 1);
+  uint32_t blueResult = (blueSum + (blue << 4)) & 0x1FFF;
+  uint32_t greenSum = green + (green << 1);
+  uint32_t greenSum1 = (greenSum + (greenSum << 3)) & 0x1FFF;
+  uint32_t greenx129 = (green << 6) | (green >> 1);
+  uint32_t greenResult = (greenSum1 + greenx129) & 0x1FFF;
+  uint32_t rbSum = ((redResult << 1) + blueResult) & 0x1FFF;
+  uint32_t rgbSum = (rbSum + greenResult) & 0x1FFF;
+  return (rgbSum >> 5) & 0xFF;
+}
+
+int main(int argc, char **argv) {
+  int32_t width = 640, height = 480, repeat = 100;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "W:H:r:")) != -1) {
+    switch (opt) {
+      case 'W': width = atoi(optarg); break;
+      case 'H': height = atoi(optarg); break;
+      case 'r': repeat = atoi(optarg); break;
+      default :
+        fprintf(stderr, "usage: %s [-W width] [-H height] [-r repeat]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (width <= 0 || height <= 0 || repeat <= 0) return 1;
+  rgb565_init_grayscale();
+
+  /* all RGB565 values, as the cpu reads them from the camera frame buffer */
+  uint16_t *allValues = malloc(65536 * sizeof(uint16_t));
+  uint8_t *loopGray = malloc(65536);
+  uint8_t *tableGray = malloc(65536);
+  if (allValues == NULL || loopGray == NULL || tableGray == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  for (uint32_t value = 0; value < 65536; value++) allValues[value] = swap_u16(value);
+  rgb565ToGrayscale(allValues, loopGray, 256, 256);
+  rgb565_to_grayscale(allValues, tableGray, 65536);
+  uint32_t tableMismatches = 0, hardwareMismatches = 0;
+  for (uint32_t value = 0; value < 65536; value++) {
+    if (tableGray[value] != loopGray[value]) tableMismatches++;
+    if (rgb565GrayscaleHardware(value) != loopGray[value]) hardwareMismatches++;
+  }
+  printf("table    vs loop   : %u of 65536 values differ\n", tableMismatches);
+  printf("hardware vs loop   : %u of 65536 values differ\n", hardwareMismatches);
+
+  size_t nrOfPixels = (size_t) width * height;
+  uint16_t *frame = malloc(nrOfPixels * sizeof(uint16_t));
+  uint8_t *gray = malloc(nrOfPixels);
+  if (frame == NULL || gray == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  srand(1);
+  for (size_t i = 0; i < nrOfPixels; i++) frame[i] = rand();
+  uint64_t t0 = nowInNs();
+  for (int32_t i = 0; i < repeat; i++) rgb565ToGrayscale(frame, gray, width, height);
+  uint64_t t1 = nowInNs();
+  for (int32_t i = 0; i < repeat; i++) rgb565_to_grayscale(frame, gray, nrOfPixels);
+  uint64_t t2 = nowInNs();
+  double pixels = (double) nrOfPixels * repeat;
+  printf("loop               : %.3f ns/pixel\n", (t1 - t0) / pixels);
+  printf("table              : %.3f ns/pixel\n", (t2 - t1) / pixels);
+  return (tableMismatches == 0 && hardwareMismatches == 0) ? 0 : 1;
+}
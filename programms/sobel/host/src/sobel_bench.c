@@ -0,0 +1,237 @@
+/*
+ * sobel_bench.c
+ *
+ * Host replay benchmark of the software Sobel + movement detection pipeline
+ * of edgedetection.c. Frames are read from binary PGM (P5) files or from raw
+ * RGB565 dumps of the camera frame buffer and pushed through the same kernels
+ * that run on the OR1420. Without input files a synthetic sequence is used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "frames.h"
+#include "grayscale.h"
+#include "rgb565.h"
+#include "sobel.h"
+#include "sobel_simd.h"
+#include "movement.h"
+#include "sobel_movement.h"
+
+#define NR_OF_STAGES 4
+#define STAGE_GRAYSCALE 0
+#define STAGE_EDGE 1
+#define STAGE_MOVEMENT 2
+#define STAGE_FUSED 3
+
+static const char *stageNames[NR_OF_STAGES] = { "grayscale", "edgeDetection", "movementDetection",
+                                                "sobelMovement" };
+
+typedef void (*edgeKernel)( volatile uint8_t *grayscale,
+                            volatile uint8_t *sobelResult,
+                            int32_t width,
+                            int32_t height,
+                            int32_t threshold );
+
+static void edgeDetectionSwarSoftware( volatile uint8_t *grayscale,
+                                       volatile uint8_t *sobelResult,
+                                       int32_t width,
+                                       int32_t height,
+                                       int32_t threshold ) {
+  edgeDetectionSwar(grayscale, sobelResult, width, height, threshold, SOBEL_THRESHOLD_SOFTWARE);
+}
+
+static const struct {
+  const char *name;
+  edgeKernel kernel;
+} edgeKernels[] = {
+  { "reference", edgeDetection },
+  { "linebuffer", edgeDetectionLineBuffer },
+  { "swar", edgeDetectionSwarSoftware },
+  { "simd", edgeDetectionSimd },
+#if SOBEL_SIMD_AVAILABLE
+  { "sse2", edgeDetectionSse2 },
+  { "avx2", edgeDetectionAvx2 },
+#endif
+};
+
+#define NR_OF_EDGE_KERNELS (sizeof(edgeKernels) / sizeof(edgeKernels[0]))
+
+typedef void (*movementKernel)( bool firstFrame,
+                                uint8_t *sobelResult,
+                                uint8_t *movementResult,
+                                int32_t width,
+                                int32_t height );
+
+static const struct {
+  const char *name;
+  movementKernel kernel;
+} movementKernels[] = {
+  { "reference", movementDetection },
+  { "word", movementDetectionWord },
+};
+
+#define NR_OF_MOVEMENT_KERNELS (sizeof(movementKernels) / sizeof(movementKernels[0]))
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-W width] [-H height] [-t threshold] [-r repeat] [-s frames] [-e kernel] [-m kernel] [-f] [-p] [-c] [-o out.pgm] [frame ...]\n"
+          "  frame       binary PGM (P5) file or raw RGB565 camera dump (*.raw, needs -W/-H)\n"
+          "  -W, -H      frame geometry for raw and synthetic frames (default 640x480)\n"
+          "  -t          sobel threshold (default 128, as in edgedetection.c)\n"
+          "  -r          number of passes over the frame sequence (default 1)\n"
+          "  -s          number of synthetic frames when no file is given (default 32)\n"
+          "  -e          edge detection kernel: reference (default), linebuffer, swar,\n"
+          "              simd (avx2 when available, else sse2), sse2, avx2\n"
+          "  -m          movement detection kernel: reference (default), word\n"
+          "  -f          run the fused single pass kernel (sobelMovementDetection)\n"
+          "  -p          keep the movement state packed (movementDetectionPacked)\n"
+          "  -c          check every frame against the reference kernels\n"
+          "  -o          write the last movement map as PGM\n", name);
+  exit(1);
+}
+
+static edgeKernel findEdgeKernel(const char *name) {
+#if SOBEL_SIMD_AVAILABLE
+  if (strcmp(name, "avx2") == 0 && !__builtin_cpu_supports("avx2")) {
+    fprintf(stderr, "the cpu does not support avx2\n");
+    exit(1);
+  }
+#endif
+  for (size_t i = 0; i < NR_OF_EDGE_KERNELS; i++) {
+    if (strcmp(edgeKernels[i].name, name) == 0) return edgeKernels[i].kernel;
+  }
+  fprintf(stderr, "unknown edge detection kernel: %s\n", name);
+  exit(1);
+}
+
+static movementKernel findMovementKernel(const char *name) {
+  for (size_t i = 0; i < NR_OF_MOVEMENT_KERNELS; i++) {
+    if (strcmp(movementKernels[i].name, name) == 0) return movementKernels[i].kernel;
+  }
+  fprintf(stderr, "unknown movement detection kernel: %s\n", name);
+  exit(1);
+}
+
+/* FNV-1a, folded over all movement maps to catch output regressions */
+static uint32_t checksum(uint32_t hash, uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+int main(int argc, char **argv) {
+  int32_t width = 640, height = 480, threshold = 128, repeat = 1, nrOfSynthetic = 32;
+  const char *outputName = NULL;
+  const char *edgeName = "reference";
+  const char *movementName = "reference";
+  bool check = false, fused = false, packed = false;
+  frameSequence seq = { 0, 0, 0, NULL };
+  uint64_t stageNs[NR_OF_STAGES] = { 0 };
+  int opt;
+
+  while ((opt = getopt(argc, argv, "W:H:t:r:s:e:m:fpco:")) != -1) {
+    switch (opt) {
+      case 'W': width = atoi(optarg); break;
+      case 'H': height = atoi(optarg); break;
+      case 't': threshold = atoi(optarg); break;
+      case 'r': repeat = atoi(optarg); break;
+      case 's': nrOfSynthetic = atoi(optarg); break;
+      case 'e': edgeName = optarg; break;
+      case 'm': movementName = optarg; break;
+      case 'f': fused = true; break;
+      case 'p': packed = true; break;
+      case 'c': check = true; break;
+      case 'o': outputName = optarg; break;
+      default : usage(argv[0]);
+    }
+  }
+  edgeKernel edge = findEdgeKernel(edgeName);
+  movementKernel movementStage = findMovementKernel(movementName);
+  if (width <= 2 || height <= 2 || repeat <= 0 || nrOfSynthetic <= 0 || (fused && packed)) usage(argv[0]);
+  for (int i = optind; i < argc; i++) frames_load(&seq, argv[i], width, height);
+  if (seq.nrOfFrames == 0) frames_make_synthetic(&seq, width, height, nrOfSynthetic);
+
+  size_t nrOfPixels = (size_t) seq.width * seq.height;
+  uint8_t *grayscale = calloc(nrOfPixels, 1);
+  uint8_t *sobel = calloc(nrOfPixels, 1);
+  uint8_t *movement = malloc(nrOfPixels);
+  uint8_t *checkGray = malloc(nrOfPixels);
+  uint8_t *checkSobel = calloc(nrOfPixels, 1);
+  uint8_t *checkMovement = malloc(nrOfPixels);
+  uint8_t *packedMovement = malloc(MOVEMENT_PACKED_SIZE(nrOfPixels));
+  if (grayscale == NULL || sobel == NULL || movement == NULL || packedMovement == NULL ||
+      checkGray == NULL || checkSobel == NULL || checkMovement == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  rgb565_init_grayscale();
+  memset(movement, 127, nrOfPixels);
+  memset(checkMovement, 127, nrOfPixels);
+  memset(packedMovement, MOVEMENT_PACKED_NO_EDGE, MOVEMENT_PACKED_SIZE(nrOfPixels));
+  uint64_t nrOfMismatches = 0;
+
+  uint32_t hash = 2166136261u;
+  bool firstFrame = true;
+  for (int32_t pass = 0; pass < repeat; pass++) {
+    for (int32_t frameNr = 0; frameNr < seq.nrOfFrames; frameNr++) {
+      if (fused) {
+        uint64_t t0 = frames_now_in_ns();
+        sobelMovementDetection(seq.rgb565[frameNr], movement, seq.width, seq.height, threshold);
+        stageNs[STAGE_FUSED] += frames_now_in_ns() - t0;
+      } else {
+        uint64_t t0 = frames_now_in_ns();
+        rgb565_to_grayscale(seq.rgb565[frameNr], grayscale, nrOfPixels);
+        uint64_t t1 = frames_now_in_ns();
+        edge(grayscale, sobel, seq.width, seq.height, threshold);
+        uint64_t t2 = frames_now_in_ns();
+        if (packed) {
+          movementDetectionPacked(firstFrame, sobel, packedMovement, seq.width, seq.height);
+        } else {
+          movementStage(firstFrame, sobel, movement, seq.width, seq.height);
+        }
+        uint64_t t3 = frames_now_in_ns();
+        // the displayed map is not part of the packed kernel
+        if (packed) movementUnpack(packedMovement, movement, nrOfPixels);
+        stageNs[STAGE_GRAYSCALE] += t1 - t0;
+        stageNs[STAGE_EDGE] += t2 - t1;
+        stageNs[STAGE_MOVEMENT] += t3 - t2;
+      }
+      hash = checksum(hash, movement, nrOfPixels);
+      if (check) {
+        rgb565ToGrayscale(seq.rgb565[frameNr], checkGray, seq.width, seq.height);
+        edgeDetection(checkGray, checkSobel, seq.width, seq.height, threshold);
+        movementDetection(firstFrame, checkSobel, checkMovement, seq.width, seq.height);
+        if ((!fused && memcmp(sobel, checkSobel, nrOfPixels) != 0) ||
+            memcmp(movement, checkMovement, nrOfPixels) != 0) {
+          fprintf(stderr, "frame %d of pass %d differs from the reference\n", frameNr, pass);
+          nrOfMismatches++;
+        }
+      }
+      firstFrame = false;
+    }
+  }
+
+  uint64_t nrOfProcessed = (uint64_t) seq.nrOfFrames * repeat;
+  double pixels = (double) nrOfProcessed * nrOfPixels;
+  uint64_t totalNs = 0;
+  printf("frames            : %llu (%dx%d, threshold %d, %s%s%s)\n", (unsigned long long) nrOfProcessed,
+         seq.width, seq.height, threshold, fused ? "fused" : edgeName, fused ? "" : "/",
+         fused ? "" : packed ? "packed" : movementName);
+  printf("%-18s %12s %10s\n", "stage", "total ms", "ns/pixel");
+  for (int stage = 0; stage < NR_OF_STAGES; stage++) {
+    if ((stage == STAGE_FUSED) != fused) continue;
+    printf("%-18s %12.3f %10.3f\n", stageNames[stage], stageNs[stage] / 1e6, stageNs[stage] / pixels);
+    totalNs += stageNs[stage];
+  }
+  printf("%-18s %12.3f %10.3f\n", "total", totalNs / 1e6, totalNs / pixels);
+  printf("frames/s          : %.2f\n", nrOfProcessed / (totalNs / 1e9));
+  printf("checksum          : 0x%08x\n", hash);
+  if (check) printf("check             : %s\n", (nrOfMismatches == 0) ? "identical to reference" : "MISMATCH");
+  if (outputName != NULL) frames_write_pgm(outputName, movement, seq.width, seq.height);
+  return (nrOfMismatches == 0) ? 0 : 1;
+}
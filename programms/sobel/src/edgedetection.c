@@ -4,15 +4,21 @@
 #include <vga.h>
 #include <sobel.h>
 #include <movement.h>
+#include <rgb565.h>
+#include <sobel_movement.h>
 
 //#define PROFILING  //Uncomment this line to enable profiling
+#define SINGLE_PASS  //Comment this line to run grayscale, sobel and movement detection as three separate passes
+// #define CAMERA_GRAY  //Uncomment this line to let the camera write the grayscale image and drop the grayscale pass
+#ifdef CAMERA_GRAY
+#undef SINGLE_PASS
+#endif
 
 volatile uint8_t sobel[640*480];
 volatile uint16_t rgb565[640*480];
 volatile uint8_t grayscale[640*480];
 volatile int8_t movement[640*480];
 
-// NOTE: to make this program work replace camera.v with camera_colors.v in project.files and rebuild the hardware.
 
 int main () {
   volatile int result;
@@ -37,29 +43,40 @@ int main () {
   for(int i=0; i<640*480;i++){
     movement[i]=127;
   }
+#ifdef CAMERA_GRAY
+  setCameraFormat(CAMERA_FORMAT_GRAY, 0);
+#else
+  setCameraFormat(CAMERA_FORMAT_RGB565, 0);
+  rgb565_init_grayscale();
+#endif
 
   vga[2] = swap_u32(2);
   vga[3] = swap_u32((uint32_t) &movement[0]);  
+#ifdef CAMERA_GRAY
+  takeSingleImageBlocking((uint32_t )&grayscale[0]);
+#else
   takeSingleImageBlocking((uint32_t )&rgb565[0]);
-  for (int line = 0; line < camParams.nrOfLinesPerImage; line++) {
-      for (int pixel = 0; pixel < camParams.nrOfPixelsPerLine; pixel++) {
-        uint16_t rgb = swap_u16(rgb565[line*camParams.nrOfPixelsPerLine+pixel]);
-        uint32_t red1 = ((rgb >> 11) & 0x1F) << 3;
-        uint32_t green1 = ((rgb >> 5) & 0x3F) << 2;
-        uint32_t blue1 = (rgb & 0x1F) << 3;
-        uint32_t gray = ((red1*54+green1*183+blue1*19) >> 8)&0xFF;
-        grayscale[line*camParams.nrOfPixelsPerLine+pixel] = gray;
-      }
-    }
-  edgeDetection(grayscale,sobel, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage,128);
-  movementDetection(true,sobel, movement, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage);
+#endif
+#ifdef SINGLE_PASS
+  sobelMovementDetection(rgb565, movement, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage,128);
+#else
+#ifndef CAMERA_GRAY
+  rgb565_to_grayscale(rgb565, grayscale, camParams.nrOfPixelsPerLine*camParams.nrOfLinesPerImage);
+#endif
+  edgeDetectionSwar(grayscale,sobel, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage,128,SOBEL_THRESHOLD_SOFTWARE);
+  movementDetectionWord(true,sobel, movement, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage);
+#endif
 
   while(1) {
 #ifdef PROFILING
     asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7));
 #endif
+#ifdef CAMERA_GRAY
+    takeSingleImageBlocking((uint32_t ) &grayscale[0]);
+#else
     uint32_t rgb = (uint32_t ) &rgb565[0];
     takeSingleImageBlocking(rgb);
+#endif
 #ifdef PROFILING
     asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
     asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
@@ -68,16 +85,18 @@ int main () {
     printf("nrOfCycles: %d %d %d\n", cycles, stall, idle);
     asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7));
 #endif
-    for (int line = 0; line < camParams.nrOfLinesPerImage; line++) {
-      for (int pixel = 0; pixel < camParams.nrOfPixelsPerLine; pixel++) {
-        uint16_t rgb = swap_u16(rgb565[line*camParams.nrOfPixelsPerLine+pixel]);
-        uint32_t red1 = ((rgb >> 11) & 0x1F) << 3;
-        uint32_t green1 = ((rgb >> 5) & 0x3F) << 2;
-        uint32_t blue1 = (rgb & 0x1F) << 3;
-        uint32_t gray = ((red1*54+green1*183+blue1*19) >> 8)&0xFF;
-        grayscale[line*camParams.nrOfPixelsPerLine+pixel] = gray;
-      }
-    }
+#ifdef SINGLE_PASS
+    sobelMovementDetection(rgb565, movement, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage,128);
+#ifdef PROFILING
+    asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
+    asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
+    asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
+    printf("---------------------SobelMovementDetection---------------------\n");
+    printf("nrOfCycles: %d %d %d\n", cycles, stall, idle);
+#endif
+#else
+#ifndef CAMERA_GRAY
+    rgb565_to_grayscale(rgb565, grayscale, camParams.nrOfPixelsPerLine*camParams.nrOfLinesPerImage);
 #ifdef PROFILING
     asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
     asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
@@ -86,7 +105,8 @@ int main () {
     printf("nrOfCycles: %d %d %d\n", cycles, stall, idle);
     asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7));
 #endif
-    edgeDetection(grayscale,sobel, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage,128);
+#endif
+    edgeDetectionSwar(grayscale,sobel, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage,128,SOBEL_THRESHOLD_SOFTWARE);
 #ifdef PROFILING
     asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
     asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
@@ -95,13 +115,14 @@ int main () {
     printf("nrOfCycles: %d %d %d\n", cycles, stall, idle);
     asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7));
 #endif
-    movementDetection(false,sobel, movement, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage);
+    movementDetectionWord(false,sobel, movement, camParams.nrOfPixelsPerLine, camParams.nrOfLinesPerImage);
 #ifdef PROFILING
     asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
     asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
     asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
     printf("---------------------MovementDetection---------------------\n");
     printf("nrOfCycles: %d %d %d\n", cycles, stall, idle);
+#endif
 #endif
   }
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+/*
+ * grayscale.h
+ *
+ * RGB565 to grayscale conversion of a full camera frame, computed per pixel.
+ * This is the reference for the table driven rgb565_to_grayscale (rgb565.h).
+ */
+
+#ifndef GRAYSCALE_H_
+#define GRAYSCALE_H_
+
+#include <stdint.h>
+#include <swap.h>
+
+void rgb565ToGrayscale( volatile uint16_t *rgb565,
+                        volatile uint8_t *grayscale,
+                        int32_t width,
+                        int32_t height ) {
+  for (int line = 0; line < height; line++) {
+    for (int pixel = 0; pixel < width; pixel++) {
+      uint16_t rgb = swap_u16(rgb565[line*width+pixel]);
+      uint32_t red1 = ((rgb >> 11) & 0x1F) << 3;
+      uint32_t green1 = ((rgb >> 5) & 0x3F) << 2;
+      uint32_t blue1 = (rgb & 0x1F) << 3;
+      uint32_t gray = ((red1*54+green1*183+blue1*19) >> 8)&0xFF;
+      grayscale[line*width+pixel] = gray;
+    }
+  }
+}
+
+#endif /* GRAYSCALE_H_ */
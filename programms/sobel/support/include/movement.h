@@ -1,3 +1,6 @@
+#ifndef MOVEMENT_H_
+#define MOVEMENT_H_
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -21,3 +24,130 @@ void movementDetection(bool firstFrame,
         }
     
 }
+
+/*
+ * Branch free movementDetection, 4 pixels per 32-bit word. A lane is 0xFF
+ * where the sobel value is 255 (edge) and where the previous value is 127
+ * (no edge before), the result is edge & noEdgeBefore | ~edge & 127. The
+ * compare is the exact zero byte test: a byte of ((x & 0x7F) + 0x7F) | x has
+ * its high bit set iff it is not zero, and no carry crosses a lane.
+ */
+#define MOVEMENT_ZERO_LANES(x) (~((((x) & 0x7F7F7F7F) + 0x7F7F7F7F) | (x)) & 0x80808080)
+#define MOVEMENT_LANE_MASK(high) (((high) - ((high) >> 7)) | (high))
+
+// the words overlay the byte frames, so they must not be assumed to be distinct
+typedef uint32_t __attribute__((may_alias)) movementWord;
+
+#if defined(__GNUC__) && !defined(__or1k__)
+#ifdef __AVX2__
+#define MOVEMENT_VECTOR_SIZE 32
+#else
+#define MOVEMENT_VECTOR_SIZE 16
+#endif
+typedef uint8_t movementVector __attribute__((vector_size(MOVEMENT_VECTOR_SIZE)));
+#endif
+
+void movementDetectionWord(bool firstFrame,
+                           uint8_t *sobelResult,
+                           uint8_t *movementResult,
+                           int32_t width,
+                           int32_t height) {
+  int32_t nrOfPixels = width * height;
+  int32_t i = 0;
+#if defined(__GNUC__) && !defined(__or1k__)
+  /* host build: 16 (SSE2) or 32 (AVX2) lanes per step on the vector unit */
+  const movementVector edgeValue = (movementVector) {0} + 255;
+  const movementVector noEdgeValue = (movementVector) {0} + 127;
+  for (; i + MOVEMENT_VECTOR_SIZE <= nrOfPixels; i += MOVEMENT_VECTOR_SIZE) {
+    movementVector sobel, previous;
+    __builtin_memcpy(&sobel, sobelResult + i, MOVEMENT_VECTOR_SIZE);
+    __builtin_memcpy(&previous, movementResult + i, MOVEMENT_VECTOR_SIZE);
+    movementVector edge = (movementVector) (sobel == edgeValue);
+    movementVector noEdgeBefore = (movementVector) (previous == noEdgeValue);
+    movementVector result = (edge & noEdgeBefore) | (~edge & noEdgeValue);
+    __builtin_memcpy(movementResult + i, &result, MOVEMENT_VECTOR_SIZE);
+  }
+#endif
+  for (; i < nrOfPixels && (((uintptr_t) (sobelResult + i)) & 3) != 0; i++) {
+    uint32_t edge = -(uint32_t) (sobelResult[i] == 255);
+    uint32_t noEdgeBefore = -(uint32_t) (movementResult[i] == 127);
+    movementResult[i] = (edge & noEdgeBefore) | (~edge & 127);
+  }
+  if ((((uintptr_t) (movementResult + i)) & 3) == 0) {
+    movementWord *sobelWords = (movementWord *) (sobelResult + i);
+    movementWord *movementWords = (movementWord *) (movementResult + i);
+    for (; i + 4 <= nrOfPixels; i += 4) {
+      uint32_t notSobel = ~*sobelWords++;
+      uint32_t previous = *movementWords ^ 0x7F7F7F7F;
+      uint32_t edgeHigh = MOVEMENT_ZERO_LANES(notSobel);
+      uint32_t noEdgeBeforeHigh = MOVEMENT_ZERO_LANES(previous);
+      uint32_t edge = MOVEMENT_LANE_MASK(edgeHigh);
+      uint32_t noEdgeBefore = MOVEMENT_LANE_MASK(noEdgeBeforeHigh);
+      *movementWords++ = (edge & noEdgeBefore) | (~edge & 0x7F7F7F7F);
+    }
+  }
+  for (; i < nrOfPixels; i++) {
+    uint32_t edge = -(uint32_t) (sobelResult[i] == 255);
+    uint32_t noEdgeBefore = -(uint32_t) (movementResult[i] == 127);
+    movementResult[i] = (edge & noEdgeBefore) | (~edge & 127);
+  }
+}
+
+/*
+ * Packed movement state: 2 bits per pixel, 4 pixels per byte, pixel 4n+i in
+ * bits [2i+1:2i] of byte n. The code is bits [7:6] of the movement value, the
+ * only bits the accelerator inspects: 127 -> 01 (no edge), 0 -> 00 (edge that
+ * was there before) and 255 -> 11 (new edge). A frame of width*height pixels
+ * needs MOVEMENT_PACKED_SIZE(width*height) bytes.
+ */
+#define MOVEMENT_PACKED_SIZE(nrOfPixels) (((nrOfPixels) + 3) >> 2)
+#define MOVEMENT_CODE_NO_EDGE 0x1
+#define MOVEMENT_PACKED_NO_EDGE 0x55
+
+static const uint8_t movementCodeValue[4] = { 0, 127, 128, 255 };
+
+void movementPack( uint8_t *movementResult,
+                   uint8_t *packedMovement,
+                   int32_t nrOfPixels ) {
+  for (int32_t i = 0; i < nrOfPixels; i += 4) {
+    uint32_t packed = MOVEMENT_PACKED_NO_EDGE;
+    for (int32_t j = 0; j < 4 && i + j < nrOfPixels; j++) {
+      packed &= ~(3 << (j << 1));
+      packed |= (movementResult[i+j] >> 6) << (j << 1);
+    }
+    packedMovement[i >> 2] = packed;
+  }
+}
+
+void movementUnpack( uint8_t *packedMovement,
+                     uint8_t *movementResult,
+                     int32_t nrOfPixels ) {
+  for (int32_t i = 0; i < nrOfPixels; i++) {
+    movementResult[i] = movementCodeValue[(packedMovement[i >> 2] >> ((i & 3) << 1)) & 3];
+  }
+}
+
+/*
+ * movementDetection on the packed state: packedMovement holds the state of
+ * the previous frame (MOVEMENT_PACKED_NO_EDGE for the first one) and is
+ * replaced by the state of this frame, one byte (4 pixels) at a time:
+ * high bit = edge & noEdgeBefore, low bit = ~edge | noEdgeBefore.
+ */
+void movementDetectionPacked( bool firstFrame,
+                              uint8_t *sobelResult,
+                              uint8_t *packedMovement,
+                              int32_t width,
+                              int32_t height ) {
+  int32_t nrOfPixels = width * height;
+  for (int32_t i = 0; i < nrOfPixels; i += 4) {
+    uint32_t edges = 0;
+    for (int32_t j = 0; j < 4 && i + j < nrOfPixels; j++) {
+      edges |= (sobelResult[i+j] == 255) << (j << 1);
+    }
+    uint32_t previous = packedMovement[i >> 2];
+    uint32_t noEdgeBefore = previous & ~(previous >> 1) & 0x55;
+    packedMovement[i >> 2] = ((edges & noEdgeBefore) << 1) | ((~edges | noEdgeBefore) & 0x55);
+  }
+}
+
+#endif /* MOVEMENT_H_ */
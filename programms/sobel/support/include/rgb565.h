@@ -0,0 +1,26 @@
+#ifndef RGB565_H_INCLUDED
+#define RGB565_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Table driven RGB565 to grayscale conversion, giving the same values as
+ * gray = (red*54 + green*183 + blue*19) >> 8 on the 8-bit color components
+ * (and as rgb565Grayscale.v). The pixels are taken as they are read from the
+ * camera frame buffer, the byte swap (swap_u16) is folded into the tables.
+ *
+ * rgb565_init_grayscale() fills the tables and has to be called once before
+ * the conversion.
+ */
+void rgb565_init_grayscale();
+void rgb565_to_grayscale(volatile uint16_t *rgb565, volatile uint8_t *grayscale, uint32_t nrOfPixels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RGB565_H_INCLUDED */
@@ -5,6 +5,9 @@
  *      Author: theo
  */
 
+#ifndef SOBEL_H_
+#define SOBEL_H_
+
 #include <stdio.h>
 #include <stdint.h>
 
@@ -39,3 +42,214 @@ void edgeDetection( volatile uint8_t *grayscale,
 }
 
 
+
+/*
+ * Line buffered variant of edgeDetection. The three image lines the 3x3 window
+ * needs are kept in the scratchpad memory of the d-cache, so each input pixel
+ * is read only once from SDRAM (word wise when possible) instead of nine times.
+ * The vertical sums of a column are computed once and reused for the three
+ * output pixels that overlap it. The result is identical to edgeDetection.
+ */
+#define SOBEL_MAX_LINE_WIDTH 640
+
+#ifdef __or1k__
+#define SOBEL_LINE_BUFFER ((uint8_t *) 0xC0000000) // scratchpad memory of dCache.v
+#else
+// one per thread on the host, as every core has its own scratchpad
+static __thread uint8_t sobelLineBufferMemory[3*SOBEL_MAX_LINE_WIDTH] __attribute__((aligned(4)));
+#define SOBEL_LINE_BUFFER sobelLineBufferMemory
+#endif
+
+// word accesses to byte images, may_alias keeps them ordered with the byte accesses
+typedef uint32_t __attribute__((may_alias)) sobelWord;
+
+static void sobelCopyLine( volatile uint8_t *source,
+                           uint8_t *destination,
+                           int32_t width ) {
+  if ((((uintptr_t) source) & 3) == 0 && (width & 3) == 0) {
+    volatile sobelWord *sourceWords = (volatile sobelWord *) source;
+    sobelWord *destinationWords = (sobelWord *) destination;
+    for (int word = 0; word < (width >> 2); word++) {
+      destinationWords[word] = sourceWords[word];
+    }
+  } else {
+    for (int pixel = 0; pixel < width; pixel++) {
+      destination[pixel] = source[pixel];
+    }
+  }
+}
+
+void edgeDetectionLineBuffer( volatile uint8_t *grayscale,
+                              volatile uint8_t *sobelResult,
+                              int32_t width,
+                              int32_t height,
+                              int32_t threshold ) {
+  uint8_t *top = SOBEL_LINE_BUFFER;
+  uint8_t *middle = top + SOBEL_MAX_LINE_WIDTH;
+  uint8_t *bottom = middle + SOBEL_MAX_LINE_WIDTH;
+  uint8_t *swap;
+  int32_t sumXLeft, sumXMiddle, sumXRight, diffYLeft, diffYMiddle, diffYRight;
+  int32_t valueX, valueY, result;
+  if (width > SOBEL_MAX_LINE_WIDTH) {
+    edgeDetection(grayscale, sobelResult, width, height, threshold);
+    return;
+  }
+  if (height < 3 || width < 3) return;
+  sobelCopyLine(grayscale, top, width);
+  sobelCopyLine(grayscale + width, middle, width);
+  for (int line = 1; line < height - 1; line++) {
+    sobelCopyLine(grayscale + (line+1)*width, bottom, width);
+    // sumX is the column weighted with (1,2,1), diffY the top minus the bottom pixel
+    sumXLeft = top[0] + (middle[0] << 1) + bottom[0];
+    diffYLeft = top[0] - bottom[0];
+    sumXMiddle = top[1] + (middle[1] << 1) + bottom[1];
+    diffYMiddle = top[1] - bottom[1];
+    for (int pixel = 1; pixel < width - 1; pixel++) {
+      sumXRight = top[pixel+1] + (middle[pixel+1] << 1) + bottom[pixel+1];
+      diffYRight = top[pixel+1] - bottom[pixel+1];
+      valueX = sumXRight - sumXLeft;
+      valueY = diffYLeft + (diffYMiddle << 1) + diffYRight;
+      result = (valueX < 0) ? -valueX : valueX;
+      result += (valueY < 0) ? -valueY : valueY;
+      sobelResult[line*width+pixel] = (result > threshold) ? 0xFF : 0;
+      sumXLeft = sumXMiddle;
+      diffYLeft = diffYMiddle;
+      sumXMiddle = sumXRight;
+      diffYMiddle = diffYRight;
+    }
+    swap = top;
+    top = middle;
+    middle = bottom;
+    bottom = swap;
+  }
+}
+
+/*
+ * SIMD within a register variant of edgeDetection, computing 4 output pixels
+ * per iteration from one 32-bit word of each of the three lines, like the
+ * 3x6 byte window of ramDmaCi_sobel_movement_detection.v. The even and odd
+ * pixels of a word are processed in two registers holding two 16-bit lanes
+ * each (the left pixel in the upper lane). Signed values are kept biased so a
+ * lane never borrows from its neighbour: the column differences by 255, the
+ * gradients by 1024.
+ *
+ * thresholdMode selects the comparison: SOBEL_THRESHOLD_SOFTWARE marks an
+ * edge when |Gx|+|Gy| > threshold (edgeDetection), SOBEL_THRESHOLD_HARDWARE
+ * when |Gx|+|Gy| >= threshold (the accelerator). Frames whose width is not a
+ * multiple of 4 or whose buffers are not word aligned use
+ * edgeDetectionLineBuffer instead.
+ */
+#define SOBEL_THRESHOLD_SOFTWARE 0
+#define SOBEL_THRESHOLD_HARDWARE 1
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SOBEL_SWAR_EVEN(word) (((word) >> 8) & 0x00FF00FF)
+#define SOBEL_SWAR_ODD(word) ((word) & 0x00FF00FF)
+#define SOBEL_SWAR_PACK(even, odd) (((even) << 8) | (odd))
+#else
+#define SOBEL_SWAR_SWAP_LANES(value) (((value) << 16) | ((value) >> 16))
+#define SOBEL_SWAR_EVEN(word) SOBEL_SWAR_SWAP_LANES((word) & 0x00FF00FF)
+#define SOBEL_SWAR_ODD(word) SOBEL_SWAR_SWAP_LANES(((word) >> 8) & 0x00FF00FF)
+#define SOBEL_SWAR_PACK(even, odd) SOBEL_SWAR_SWAP_LANES((even) | ((odd) << 8))
+#endif
+
+/* lanes hold G + 1024 with |G| < 1024, returns |G| per lane */
+static inline uint32_t sobelSwarAbs(uint32_t value) {
+  uint32_t negative = (~value >> 10) & 0x00010001;
+  uint32_t mask = (negative << 10) - negative;
+  return ((value ^ mask) & 0x03FF03FF) + negative;
+}
+
+/* lanes hold the edge flags in bit 0, returns 0xFF per lane for an edge */
+static inline uint32_t sobelSwarMask(uint32_t flags) {
+  return (flags << 8) - flags;
+}
+
+void edgeDetectionSwar( volatile uint8_t *grayscale,
+                        volatile uint8_t *sobelResult,
+                        int32_t width,
+                        int32_t height,
+                        int32_t threshold,
+                        int32_t thresholdMode ) {
+  uint8_t *top = SOBEL_LINE_BUFFER;
+  uint8_t *middle = top + SOBEL_MAX_LINE_WIDTH;
+  uint8_t *bottom = middle + SOBEL_MAX_LINE_WIDTH;
+  uint8_t *swap;
+  uint32_t sumEven, sumOdd, diffEven, diffOdd, previousSumOdd, previousDiffOdd;
+  uint32_t nextSumEven, nextSumOdd, nextDiffEven, nextDiffOdd;
+  uint32_t topWord, middleWord, bottomWord, valueX, valueY, flagsEven, flagsOdd, result;
+  int32_t nrOfGroups = width >> 2;
+  if (thresholdMode == SOBEL_THRESHOLD_HARDWARE) threshold--;
+  if (width > SOBEL_MAX_LINE_WIDTH || width < 4 || (width & 3) != 0 ||
+      (((uintptr_t) grayscale) & 3) != 0 || (((uintptr_t) sobelResult) & 3) != 0) {
+    edgeDetectionLineBuffer(grayscale, sobelResult, width, height, threshold);
+    return;
+  }
+  if (height < 3) return;
+  // |Gx|+|Gy| <= 2040, so clamping keeps the biased compare inside a lane
+  if (threshold < -1) threshold = -1;
+  if (threshold > 2040) threshold = 2040;
+  uint32_t thresholdBias = (0x8000 - (threshold + 1)) * 0x00010001;
+  sobelCopyLine(grayscale, top, width);
+  sobelCopyLine(grayscale + width, middle, width);
+  for (int line = 1; line < height - 1; line++) {
+    sobelWord *topWords = (sobelWord *) top;
+    sobelWord *middleWords = (sobelWord *) middle;
+    sobelWord *bottomWords = (sobelWord *) bottom;
+    volatile sobelWord *resultWords = (volatile sobelWord *) (sobelResult + line*width);
+    sobelCopyLine(grayscale + (line+1)*width, bottom, width);
+    // sum is the column weighted with (1,2,1), diff the top minus the bottom pixel plus 255
+    previousSumOdd = previousDiffOdd = 0;
+    nextSumEven = nextSumOdd = nextDiffEven = nextDiffOdd = 0;
+    topWord = topWords[0];
+    middleWord = middleWords[0];
+    bottomWord = bottomWords[0];
+    sumEven = SOBEL_SWAR_EVEN(topWord) + (SOBEL_SWAR_EVEN(middleWord) << 1) + SOBEL_SWAR_EVEN(bottomWord);
+    sumOdd = SOBEL_SWAR_ODD(topWord) + (SOBEL_SWAR_ODD(middleWord) << 1) + SOBEL_SWAR_ODD(bottomWord);
+    diffEven = SOBEL_SWAR_EVEN(topWord) + 0x00FF00FF - SOBEL_SWAR_EVEN(bottomWord);
+    diffOdd = SOBEL_SWAR_ODD(topWord) + 0x00FF00FF - SOBEL_SWAR_ODD(bottomWord);
+    for (int group = 0; group < nrOfGroups; group++) {
+      if (group + 1 < nrOfGroups) {
+        topWord = topWords[group+1];
+        middleWord = middleWords[group+1];
+        bottomWord = bottomWords[group+1];
+        nextSumEven = SOBEL_SWAR_EVEN(topWord) + (SOBEL_SWAR_EVEN(middleWord) << 1) + SOBEL_SWAR_EVEN(bottomWord);
+        nextSumOdd = SOBEL_SWAR_ODD(topWord) + (SOBEL_SWAR_ODD(middleWord) << 1) + SOBEL_SWAR_ODD(bottomWord);
+        nextDiffEven = SOBEL_SWAR_EVEN(topWord) + 0x00FF00FF - SOBEL_SWAR_EVEN(bottomWord);
+        nextDiffOdd = SOBEL_SWAR_ODD(topWord) + 0x00FF00FF - SOBEL_SWAR_ODD(bottomWord);
+      } else {
+        nextSumEven = nextSumOdd = nextDiffEven = nextDiffOdd = 0;
+      }
+      // even pixels x, x+2: left columns x-1, x+1, right columns x+1, x+3
+      valueX = sumOdd + 0x04000400 - ((previousSumOdd << 16) | (sumOdd >> 16));
+      valueY = ((previousDiffOdd << 16) | (diffOdd >> 16)) + (diffEven << 1) + diffOdd + 0x00040004;
+      flagsEven = ((sobelSwarAbs(valueX) + sobelSwarAbs(valueY) + thresholdBias) >> 15) & 0x00010001;
+      // odd pixels x+1, x+3: left columns x, x+2, right columns x+2, x+4
+      valueX = ((sumEven << 16) | (nextSumEven >> 16)) + 0x04000400 - sumEven;
+      valueY = diffEven + (diffOdd << 1) + ((diffEven << 16) | (nextDiffEven >> 16)) + 0x00040004;
+      flagsOdd = ((sobelSwarAbs(valueX) + sobelSwarAbs(valueY) + thresholdBias) >> 15) & 0x00010001;
+      result = SOBEL_SWAR_PACK(sobelSwarMask(flagsEven), sobelSwarMask(flagsOdd));
+      if (group == 0 || group == nrOfGroups - 1) {
+        // the border pixels are not part of the result
+        for (int byte = 0; byte < 4; byte++) {
+          int32_t pixel = (group << 2) + byte;
+          if (pixel >= 1 && pixel < width - 1) sobelResult[line*width+pixel] = ((uint8_t *) &result)[byte];
+        }
+      } else {
+        resultWords[group] = result;
+      }
+      previousSumOdd = sumOdd;
+      previousDiffOdd = diffOdd;
+      sumEven = nextSumEven;
+      sumOdd = nextSumOdd;
+      diffEven = nextDiffEven;
+      diffOdd = nextDiffOdd;
+    }
+    swap = top;
+    top = middle;
+    middle = bottom;
+    bottom = swap;
+  }
+}
+
+#endif /* SOBEL_H_ */
@@ -0,0 +1,105 @@
+/*
+ * sobel_movement.h
+ *
+ * Single pass grayscale conversion, Sobel filter and movement detection.
+ */
+
+#ifndef SOBEL_MOVEMENT_H_
+#define SOBEL_MOVEMENT_H_
+
+#include <stdint.h>
+#include <rgb565.h>
+#include <sobel.h>
+
+/*
+ * Filters and classifies the columns 1 to stripWidth-2 of a strip of the
+ * frame; rgb565 and movementResult point to the first column of the strip and
+ * width is the length of a frame line. The three gray lines of the strip rotate
+ * through the line buffer, so stripWidth must not exceed SOBEL_MAX_LINE_WIDTH.
+ */
+static void sobelMovementDetectionStrip( volatile uint16_t *rgb565,
+                                         volatile uint8_t *movementResult,
+                                         int32_t width,
+                                         int32_t stripWidth,
+                                         int32_t height,
+                                         int32_t threshold ) {
+  uint8_t *top = SOBEL_LINE_BUFFER;
+  uint8_t *middle = top + SOBEL_MAX_LINE_WIDTH;
+  uint8_t *bottom = middle + SOBEL_MAX_LINE_WIDTH;
+  uint8_t *swap;
+  volatile uint8_t *movementLine;
+  int32_t sumXLeft, sumXMiddle, sumXRight, diffYLeft, diffYMiddle, diffYRight;
+  int32_t valueX, valueY, result;
+  rgb565_to_grayscale(rgb565, top, stripWidth);
+  rgb565_to_grayscale(rgb565 + width, middle, stripWidth);
+  for (int line = 1; line < height - 1; line++) {
+    rgb565_to_grayscale(rgb565 + (line+1)*width, bottom, stripWidth);
+    movementLine = movementResult + line*width;
+    sumXLeft = top[0] + (middle[0] << 1) + bottom[0];
+    diffYLeft = top[0] - bottom[0];
+    sumXMiddle = top[1] + (middle[1] << 1) + bottom[1];
+    diffYMiddle = top[1] - bottom[1];
+    for (int pixel = 1; pixel < stripWidth - 1; pixel++) {
+      sumXRight = top[pixel+1] + (middle[pixel+1] << 1) + bottom[pixel+1];
+      diffYRight = top[pixel+1] - bottom[pixel+1];
+      valueX = sumXRight - sumXLeft;
+      valueY = diffYLeft + (diffYMiddle << 1) + diffYRight;
+      result = (valueX < 0) ? -valueX : valueX;
+      result += (valueY < 0) ? -valueY : valueY;
+      if (result > threshold) {
+        movementLine[pixel] = (movementLine[pixel] != 127) ? 0 : 255;
+      } else {
+        movementLine[pixel] = 127;
+      }
+      sumXLeft = sumXMiddle;
+      diffYLeft = diffYMiddle;
+      sumXMiddle = sumXRight;
+      diffYMiddle = diffYRight;
+    }
+    swap = top;
+    top = middle;
+    middle = bottom;
+    bottom = swap;
+  }
+}
+
+/*
+ * Streams the RGB565 frame line by line: each line is converted to gray into
+ * the line buffer of edgeDetectionLineBuffer and, as soon as three gray lines
+ * are available, the middle one is filtered and classified in place in
+ * movementResult. The grayscale and sobel frames of the three pass version are
+ * never written, only the RGB565 input and movementResult cross the bus.
+ * movementResult must hold the result of the previous frame (127 for the first
+ * one); the result is identical to rgb565ToGrayscale, edgeDetection and
+ * movementDetection in sequence. rgb565_init_grayscale() has to be called
+ * once before. Frames wider than SOBEL_MAX_LINE_WIDTH are done in vertical
+ * strips of at most SOBEL_MAX_LINE_WIDTH columns that overlap by two.
+ */
+void sobelMovementDetection( volatile uint16_t *rgb565,
+                             volatile uint8_t *movementResult,
+                             int32_t width,
+                             int32_t height,
+                             int32_t threshold ) {
+  int32_t stripWidth;
+  if (height < 3 || width < 3) {
+    for (int i = 0; i < width * height; i++) movementResult[i] = 127;
+    return;
+  }
+  // the border pixels have no sobel value and are never marked
+  for (int pixel = 0; pixel < width; pixel++) {
+    movementResult[pixel] = 127;
+    movementResult[(height-1)*width+pixel] = 127;
+  }
+  for (int line = 1; line < height - 1; line++) {
+    movementResult[line*width] = 127;
+    movementResult[line*width+width-1] = 127;
+  }
+  for (int column = 0; column < width - 2; column += SOBEL_MAX_LINE_WIDTH - 2) {
+    stripWidth = width - column;
+    if (stripWidth > SOBEL_MAX_LINE_WIDTH) stripWidth = SOBEL_MAX_LINE_WIDTH;
+    sobelMovementDetectionStrip(rgb565 + column, movementResult + column, width,
+                                stripWidth, height, threshold);
+  }
+}
+
+#endif /* SOBEL_MOVEMENT_H_ */
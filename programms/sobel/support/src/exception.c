@@ -13,6 +13,12 @@ __weak void illegal_instruction_handler() {
     puts("????");
 }
 
+/*
+ * No driver here acknowledges the completion interrupt of the ramDmaCi or the
+ * camera interrupts (ramdma.c and cameraInterrupt are in programms/_support),
+ * so this program must not enable them: the interrupt line would stay high and
+ * no later interrupt would reach the cpu.
+ */
 __weak void external_interrupt_handler() {
     puts("ping");
 }
@@ -412,3 +412,10 @@ void disableContinues() {
   asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(6),[in2]"r"(0));
 }
 
+/* from the next frame on the grabber writes the grayscale image (CAMERA_FORMAT_GRAY, 4 pixels per word), the RGB565
+ * image (CAMERA_FORMAT_RGB565, 2 pixels per word) or both (CAMERA_FORMAT_BOTH) to the frame buffer; with both the
+ * RGB565 image goes to colorBuffer and the grayscale image to the frame buffer */
+void setCameraFormat(uint32_t format, uint32_t colorBuffer) {
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(54),[in2]"r"(colorBuffer));
+  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x7"::[in1]"r"(53),[in2]"r"(format));
+}
@@ -2,13 +2,53 @@
 #include <ov7670.h>
 #include <swap.h>
 #include <vga.h>
+#include <ramdma.h>
 
-// define profiling flags : decomment one to enable a specific profiling
-// #define FULL_PROFILING                    // total cycles per frame
-// #define MOVEMENT_DETECTION_PROFILING      // cycles for moving additional data required for movement detection
-// #define SOBEL_PROFILING                   // cycles for moving  sobel input data and performing sobel
-// #define CI_MEMORY_TO_OUTPUT_PROFILING     // cycles for moving the output values back to the output vector
-//  #define INITIALIZATION_PROFILING     // cycles for reading the image and iniytializing for the first tile
+// profiling: set PROFILING to one of the following to count the cycles of a part of every frame
+#define NO_PROFILING 0
+#define FULL_PROFILING 1                  // total cycles per frame
+#define MOVEMENT_DETECTION_PROFILING 2    // cycles for moving additional data required for movement detection
+#define SOBEL_PROFILING 3                 // cycles for moving  sobel input data and performing sobel
+#define CI_MEMORY_TO_OUTPUT_PROFILING 4   // cycles for moving the output values back to the output vector
+#define INITIALIZATION_PROFILING 5        // cycles for reading the image and iniytializing for the first tile
+#define PROFILING NO_PROFILING
+
+// walk of the tiles: set WALK to one of the following
+#define TILE_WALK 0    // every transfer of every tile is programmed with custom instructions
+#define CHAIN_WALK 1   // the transfers of a frame are executed as a chain of descriptors built once
+#define FRAME_WALK 2   // the accelerator walks all tiles of a frame itself
+#define CAMERA_WALK 3  // the camera filters every frame while it arrives and writes only the movement image and its edges
+#define WALK FRAME_WALK
+
+// capture of the frames: set CAPTURE to one of the following
+#define SINGLE_CAPTURE 0  // every frame is grabbed once the previous one is processed
+#define RING_CAPTURE 1    // the camera grabs continuously into 3 frame buffers in turn, the last completed frame is processed
+#define CHASE_CAPTURE 2   // the software walk starts on a row of tiles as soon as the camera has written its lines
+#define CAPTURE SINGLE_CAPTURE
+
+#if CAPTURE == RING_CAPTURE && (WALK == CHAIN_WALK || WALK == CAMERA_WALK)
+#error "RING_CAPTURE needs the gray address of every frame, use FRAME_WALK or TILE_WALK"
+#endif
+#if CAPTURE == CHASE_CAPTURE && WALK != TILE_WALK
+#error "CHASE_CAPTURE needs the software walk of the tiles"
+#endif
+
+// options of the walks, the code of the ones that are off is removed by the compiler
+const uint32_t packedState = 1;        // 0 reads the previous frame state back from the 8-bit output image
+const uint32_t overlapWriteBack = 1;   // triple buffering: the write back of a tile and the input of the next one while the
+                                       // filter runs, with packedState only
+const uint32_t stripeWalk = 1;         // FRAME_WALK: the tiles are walked down vertical stripes, the halo lines of a tile
+                                       // stay in the filter
+const uint32_t irqCompletion = 1;      // CHAIN_WALK and FRAME_WALK: wait for the end of a frame on the completion interrupt
+                                       // instead of polling the accelerator
+const uint32_t magnitudeOutput = 0;    // the output image is the gradient magnitude, the movement is only kept in the
+                                       // packed state
+// what is done after every frame
+const uint32_t adaptiveThreshold = 0;  // the threshold is set from the magnitude histogram to mark EDGE_PIXELS pixels
+const uint32_t tileSummary = 0;        // the tiles with more than MOVED_PIXELS moved pixels are counted from the summaries
+const uint32_t motionBox = 0;          // the box around all moved pixels is read from the accelerator
+#define EDGE_PIXELS (IMAGE_WIDTH*IMAGE_HEIGHT/10)
+#define MOVED_PIXELS 16
 
 // constants for the dma transfers
 const uint32_t writeBusStartAddress = 0x00000600;
@@ -19,32 +59,318 @@ const uint32_t writeBlockSize = 0x00000E00;
 const uint32_t writeBurstSize = 0x00001200;
 const uint32_t writeSingleWord = 0x00000200;
 const uint32_t writeSobelTreshold = 0x00001A00;
+const uint32_t writeSobelConfig = 0x00001E00;
+const uint32_t writeStride = 0x00003600;
+const uint32_t writeTileGeometry = 0x00003E00;
+//size of the frame, walked in frame mode and followed by the filter for the stripe walk and the motion boxes
+const uint32_t writeFrameWidth = 0x00002E00;
+const uint32_t writeFrameHeight = 0x00003200;
+//geometry of the image and of the tiles: a tile is at most 64 pixels wide (a multiple of 4), its input block
+//(TILE_WIDTH/4+1 words by TILE_HEIGHT+2 lines) has to fit in 238 words and its output in 192 words
+#define IMAGE_WIDTH 640
+#define IMAGE_HEIGHT 480
+#define TILE_WIDTH 64
+#define TILE_HEIGHT 12
+#define TILES_PER_ROW (IMAGE_WIDTH/TILE_WIDTH)
+#define NR_OF_TILES (TILES_PER_ROW*(IMAGE_HEIGHT/TILE_HEIGHT))
 //constants for image tiling
-const uint32_t block_size = 17*14;
-const uint32_t burst_size = 16;
-const uint32_t block_size_output = 16*12;
-const uint32_t burst_size_output = 15;
-const uint32_t skip_line = 640*11+64;
+const uint32_t block_size = (TILE_WIDTH/4+1)*(TILE_HEIGHT+2);
+const uint32_t burst_size = TILE_WIDTH/4;
+const uint32_t block_size_output = TILE_WIDTH/4*TILE_HEIGHT;
+const uint32_t burst_size_output = TILE_WIDTH/4-1;
+const uint32_t skip_line = IMAGE_WIDTH*(TILE_HEIGHT-1)+TILE_WIDTH;
+//constants for the packed movement state: 2 bits per pixel, stored per tile (48 words) in tile order,
+//moved in a single burst so the line skip of the dma does not apply
+const uint32_t block_size_state = TILE_WIDTH/4*TILE_HEIGHT/4;
+const uint32_t burst_size_state = TILE_WIDTH/4*TILE_HEIGHT/4-1;
+const uint32_t state_memory = 476;
 //constants for double buffering
 const uint32_t buff1 = 0;
 const uint32_t buff2 = 238;
+//constants for triple buffering: slot i%3 holds the input block and the packed state of tile i
+const uint32_t input_slot[3] = {0, 238, 476};
+const uint32_t state_slot[3] = {714, 762, 810};
 //sobel treshold : the lower, the more sensible (0-255)
 const uint32_t sobel_treshold=127;
 
-int main () {
-  volatile uint8_t grayscale[640*480];
-  volatile uint8_t sobelImage[640*480];
-  volatile uint8_t movement[640*480];
+//frame registers of the accelerator
+const uint32_t writeFrameGrayAddress = 0x00002200;
+const uint32_t writeFramePreviousAddress = 0x00002600;
+const uint32_t writeFrameOutputAddress = 0x00002A00;
+const uint32_t writeFrameControl = 0x00003A00;
+const uint32_t readFrameStatus = 0x00003800;
+
+//descriptor chain of the dma: the transfers of a whole frame are described once, 4 words per transfer in bus byte order
+//(see ramDmaCi_sobel_movement_detection.v), and executed with a single write of the control register
+const uint32_t startDescriptorChain = 4;
+const uint32_t descriptorMemoryToBus = 1<<27;
+const uint32_t descriptorWaitSobel = 1<<28;
+const uint32_t descriptorStartSobel = 1<<29;
+const uint32_t descriptorLast = 1<<31;
+#define NR_OF_DESCRIPTORS (1+NR_OF_TILES*4)
+
+static void profileStart(uint32_t part) {
+  if (PROFILING == part) asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7)); // start profiling
+}
+
+static void profileStop(uint32_t part) {
+  if (PROFILING == part) asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7<<4)); //disable counters
+}
+
+static void profilePrint() {
+  static const char *const parts[] = {"", "", " for movement detection data movement overhead", " for Sobel loading and filtering",
+                                      " for moving data from ci memory to sobel vector", " for initializing the frame"};
+  // the counters of the parts that span the whole frame are disabled while they are read
+  const uint32_t disable = (PROFILING == MOVEMENT_DETECTION_PROFILING || PROFILING == SOBEL_PROFILING) ? 0 : 7<<4;
   volatile uint32_t  cycles,stall,idle;
+  if (PROFILING == NO_PROFILING) return;
+  asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|disable));
+  asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
+  asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
+  printf("nrOfCycles%s: %d %d %d\n", parts[PROFILING], cycles, stall, idle);
+}
+
+static void dmaStart(uint32_t busAddress, uint32_t memoryAddress, uint32_t blockSize, uint32_t burstSize, uint32_t control) {
+  ramdma_write(writeBusStartAddress, busAddress);
+  ramdma_write(writeMemoryStartAddress, memoryAddress);
+  ramdma_write(writeBlockSize, blockSize);
+  ramdma_write(writeBurstSize, burstSize);
+  ramdma_write(writeControlRegister, control); // 1 : bus to ci memory, 2 : ci memory to bus
+}
+
+static void dmaWait() {
+  while (ramdma_read(readStatusRegister) != 0);
+}
+
+static void sobelStart() {
+  asm volatile ("l.nios_rrr r0,r0,r0,0x15"); //start sobel + movement detection
+}
+
+static void sobelWait() {
+  while (ramdma_read(0) != 0);
+}
+
+// CHASE_CAPTURE: the input blocks of a row of tiles hold its TILE_HEIGHT lines and the two lines below
+static void waitForBand(int tile) {
+  uint32_t lines = (tile/TILES_PER_ROW+1)*TILE_HEIGHT+2;
+  if (CAPTURE == CHASE_CAPTURE && tile%TILES_PER_ROW == 0) waitForLines(lines < IMAGE_HEIGHT ? lines : IMAGE_HEIGHT);
+}
+
+/*
+ * TILE_WALK without overlapWriteBack: the input block of the next tile is read into the other buffer while the filter
+ * runs on the current one, the previous state and the output of a tile are moved before and after.
+ */
+static void walkTiles(uint32_t gray, uint32_t sobel, uint32_t state) {
+  uint32_t buffer, lastrow;
+  //transfer first image block to ci memory
+  waitForBand(0);
+  dmaStart(gray, buff2, block_size, burst_size, 1);
+  buffer=0;
+  dmaWait();
+  profileStop(INITIALIZATION_PROFILING);
+  for (int i = 1; i <= NR_OF_TILES; i++) {
+    lastrow=(i%TILES_PER_ROW);
+    //move the previous values of the sobel buffer to be compared with the ones that have to be computed
+    profileStart(MOVEMENT_DETECTION_PROFILING);
+    if (packedState) {
+      dmaStart(state, state_memory, block_size_state, burst_size_state, 1);
+    } else {
+      dmaStart(sobel, state_memory, block_size_output, burst_size_output, 1);
+    }
+    dmaWait();
+    profileStop(MOVEMENT_DETECTION_PROFILING);
+    profileStart(SOBEL_PROFILING);
+    if(i<NR_OF_TILES){ // transfer a grayscale image block to one buffer (not for the last iteration)
+      gray += (lastrow==0) ? skip_line : TILE_WIDTH; // skip TILE_HEIGHT pixel lines for the last block of a row
+      waitForBand(i);
+      dmaStart(gray, buffer?buff2:buff1, block_size, burst_size, 1);
+    }
+    sobelStart();
+    dmaWait();
+    sobelWait();
+    profileStop(SOBEL_PROFILING);
+    profileStart(CI_MEMORY_TO_OUTPUT_PROFILING);
+    // transfer computed values (sobel+movement detection outputs) from ci memory to second buffer
+    dmaStart(sobel, buffer?buff1:buff2, block_size_output, burst_size_output, 2);
+    sobel += (lastrow==0) ? skip_line : TILE_WIDTH;
+    dmaWait();
+    if (packedState) {
+      // write the packed state of this tile back for the next frame
+      dmaStart(state, state_memory, block_size_state, burst_size_state, 2);
+      state+=block_size_state*4;
+      dmaWait();
+    }
+    profileStop(CI_MEMORY_TO_OUTPUT_PROFILING);
+    buffer=!buffer; //switch buffer for the next iteration
+  }
+}
+
+/*
+ * TILE_WALK with overlapWriteBack: every step reads the state and the input of tile i into slot i%3 while the filter
+ * runs on tile i-1, then starts the filter on tile i and writes tile i-1 back from its slot while it runs.
+ */
+static void walkTilesOverlapped(uint32_t gray, uint32_t sobel, uint32_t state) {
+  uint32_t readState = state;
+  ramdma_write(writeSobelConfig, 3|(magnitudeOutput ? 8 : 0)); // the filter starts in slot 0
+  profileStop(INITIALIZATION_PROFILING);
+  for (int i = 0; i <= NR_OF_TILES; i++) {
+    uint32_t slot = i%3, previous = (i+2)%3;
+    if(i<NR_OF_TILES){
+      profileStart(MOVEMENT_DETECTION_PROFILING);
+      dmaStart(readState, state_slot[slot], block_size_state, burst_size_state, 1);
+      readState+=block_size_state*4;
+      dmaWait();
+      profileStop(MOVEMENT_DETECTION_PROFILING);
+      profileStart(SOBEL_PROFILING);
+      waitForBand(i);
+      dmaStart(gray, input_slot[slot], block_size, burst_size, 1);
+      gray+=((i+1)%TILES_PER_ROW==0) ? skip_line : TILE_WIDTH;
+      dmaWait();
+    } else {
+      profileStart(SOBEL_PROFILING);
+    }
+    sobelWait(); //wait for the filter of tile i-1 to finish
+    if(i<NR_OF_TILES) sobelStart(); //start sobel + movement detection of tile i
+    profileStop(SOBEL_PROFILING);
+    if(i>0){
+      profileStart(CI_MEMORY_TO_OUTPUT_PROFILING);
+      // output and packed state of tile i-1
+      dmaStart(sobel, input_slot[previous], block_size_output, burst_size_output, 2);
+      sobel+=(i%TILES_PER_ROW==0) ? skip_line : TILE_WIDTH;
+      dmaWait();
+      dmaStart(state, state_slot[previous], block_size_state, burst_size_state, 2);
+      state+=block_size_state*4;
+      dmaWait();
+      profileStop(CI_MEMORY_TO_OUTPUT_PROFILING);
+    }
+  }
+}
+
+static volatile uint32_t *addDescriptor(volatile uint32_t *descriptor, uint32_t busAddress, uint32_t memoryAddress,
+                                        uint32_t blockSize, uint32_t burstSize, uint32_t flags) {
+  descriptor[0] = swap_u32(busAddress);
+  descriptor[1] = swap_u32(blockSize | (burstSize << 10) | ((memoryAddress & 0x1FF) << 18) | ((memoryAddress >> 9) << 30) | flags);
+  descriptor[2] = swap_u32((uint32_t) &descriptor[4]);
+  descriptor[3] = 0;
+  return &descriptor[4];
+}
+
+// the transfers of walkTiles, in the same order
+static void buildDescriptorChain(volatile uint32_t *descriptor, uint32_t gray, uint32_t sobel, uint32_t state) {
+  uint32_t buffer = 0;
+  descriptor = addDescriptor(descriptor, gray, buff2, block_size, burst_size, 0);
+  for (int i = 1; i <= NR_OF_TILES; i++) {
+    uint32_t lastrow = i % TILES_PER_ROW;
+    if (packedState) {
+      descriptor = addDescriptor(descriptor, state, state_memory, block_size_state, burst_size_state, 0);
+    } else {
+      descriptor = addDescriptor(descriptor, sobel, state_memory, block_size_output, burst_size_output, 0);
+    }
+    // the filter starts with the transfer of the next block, for the last tile with an empty transfer
+    gray += (lastrow == 0) ? skip_line : TILE_WIDTH;
+    descriptor = addDescriptor(descriptor, gray, buffer ? buff2 : buff1, (i < NR_OF_TILES) ? block_size : 0, burst_size, descriptorStartSobel);
+    descriptor = addDescriptor(descriptor, sobel, buffer ? buff1 : buff2, block_size_output, burst_size_output,
+                               descriptorMemoryToBus | descriptorWaitSobel);
+    sobel += (lastrow == 0) ? skip_line : TILE_WIDTH;
+    if (packedState) {
+      descriptor = addDescriptor(descriptor, state, state_memory, block_size_state, burst_size_state, descriptorMemoryToBus);
+      state += block_size_state*4;
+    }
+    buffer = !buffer;
+  }
+  descriptor[-3] |= swap_u32(descriptorLast);
+}
+
+// the transfers of walkTilesOverlapped, in the same order
+static void buildDescriptorChainOverlapped(volatile uint32_t *descriptor, uint32_t gray, uint32_t sobel, uint32_t state) {
+  uint32_t readState = state;
+  for (int i = 0; i <= NR_OF_TILES; i++) {
+    uint32_t slot = i % 3, previous = (i + 2) % 3;
+    if (i < NR_OF_TILES) {
+      descriptor = addDescriptor(descriptor, readState, state_slot[slot], block_size_state, burst_size_state, 0);
+      descriptor = addDescriptor(descriptor, gray, input_slot[slot], block_size, burst_size, 0);
+      readState += block_size_state*4;
+      gray += ((i+1) % TILES_PER_ROW == 0) ? skip_line : TILE_WIDTH;
+    }
+    // the filter of tile i starts once the one of tile i-1 is done, for the first tile with an empty transfer
+    descriptor = addDescriptor(descriptor, sobel, input_slot[previous], (i > 0) ? block_size_output : 0, burst_size_output,
+                               descriptorMemoryToBus | descriptorWaitSobel | ((i < NR_OF_TILES) ? descriptorStartSobel : 0));
+    if (i > 0) {
+      descriptor = addDescriptor(descriptor, state, state_slot[previous], block_size_state, burst_size_state, descriptorMemoryToBus);
+      state += block_size_state*4;
+      sobel += (i % TILES_PER_ROW == 0) ? skip_line : TILE_WIDTH;
+    }
+  }
+  descriptor[-3] |= swap_u32(descriptorLast);
+}
+
+// CHAIN_WALK: all transfers and filter runs of the frame
+static void walkChain(volatile uint32_t *descriptorChain) {
+  ramdma_write(writeBusStartAddress, (uint32_t) &descriptorChain[0]);
+  ramdma_write(writeControlRegister, startDescriptorChain);
+  if (irqCompletion) {
+    ramdma_wait(RAMDMA_IRQ_DMA); // the cpu is free until the interrupt of the end of the chain
+  } else {
+    dmaWait();
+  }
+}
+
+// FRAME_WALK: the accelerator walks all tiles of the frame
+static void walkFrame(uint32_t gray) {
+  ramdma_write(writeFrameGrayAddress, gray);
+  ramdma_write(writeFrameControl, 1);
+  if (irqCompletion) {
+    ramdma_wait(RAMDMA_IRQ_DMA); // the cpu is free until the interrupt of the end of the frame
+  } else {
+    while ((ramdma_read(readFrameStatus) & 2) == 0); // bit 1 : frame done
+  }
+}
+
+static void adaptThreshold() {
+  uint32_t histogram[RAMDMA_HISTOGRAM_BINS];
+  ramdma_histogram_read(histogram);
+  ramdma_write(writeSobelTreshold, ramdma_histogram_threshold(histogram, EDGE_PIXELS));
+}
+
+// in frame mode the dma wrote the summaries to summary after the last tile in bus byte order, else they are read here
+static void countMovingTiles(volatile uint32_t *summary) {
+  uint32_t movingTiles = 0;
+  if (WALK != FRAME_WALK) {
+    ramdma_summary_read((uint32_t *) summary, NR_OF_TILES);
+    ramdma_write(RAMDMA_SUMMARY_ADDRESS, 0); // the next frame starts again at entry 0
+  }
+  for (int i = 0; i < NR_OF_TILES; i++) {
+    uint32_t entry = (WALK == FRAME_WALK) ? swap_u32(summary[i]) : summary[i];
+    if (RAMDMA_SUMMARY_MOVED(entry) > MOVED_PIXELS) movingTiles++;
+  }
+  printf("moving tiles: %d\n", movingTiles);
+}
+
+static void printMotionBox() {
+  ramdmaBox box;
+  if (ramdma_box_read(0, &box)) printf("motion: x %d..%d, y %d..%d\n", box.minX, box.maxX, box.minY, box.maxY);
+  ramdma_write(RAMDMA_BOX_CLEAR, 0);
+}
+
+int main () {
+  volatile uint8_t grayscale[IMAGE_WIDTH*IMAGE_HEIGHT];
+  volatile uint8_t sobelImage[IMAGE_WIDTH*IMAGE_HEIGHT];
+  volatile uint32_t packedStateImage[NR_OF_TILES*TILE_WIDTH*TILE_HEIGHT/16];
+  volatile uint32_t descriptorChain[NR_OF_DESCRIPTORS*4] __attribute__((aligned(16)));
+  volatile uint32_t summary[NR_OF_TILES];
+  volatile uint32_t edgeState[IMAGE_WIDTH*IMAGE_HEIGHT/32];
+  volatile uint8_t grayscaleRing[2][IMAGE_WIDTH*IMAGE_HEIGHT];
+  const uint32_t frameBuffers[3] = {(uint32_t) &grayscale[0], (uint32_t) &grayscaleRing[0][0], (uint32_t) &grayscaleRing[1][0]};
   volatile unsigned int *vga = (unsigned int *) 0X50000020;
   uint32_t result;
-  uint32_t pixel1, pixel2;
-  uint32_t buffer, lastrow;
-  uint32_t read_addr,write_addr;
   camParameters camParams;
+  if (overlapWriteBack && !packedState) {
+    printf("overlapWriteBack needs packedState\n");
+    return 1;
+  }
   vga_clear();
   printf("Initialising camera (this takes up to 3 seconds)!\n" );
-  camParams = initOv7670(VGA);
+  camParams = initOv7670((IMAGE_WIDTH == 160) ? QQVGA : (IMAGE_WIDTH == 320) ? QVGA : VGA);
   printf("Done!\n" );
   printf("NrOfPixels : %d\n", camParams.nrOfPixelsPerLine );
   result = (camParams.nrOfPixelsPerLine <= 320) ? camParams.nrOfPixelsPerLine | 0x80000000 : camParams.nrOfPixelsPerLine;
@@ -54,139 +380,84 @@ int main () {
   vga[1] = swap_u32(result);
   printf("PCLK (kHz) : %d\n", camParams.pixelClockInkHz );
   printf("FPS        : %d\n", camParams.framesPerSecond );
-  uint32_t grayPixels;
   vga[2] = swap_u32(2);
   vga[3] = swap_u32((uint32_t) &sobelImage[0]);
   // initialize all values to 127 (gray) for avoiding movement detection in the first frame
-  for(int i=0; i<640*480; i++){
+  for(int i=0; i<IMAGE_WIDTH*IMAGE_HEIGHT; i++){
     sobelImage[i]=127;
   }
-  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeSobelTreshold),[in2]"r"(sobel_treshold));
+  if (WALK == CAMERA_WALK) {
+    for(int i=0; i<IMAGE_WIDTH*IMAGE_HEIGHT/32; i++){
+      edgeState[i]=0;
+    }
+    enableStreamingSobel((uint32_t) &sobelImage[0], (uint32_t) &edgeState[0], sobel_treshold);
+  }
+  ramdma_write(writeSobelTreshold, sobel_treshold);
+  ramdma_write(writeStride, IMAGE_WIDTH);
+  ramdma_write(writeTileGeometry, TILE_HEIGHT << 16 | TILE_WIDTH);
+  ramdma_write(writeFrameWidth, IMAGE_WIDTH);
+  ramdma_write(writeFrameHeight, IMAGE_HEIGHT);
+  if (packedState) {
+    // code 01 (gray) for every pixel, the packed equivalent of 127
+    for(int i=0; i<NR_OF_TILES*block_size_state; i++){
+      packedStateImage[i]=0x55555555;
+    }
+  }
+  // bit 0 : packed state, bit 1 : triple buffering, bit 2 : stripe walk, bit 3 : magnitude output
+  ramdma_write(writeSobelConfig, (packedState ? (overlapWriteBack ? 3 : 1) : 0) |
+                                 ((WALK == FRAME_WALK && stripeWalk) ? 4 : 0) | (magnitudeOutput ? 8 : 0));
+  if (WALK == FRAME_WALK) {
+    ramdma_write(writeFramePreviousAddress, packedState ? (uint32_t) &packedStateImage[0] : (uint32_t) &sobelImage[0]);
+    ramdma_write(writeFrameOutputAddress, (uint32_t) &sobelImage[0]);
+    if (tileSummary) ramdma_write(RAMDMA_SUMMARY_ADDRESS, (uint32_t) &summary[0]); // written by the dma after the last tile
+  }
+  if (WALK == CHAIN_WALK) {
+    if (overlapWriteBack) {
+      buildDescriptorChainOverlapped(descriptorChain, (uint32_t) &grayscale[0], (uint32_t) &sobelImage[IMAGE_WIDTH+1],
+                                     (uint32_t) &packedStateImage[0]);
+    } else {
+      buildDescriptorChain(descriptorChain, (uint32_t) &grayscale[0], (uint32_t) &sobelImage[IMAGE_WIDTH+1],
+                           (uint32_t) &packedStateImage[0]);
+    }
+  }
+  if (irqCompletion && (WALK == CHAIN_WALK || WALK == FRAME_WALK)) ramdma_irq_enable(RAMDMA_IRQ_DMA);
+  if (adaptiveThreshold) ramdma_histogram_clear();
+  if (CAPTURE == RING_CAPTURE) enableContinuesRing(frameBuffers, 3);
   while(1){
-        #ifdef FULL_PROFILING
-          asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7)); // start profiling 
-        #endif
-        #ifdef INITIALIZATION_PROFILING
-          asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7)); // start profiling 
-        #endif
-          uint32_t gray = (uint32_t ) &grayscale[0];
-          uint32_t sobel = (uint32_t ) &sobelImage[641];
-          takeSingleImageBlocking(gray);
-          //transfer first image block to ci memory
-          asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeMemoryStartAddress),[in2]"r"(buff2)); 
-          asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBusStartAddress),[in2]"r"(gray)); 
-          asm volatile ("l.nios_rrr r0,%[in1],%[in2],0X14"::[in1]"r"(writeBlockSize),[in2]"r"(block_size));
-          asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBurstSize),[in2]"r"(burst_size));
-          asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeControlRegister),[in2]"r"(1)); 
-          buffer=0;
-          while(1){
-              asm volatile ("l.nios_rrr %[out1],%[in1],r0,0x14":[out1]"=r"(result):[in1]"r"(readStatusRegister)); // read status register
-              if(result==0) break;
-          }         
-        #ifdef INITIALIZATION_PROFILING
-                  asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7<<4)); //disable counters
-        #endif
-          for (int i = 1; i <= 400; i++) {
-                  lastrow=(i%10);
-                  //move the previous values of the sobel buffer to be compared with the ones that have to be computed
-                #ifdef MOVEMENT_DETECTION_PROFILING
-                   asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7)); // start profiling
-                #endif
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBusStartAddress),[in2]"r"(sobel));
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0X14"::[in1]"r"(writeBlockSize),[in2]"r"(block_size_output));
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBurstSize),[in2]"r"(burst_size_output));
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeMemoryStartAddress),[in2]"r"(476));  
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeControlRegister),[in2]"r"(1));  
-                  while(1){
-                      asm volatile ("l.nios_rrr %[out1],%[in1],r0,0x14":[out1]"=r"(result):[in1]"r"(readStatusRegister)); // read status register
-                      if(result==0) break;
-                  }
-                #ifdef MOVEMENT_DETECTION_PROFILING
-                  asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7<<4)); //disable counters
-                #endif
-                #ifdef SOBEL_PROFILING
-                    asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7)); // start profiling 
-                #endif
-                  if(i<=399){ // transfer a grayscale image block to one buffer (not for the last iteration)
-                        asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeMemoryStartAddress),[in2]"r"(buffer?buff2:buff1));  
-                        if(lastrow==0){    
-                            gray+=skip_line; // skip 12 pixel lines for the last block of a row
-                        }
-                        else{
-                            gray+=64; // increment bus start address
-                        }
-                        asm volatile ("l.nios_rrr r0,%[in1],%[in2],0X14"::[in1]"r"(writeBlockSize),[in2]"r"(block_size));
-                        asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBurstSize),[in2]"r"(burst_size));
-                        asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBusStartAddress),[in2]"r"(gray));
-                        asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeControlRegister),[in2]"r"(1)); 
-                  }
-                  asm volatile ("l.nios_rrr r0,r0,r0,0x15"); //start sobel + movement detection
-                  while(1){ //wait for dma transfer to finish
-                      asm volatile ("l.nios_rrr %[out1],%[in1],r0,0x14":[out1]"=r"(result):[in1]"r"(readStatusRegister)); // read status register
-                      if(result==0) break;
-                  }
-                  while(1){ //wait for sobel to finish
-                      asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0x14":[out1]"=r"(result):[in1]"r"(0),[in2]"r"(0)); // read status register
-                      if(result==0) break;
-                  }
-                  #ifdef SOBEL_PROFILING
-                   asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7<<4)); //disable counters
-                 #endif
-                 #ifdef CI_MEMORY_TO_OUTPUT_PROFILING
-                   asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7)); // start profiling
-                #endif
-                  // transfer computed values (sobel+movement detection outputs) from ci memory to second buffer
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeMemoryStartAddress),[in2]"r"(buffer?buff1:buff2)); 
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0X14"::[in1]"r"(writeBlockSize),[in2]"r"(block_size_output));
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBurstSize),[in2]"r"(burst_size_output));
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeBusStartAddress),[in2]"r"(sobel));
-                  if(lastrow==0){
-                      sobel+=skip_line;  // skip 12 pixel lines for the last block of a row
-                  }
-                  else{
-                      sobel+=64; // increment bus start address
-                  }
-                  asm volatile ("l.nios_rrr r0,%[in1],%[in2],0x14"::[in1]"r"(writeControlRegister),[in2]"r"(2));  
-                  while(1){ // wait for dma transfer to finish
-                      asm volatile ("l.nios_rrr %[out1],%[in1],r0,0x14":[out1]"=r"(result):[in1]"r"(readStatusRegister)); // read status register
-                      if(result==0) break;
-                  }
-                #ifdef CI_MEMORY_TO_OUTPUT_PROFILING
-                   asm volatile ("l.nios_rrr r0,r0,%[in2],0xC"::[in2]"r"(7<<4)); //disable counters
-                #endif
-                  buffer=!buffer; //switch buffer for the next iteration
-          }
-        // read profiling results
-      #ifdef FULL_PROFILING
-        asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
-        printf("nrOfCycles: %d %d %d\n", cycles, stall, idle);
-      #endif
-      #ifdef MOVEMENT_DETECTION_PROFILING
-        asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
-        printf("nrOfCycles for movement detection data movement overhead: %d %d %d\n", cycles, stall, idle);
-      #endif
-      #ifdef SOBEL_PROFILING
-        asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
-        printf("nrOfCycles for Sobel loading and filtering: %d %d %d\n", cycles, stall, idle);
-      #endif
-      #ifdef CI_MEMORY_TO_OUTPUT_PROFILING
-        asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
-        printf("nrOfCycles for moving data from ci memory to sobel vector: %d %d %d\n", cycles, stall, idle);
-      #endif
-      #ifdef INITIALIZATION_PROFILING
-        asm volatile ("l.nios_rrr %[out1],r0,%[in2],0xC":[out1]"=r"(cycles):[in2]"r"(1<<8|7<<4));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(stall):[in1]"r"(1),[in2]"r"(1<<9));
-        asm volatile ("l.nios_rrr %[out1],%[in1],%[in2],0xC":[out1]"=r"(idle):[in1]"r"(2),[in2]"r"(1<<10));
-        printf("nrOfCycles for initializing the frame: %d %d %d\n", cycles, stall, idle);
-      #endif
-
+    profileStart(FULL_PROFILING);
+    profileStart(INITIALIZATION_PROFILING);
+    uint32_t gray = (uint32_t ) &grayscale[0];
+    uint32_t sobel = (uint32_t ) &sobelImage[IMAGE_WIDTH+1];
+    uint32_t state = (uint32_t ) &packedStateImage[0];
+    if (CAPTURE == RING_CAPTURE) {
+      gray = waitForCompletedFrame(); // the camera grabs the next frame into the next buffer meanwhile
+    } else if (CAPTURE == CHASE_CAPTURE) {
+      takeSingleImageNonBlocking(gray); // the tiles follow the camera row by row
+    } else {
+      takeSingleImageBlocking(gray);
+    }
+    switch (WALK) {
+      case TILE_WALK:
+        if (overlapWriteBack) {
+          walkTilesOverlapped(gray, sobel, state);
+        } else {
+          walkTiles(gray, sobel, state);
+        }
+        break;
+      case CHAIN_WALK:
+        walkChain(descriptorChain);
+        break;
+      case FRAME_WALK:
+        walkFrame(gray);
+        break;
+      default:
+        break; //the camera already wrote the movement image of the frame
+    }
+    if (CAPTURE == CHASE_CAPTURE) waitForNextImage(); // a new single image can only be requested after the vsync that ends this one
+    if (adaptiveThreshold) adaptThreshold();
+    if (tileSummary) countMovingTiles(summary);
+    if (motionBox) printMotionBox();
+    // read profiling results
+    profilePrint();
   }
 }
@@ -7,6 +7,20 @@
    * https://github.com/ComputerNerd/ov7670-no-ram-arduino-uno
    */
 
+/* interrupts of the camera (custom instruction 0x7) */
+#define CAMERA_IRQ_LINES 1  // every nrOfLines lines written to memory
+#define CAMERA_IRQ_FRAME 2  // a grabbed frame is complete
+
+/* decimation of the region of interest */
+#define CAMERA_DECIMATE_1 0
+#define CAMERA_DECIMATE_2 1
+#define CAMERA_DECIMATE_4 2
+
+/* output formats of the grabber */
+#define CAMERA_FORMAT_GRAY 0
+#define CAMERA_FORMAT_RGB565 1
+#define CAMERA_FORMAT_BOTH 2
+
 typedef enum resolution_t {VGA,QVGA,QQVGA} resolution;
 typedef struct camParam_t {
   uint32_t nrOfPixelsPerLine;
@@ -18,10 +32,28 @@ typedef struct camParam_t {
 int readOv7670Register( int reg );
 void writeOv7670Register(int reg , int value);
 camParameters initOv7670(resolution res);
+camParameters getCameraParameters();
 void takeSingleImageBlocking(uint32_t framebuffer);
 void takeSingleImageNonBlocking(uint32_t framebuffer);
 void waitForNextImage();
 void enableContinues(uint32_t framebuffer);
 void disableContinues();
+void enableStreamingSobel(uint32_t resultBuffer, uint32_t stateBuffer, uint32_t threshold);
+void disableStreamingSobel();
+void enableContinuesRing(const uint32_t *framebuffers, uint32_t nrOfBuffers);
+uint32_t getLastCompletedFrame();
+uint32_t waitForCompletedFrame();
+uint32_t getLinesWritten();
+void waitForLines(uint32_t nrOfLines);
+void enableCameraInterrupts(uint32_t mask, uint32_t nrOfLines);
+void disableCameraInterrupts(uint32_t mask);
+void cameraInterrupt();
+void setRegionOfInterest(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+void setDecimation(uint32_t horizontal, uint32_t vertical);
+void setCameraFormat(uint32_t format, uint32_t colorBuffer);
+
+/* set by cameraInterrupt: the lines in memory at the last line interrupt and the number of frame interrupts */
+extern volatile uint32_t cameraIrqLines;
+extern volatile uint32_t cameraIrqFrames;
 
 #endif
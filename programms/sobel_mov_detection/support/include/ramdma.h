@@ -0,0 +1,77 @@
+#ifndef RAMDMA_H_INCLUDED
+#define RAMDMA_H_INCLUDED
+
+#include <defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* completion interrupts of the ramDmaCi (custom instruction 0x14) */
+#define RAMDMA_IRQ_DMA 1    // the dma is idle again: end of a transfer, a descriptor chain or a frame
+#define RAMDMA_IRQ_SOBEL 2  // the sobel filter is done
+
+#define RAMDMA_IRQ_PENDING 0x00004000
+#define RAMDMA_IRQ_ENABLE_READ 0x00004400
+#define RAMDMA_IRQ_ENABLE 0x00004200
+#define RAMDMA_IRQ_ACKNOWLEDGE 0x00004600
+
+/* histogram of the gradient magnitudes, reading a bin (bits [7:0] of the register) clears it */
+#define RAMDMA_HISTOGRAM 0x00004800
+#define RAMDMA_HISTOGRAM_CLEAR 0x00004A00
+#define RAMDMA_HISTOGRAM_STATUS 0x00004C00
+#define RAMDMA_HISTOGRAM_BINS 256
+
+/* tile summaries, one word per tile in the order the tiles are filtered: edge pixels in bits [31:16], moved pixels
+   in bits [15:0]; in frame mode they are written to the summary address (0 disables it) after the last tile, in bus
+   byte order like the descriptors, so that copy is read through swap_u32. The count saturates at the number of
+   entries and sets the overflow flag for the dropped summaries */
+#define RAMDMA_SUMMARY_ADDRESS 0x00004E00
+#define RAMDMA_SUMMARY 0x00005000
+#define RAMDMA_SUMMARY_COUNT 0x00005400
+#define RAMDMA_SUMMARY_OVERFLOW 0x80000000
+#define RAMDMA_SUMMARY_ENTRIES 512
+#define RAMDMA_SUMMARY_EDGES(entry) ((entry) >> 16)
+#define RAMDMA_SUMMARY_MOVED(entry) ((entry) & 0xFFFF)
+
+/* motion boxes in frame coordinates: box 0 holds all moved pixels of the frame, boxes 1 to 4 the ones inside zones 0 to 3 */
+#define RAMDMA_ZONE 0x00005200
+#define RAMDMA_BOX_CLEAR 0x00005600
+#define RAMDMA_BOX 0x00005800
+#define RAMDMA_ZONES 4
+
+typedef struct ramdmaBox_t {
+    uint32_t minX, maxX, minY, maxY;
+} ramdmaBox;
+
+/* set by the interrupt handler for every completion (index 0 dma, 1 sobel), cleared by ramdma_irq_clear */
+extern volatile uint32_t ramdma_irq_flags[2];
+
+__static_inline void ramdma_write(uint32_t reg, uint32_t value) {
+    asm volatile("l.nios_rrr r0,%[in1],%[in2],0x14" ::[in1] "r"(reg), [in2] "r"(value));
+}
+
+__static_inline uint32_t ramdma_read(uint32_t reg) {
+    uint32_t result;
+    asm volatile("l.nios_rrr %[out1],%[in1],r0,0x14" : [out1] "=r"(result) : [in1] "r"(reg));
+    return result;
+}
+
+void ramdma_irq_enable(uint32_t mask);
+void ramdma_irq_disable(uint32_t mask);
+void ramdma_irq_clear(uint32_t mask);
+int ramdma_irq_done(uint32_t mask);
+void ramdma_wait(uint32_t mask);
+void ramdma_interrupt();
+void ramdma_histogram_clear();
+void ramdma_histogram_read(uint32_t* bins);
+uint32_t ramdma_histogram_threshold(const uint32_t* bins, uint32_t nrOfEdges);
+uint32_t ramdma_summary_read(uint32_t* summary, uint32_t maxEntries);
+void ramdma_zone_set(uint32_t zone, const ramdmaBox* area);
+int ramdma_box_read(uint32_t box, ramdmaBox* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RAMDMA_H_INCLUDED */
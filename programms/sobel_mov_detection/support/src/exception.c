@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <defs.h>
+#include <ramdma.h>
+#include <ov7670.h>
 
 __weak void i_cache_error_handler() {
     puts("I$ error!");
@@ -13,8 +15,10 @@ __weak void illegal_instruction_handler() {
     puts("????");
 }
 
+/* the interrupts of the ramDmaCi and of the camera share the external interrupt of the cpu */
 __weak void external_interrupt_handler() {
-    puts("ping");
+    ramdma_interrupt();
+    cameraInterrupt();
 }
 
 __weak void system_call_handler() {
@@ -0,0 +1,97 @@
+#include <ramdma.h>
+
+volatile uint32_t ramdma_irq_flags[2];
+
+/* the flags are written with single stores, the handler only sets them and the program only clears them */
+void ramdma_irq_clear(uint32_t mask) {
+    if (mask & RAMDMA_IRQ_DMA)
+        ramdma_irq_flags[0] = 0;
+    if (mask & RAMDMA_IRQ_SOBEL)
+        ramdma_irq_flags[1] = 0;
+}
+
+/* a completion that happened before is dropped, the next one raises the interrupt */
+void ramdma_irq_enable(uint32_t mask) {
+    ramdma_write(RAMDMA_IRQ_ACKNOWLEDGE, mask);
+    ramdma_irq_clear(mask);
+    ramdma_write(RAMDMA_IRQ_ENABLE, ramdma_read(RAMDMA_IRQ_ENABLE_READ) | mask);
+}
+
+void ramdma_irq_disable(uint32_t mask) {
+    ramdma_write(RAMDMA_IRQ_ENABLE, ramdma_read(RAMDMA_IRQ_ENABLE_READ) & ~mask);
+}
+
+int ramdma_irq_done(uint32_t mask) {
+    if ((mask & RAMDMA_IRQ_DMA) && ramdma_irq_flags[0] == 0)
+        return 0;
+    if ((mask & RAMDMA_IRQ_SOBEL) && ramdma_irq_flags[1] == 0)
+        return 0;
+    return 1;
+}
+
+/* waits without custom instructions until all completions of mask were seen and clears them */
+void ramdma_wait(uint32_t mask) {
+    while (!ramdma_irq_done(mask))
+        asm volatile("l.nop");
+    ramdma_irq_clear(mask);
+}
+
+/* called by external_interrupt_handler, acknowledges the pending completions */
+void ramdma_interrupt() {
+    uint32_t pending = ramdma_read(RAMDMA_IRQ_PENDING) & ramdma_read(RAMDMA_IRQ_ENABLE_READ);
+    ramdma_write(RAMDMA_IRQ_ACKNOWLEDGE, pending);
+    if (pending & RAMDMA_IRQ_DMA)
+        ramdma_irq_flags[0] = 1;
+    if (pending & RAMDMA_IRQ_SOBEL)
+        ramdma_irq_flags[1] = 1;
+}
+
+/* the sobel filter has to be idle */
+void ramdma_histogram_clear() {
+    ramdma_write(RAMDMA_HISTOGRAM_CLEAR, 0);
+    while (ramdma_read(RAMDMA_HISTOGRAM_STATUS) & 1)
+        asm volatile("l.nop");
+}
+
+/* reads and clears all bins, once the sobel filter is idle */
+void ramdma_histogram_read(uint32_t* bins) {
+    for (uint32_t bin = 0; bin < RAMDMA_HISTOGRAM_BINS; bin++)
+        bins[bin] = ramdma_read(RAMDMA_HISTOGRAM | bin);
+}
+
+/* the lowest threshold that marks at most nrOfEdges pixels as edges (magnitude >= threshold), at least 1 */
+uint32_t ramdma_histogram_threshold(const uint32_t* bins, uint32_t nrOfEdges) {
+    uint32_t edges = 0;
+    uint32_t threshold = RAMDMA_HISTOGRAM_BINS;
+    while (threshold > 1 && edges + bins[threshold - 1] <= nrOfEdges)
+        edges += bins[--threshold];
+    return (threshold == RAMDMA_HISTOGRAM_BINS) ? RAMDMA_HISTOGRAM_BINS - 1 : threshold;
+}
+
+/* copies the summaries of the tiles filtered since the last restart, returns their number (at most
+   RAMDMA_SUMMARY_ENTRIES, check RAMDMA_SUMMARY_COUNT for RAMDMA_SUMMARY_OVERFLOW) */
+uint32_t ramdma_summary_read(uint32_t* summary, uint32_t maxEntries) {
+    uint32_t nrOfEntries = ramdma_read(RAMDMA_SUMMARY_COUNT) & ~RAMDMA_SUMMARY_OVERFLOW;
+    if (nrOfEntries > maxEntries)
+        nrOfEntries = maxEntries;
+    for (uint32_t entry = 0; entry < nrOfEntries; entry++)
+        summary[entry] = ramdma_read(RAMDMA_SUMMARY | entry);
+    return nrOfEntries;
+}
+
+/* moved pixels inside area (bounds included) go into box zone+1, a zone with min > max is disabled */
+void ramdma_zone_set(uint32_t zone, const ramdmaBox* area) {
+    ramdma_write(RAMDMA_ZONE | (zone << 1), (area->maxX << 16) | area->minX);
+    ramdma_write(RAMDMA_ZONE | (zone << 1) | 1, (area->maxY << 16) | area->minY);
+}
+
+/* returns 0 when the box holds no moved pixel */
+int ramdma_box_read(uint32_t box, ramdmaBox* result) {
+    uint32_t x = ramdma_read(RAMDMA_BOX | (box << 1));
+    uint32_t y = ramdma_read(RAMDMA_BOX | (box << 1) | 1);
+    result->minX = x & 0x7FF;
+    result->maxX = x >> 16;
+    result->minY = y & 0x7FF;
+    result->maxY = y >> 16;
+    return result->minX <= result->maxX;
+}
@@ -0,0 +1,63 @@
+#include <rgb565.h>
+
+/*
+ * A camera pixel is read as the halfword {low byte, high byte} of its RGB565
+ * value. Each byte contributes an exact partial sum of the weighted color
+ * components: the high byte red and the upper green bits, the low byte blue
+ * and the lower green bits. The largest sum (64220) fits in 16 bits.
+ *
+ * The dCache does not cache SDRAM, so on the board the 1 kByte of tables are
+ * placed in the scratchpad memory, after the 3x640 byte line buffer of the
+ * sobel kernels.
+ */
+#ifdef __or1k__
+#define RGB565_GRAY_TABLES ((uint16_t *) 0xC0000800)
+#else
+static uint16_t rgb565GrayTableMemory[512];
+#define RGB565_GRAY_TABLES rgb565GrayTableMemory
+#endif
+
+#define RGB565_GRAY_HIGH (RGB565_GRAY_TABLES)
+#define RGB565_GRAY_LOW (RGB565_GRAY_TABLES + 256)
+
+// word accesses to the halfword and byte frames
+typedef uint32_t __attribute__((may_alias)) rgb565Word;
+
+#define RGB565_GRAY(pixel) ((RGB565_GRAY_HIGH[(pixel) & 0xFF] + RGB565_GRAY_LOW[(pixel) >> 8]) >> 8)
+
+void rgb565_init_grayscale() {
+    uint16_t *high = RGB565_GRAY_HIGH;
+    uint16_t *low = RGB565_GRAY_LOW;
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        uint32_t red = (byte >> 3) << 3;
+        uint32_t greenHigh = (byte & 0x7) << 5;
+        uint32_t greenLow = (byte >> 5) << 2;
+        uint32_t blue = (byte & 0x1F) << 3;
+        high[byte] = red * 54 + greenHigh * 183;
+        low[byte] = greenLow * 183 + blue * 19;
+    }
+}
+
+void rgb565_to_grayscale(volatile uint16_t *rgb565, volatile uint8_t *grayscale, uint32_t nrOfPixels) {
+    uint32_t pixel = 0;
+    if ((((uintptr_t) rgb565) & 3) == 0 && (((uintptr_t) grayscale) & 3) == 0) {
+        /* 4 pixels per iteration: two word loads and one word store */
+        volatile rgb565Word *rgbWords = (volatile rgb565Word *) rgb565;
+        volatile rgb565Word *grayWords = (volatile rgb565Word *) grayscale;
+        for (; pixel + 3 < nrOfPixels; pixel += 4) {
+            uint32_t first = rgbWords[pixel >> 1];
+            uint32_t second = rgbWords[(pixel >> 1) + 1];
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            grayWords[pixel >> 2] = ((uint32_t) RGB565_GRAY(first >> 16) << 24) | ((uint32_t) RGB565_GRAY(first & 0xFFFF) << 16) |
+                                    ((uint32_t) RGB565_GRAY(second >> 16) << 8) | RGB565_GRAY(second & 0xFFFF);
+#else
+            grayWords[pixel >> 2] = RGB565_GRAY(first & 0xFFFF) | ((uint32_t) RGB565_GRAY(first >> 16) << 8) |
+                                    ((uint32_t) RGB565_GRAY(second & 0xFFFF) << 16) | ((uint32_t) RGB565_GRAY(second >> 16) << 24);
+#endif
+        }
+    }
+    for (; pixel < nrOfPixels; pixel++) {
+        uint32_t value = rgb565[pixel];
+        grayscale[pixel] = RGB565_GRAY(value);
+    }
+}
@@ -7,6 +7,11 @@
    * https://github.com/ComputerNerd/ov7670-no-ram-arduino-uno
    */
 
+/* output formats of the grabber */
+#define CAMERA_FORMAT_GRAY 0
+#define CAMERA_FORMAT_RGB565 1
+#define CAMERA_FORMAT_BOTH 2
+
 typedef enum resolution_t {VGA,QVGA,QQVGA} resolution;
 typedef struct camParam_t {
   uint32_t nrOfPixelsPerLine;
@@ -23,5 +28,6 @@ void takeSingleImageNonBlocking(uint32_t framebuffer);
 void waitForNextImage();
 void enableContinues(uint32_t framebuffer);
 void disableContinues();
+void setCameraFormat(uint32_t format, uint32_t colorBuffer);
 
 #endif
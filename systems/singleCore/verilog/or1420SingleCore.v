@@ -323,16 +323,24 @@ module or1420SingleCore ( input wire         clock12MHz,
   wire [3:0]  s_cpu1byteEnables;
   wire        s_cpu1DataValid;
   wire [7:0]  s_cpu1BurstSize;
-  wire        s_spm1Irq, s_profileDone, s_stall, s_grayDone;
+  wire        s_spm1Irq, s_profileDone, s_stall, s_grayDone, s_ramDmaIrq, s_camIrq;
   
   assign s_cpu1CiDone = s_hdmiDone | s_swapByteDone | s_flashDone | s_cpuFreqDone | s_i2cCiDone | s_delayCiDone | s_camCiDone | s_profileDone | s_grayDone | s_ramDmaDone;
   assign s_cpu1CiResult = s_hdmiResult | s_swapByteResult | s_flashResult | s_cpuFreqResult | s_i2cCiResult | s_camCiResult | s_delayResult | s_profileResult | s_grayResult |
                           s_ramDmaResult; 
 
+  /* the cpu takes an interrupt on a rising edge, so the shared line drops for a cycle whenever one of
+     the sources does (on its acknowledge), also when the other one is still active */
+  reg [1:0] s_irqSourcesReg;
+  wire [1:0] s_irqSources = {s_camIrq, s_ramDmaIrq};
+  wire s_cpu1Irq = (s_irqSources != 2'd0 && (s_irqSourcesReg & ~s_irqSources) == 2'd0) ? 1'b1 : 1'b0;
+
+  always @(posedge s_systemClock) s_irqSourcesReg <= (s_cpuReset == 1'b1) ? 2'd0 : s_irqSources;
+
   or1420Top #( .NOP_INSTRUCTION(32'h1500FFFF)) cpu1
              (.cpuClock(s_systemClock),
               .cpuReset(s_cpuReset),
-              .irq(1'b0),
+              .irq(s_cpu1Irq),
               .cpuIsStalled(s_stall),
               .iCacheReqBus(s_cpu1IcacheRequestBus),
               .dCacheReqBus(s_cpu1DcacheRequestBus),
@@ -485,6 +493,7 @@ module or1420SingleCore ( input wire         clock12MHz,
              .ciN(s_cpu1CiN),
              .done(s_ramDmaDone),
              .result(s_ramDmaResult),
+             .irq(s_ramDmaIrq),
              .requestTransaction(s_ramDmaRequest),
              .transactionGranted(s_ramDmaGranted),
              .endTransactionIn(s_endTransaction),
@@ -535,7 +544,7 @@ module or1420SingleCore ( input wire         clock12MHz,
    *
    */
   wire s_camReqBus, s_camAckBus, s_camBeginTransaction, s_camEndTransaction;
-  wire s_camDataValid;
+  wire s_camDataValid, s_camReadNotWrite;
   wire [31:0] s_camAddressData;
   wire [3:0] s_camByteEnables;
   wire [7:0] s_camBurstSize;
@@ -564,7 +573,12 @@ module or1420SingleCore ( input wire         clock12MHz,
            .dataValidOut(s_camDataValid),
            .burstSizeOut(s_camBurstSize),
            .busyIn(s_busy),
-           .busErrorIn(s_busError));
+           .busErrorIn(s_busError),
+           .endTransactionIn(s_endTransaction),
+           .dataValidIn(s_dataValid),
+           .addressDataIn(s_addressData),
+           .readNotWriteOut(s_camReadNotWrite),
+           .irq(s_camIrq));
 
 
   /*
@@ -740,7 +754,7 @@ module or1420SingleCore ( input wire         clock12MHz,
  assign s_addressData      = s_cpu1AddressData | s_biosAddressData | s_uartAddressData | s_sdramAddressData | s_hdmiAddressData |
                              s_flashAddressData | s_camAddressData | sGpioAddressData | s_ramDmaAddressData;
  assign s_byteEnables      = s_cpu1byteEnables | s_hdmiByteEnables | s_camByteEnables | s_ramDmaByteEnables;
- assign s_readNotWrite     = s_cpu1ReadNotWrite | s_hdmiReadNotWrite | s_ramDmaReadNotWrite;
+ assign s_readNotWrite     = s_cpu1ReadNotWrite | s_hdmiReadNotWrite | s_ramDmaReadNotWrite | s_camReadNotWrite;
  assign s_dataValid        = s_cpu1DataValid | s_biosDataValid | s_uartDataValid | s_sdramDataValid | s_hdmiDataValid | 
                              s_flashDataValid | s_camDataValid | sGpioDataValid | s_ramDmaDataValid;
  assign s_busy             = s_sdramBusy;